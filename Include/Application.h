@@ -1,12 +1,21 @@
 ﻿#pragma once
 
+#include <condition_variable>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
 
+#include "DynamicResolution.h"
+#include "JobSystem.h"
+#include "Rasterizer.h"
+#include "Renderer.h"
+#include "Shaders.h"
+#include "ShadowMap.h"
 #include "Vector.h"
 
 // Custom deleters for SDL resources (RAII).
@@ -17,6 +26,40 @@ struct SDLDeleter
     void operator()(SDL_Texture* t) const { if (t) SDL_DestroyTexture(t); }
 };
 
+// Default screen-space error budget for mesh LODs, in pixels.
+constexpr float DefaultLodErrorPixels = 1.0f;
+
+// Offscreen run: no window, fixed time step, frame-time report at the end.
+struct HeadlessOptions
+{
+    uint32_t frameCount{100};
+    float deltaTime{1.0f / 60.0f};
+    // Final frame is written here when set (.png, otherwise PPM).
+    std::string imagePath;
+    // JSON report file; printed to stdout when empty.
+    std::string reportPath;
+    // Chrome trace of the run, written when set. Enables the profiler.
+    std::string tracePath;
+    // Render through the visibility buffer.
+    bool bVisibilityBuffer{false};
+    // 4x multisample anti-aliasing.
+    bool bMultisample{false};
+    // Tiled color/depth layout (see RenderTarget::tilesX).
+    bool bTiledTargets{false};
+    ShadingModel shadingModel{ShadingModel::Phong};
+    // Screen-space error budget for mesh LOD selection, in pixels; 0 draws full detail.
+    float lodErrorPixels{DefaultLodErrorPixels};
+    // Frame budget for dynamic resolution in ms; 0 renders at the full resolution.
+    float targetFrameMs{0.0f};
+    // Shadow map size in texels; 0 renders without shadows.
+    uint32_t shadowMapSize{0};
+    int shadowPcfRadius{1};
+    ShadowUpdate shadowUpdate{ShadowUpdate::EveryFrame};
+    // Depth buffer storage, and reverse-Z projection.
+    DepthFormat depthFormat{DepthFormat::Float32};
+    bool bReverseZ{false};
+};
+
 class Application
 {
 public:
@@ -31,9 +74,16 @@ public:
     // Initialize SDL, window, renderer, and texture.
     bool Init();
     // Main loop: events, update, render.
+    // OnRender draws straight into the locked streaming texture, which starts undefined, so it
+    // must clear (or overwrite) every pixel.
     void Run();
+    // Render frameCount frames into the CPU framebuffer without SDL; Init is not needed.
+    bool RunHeadless(const HeadlessOptions& inOptions);
+    // Render size; below the window size while dynamic resolution scales down.
     uint32_t GetWidth() const { return width; }
     uint32_t GetHeight() const { return height; }
+    uint32_t GetWindowWidth() const { return windowWidth; }
+    uint32_t GetWindowHeight() const { return windowHeight; }
 
     // Framebuffer drawing helpers.
     void SetPixel(uint32_t x, uint32_t y, uint32_t color);
@@ -50,6 +100,82 @@ public:
                       const Math::Vector3& n0, const Math::Vector3& n1, const Math::Vector3& n2,
                       uint32_t baseColor);
 
+    // Queue a transformed triangle (screenPos and varyings) for the tile-binned parallel rasterizer.
+    // texture: read by textured shaders only; null draws untextured.
+    void SubmitTriangle(const VSOutput& v0, const VSOutput& v1, const VSOutput& v2, uint32_t baseColor,
+                        const Texture* texture = nullptr);
+    // Rasterize every queued triangle with the program's fragment shader, in submission order.
+    template<typename Program>
+    void FlushTriangles()
+    {
+        tileRasterizer.Flush(GetRenderTarget(), *jobSystem,
+                             RasterPipeline::Create<typename Program::FS>(lighting, depthFormat));
+    }
+
+    // Depth-only pass into the shadow map, fed like SubmitTriangle/FlushTriangles with
+    // triangles transformed by the light's view-projection.
+    void SubmitShadowTriangle(const VSOutput& v0, const VSOutput& v1, const VSOutput& v2);
+    void FlushShadowTriangles();
+
+    JobSystem& GetJobSystem() const { return *jobSystem; }
+    // Transient data of the frame being rendered, reset at the top of every frame.
+    FrameArena& GetFrameArena() const { return *frameArena; }
+
+    // Deferred path for FlushTriangles: raster depth + triangle IDs, then shade each pixel once.
+    void SetVisibilityBuffer(bool bInEnabled) { bUseVisibilityBuffer = bInEnabled; }
+    bool IsVisibilityBufferEnabled() const { return bUseVisibilityBuffer; }
+
+    // 4x MSAA (F8): coverage and depth per sample, shading once per pixel, resolved after
+    // OnRender. Takes the place of the visibility buffer while on. Call between frames.
+    void SetMultisample(bool bInEnabled);
+    bool IsMultisampleEnabled() const { return bMultisample; }
+
+    // Tiled color, depth and visibility planes (F9): the rasterizer writes 8x8 tiles and the
+    // color plane is copied out row by row after OnRender. Call between frames.
+    void SetTiledTargets(bool bInEnabled);
+    bool IsTiledTargetsEnabled() const { return bTiledTargets; }
+
+    // Storage of the depth planes (F11 cycles): Unorm16 moves half the bytes of Float32, at
+    // 16-bit precision. Call between frames.
+    void SetDepthFormat(DepthFormat inFormat);
+    DepthFormat GetDepthFormat() const { return depthFormat; }
+
+    // Reverse-Z (F12): clears to depth 0 and keeps depth negated (see RenderTarget::bReverseZ).
+    // While on, OnRender must project with PerspectiveFovReverseLH and clip with
+    // PrimitiveAssemblyConfig::bReverseZ. Call between frames.
+    void SetReverseZ(bool bInEnabled);
+    bool IsReverseZEnabled() const { return bReverseZ; }
+
+    // Double-buffered present (F5): frame N is presented while OnUpdate/OnRender of frame N+1
+    // already run on a frame thread into the other texture. Adds a frame of latency.
+    void SetAsyncPresent(bool bInEnabled) { bAsyncPresent = bInEnabled; }
+    bool IsAsyncPresentEnabled() const { return bAsyncPresent; }
+
+    // Shader combination OnRender should use; cycled with F4.
+    void SetShadingModel(ShadingModel inModel) { shadingModel = inModel; }
+    ShadingModel GetShadingModel() const { return shadingModel; }
+    const Lighting& GetLighting() const { return lighting; }
+
+    // Shadows of the light (F10 toggles ShadowMap::DefaultSize): inSize texels per side, 0 off.
+    // OnRender draws the map (see ShadowMap) when GetShadowMap().NeedsUpdate says so.
+    void SetShadowMapSize(uint32_t inSize);
+    bool IsShadowEnabled() const { return shadowMap.GetSize() > 0; }
+    ShadowMap& GetShadowMap() { return shadowMap; }
+    void SetShadowUpdate(ShadowUpdate inUpdate) { shadowUpdate = inUpdate; }
+    ShadowUpdate GetShadowUpdate() const { return shadowUpdate; }
+
+    // Largest on-screen deviation, in pixels, a simplified mesh LOD may have; 0 disables
+    // LODs. F6 toggles between 0 and DefaultLodErrorPixels.
+    void SetLodErrorPixels(float inPixels) { lodErrorPixels = inPixels; }
+    float GetLodErrorPixels() const { return lodErrorPixels; }
+
+    // Dynamic resolution (F7): the render size follows measured frame times to stay within
+    // inMs and frames are upscaled bilinearly to the window. 0 renders at window size.
+    // Takes effect from the next frame.
+    void SetTargetFrameMs(float inMs) { dynamicResolution.SetTargetMs(inMs); }
+    float GetTargetFrameMs() const { return dynamicResolution.GetTargetMs(); }
+    float GetRenderScale() const { return dynamicResolution.GetScale(); }
+
 protected:
     // Override hooks.
     virtual void OnUpdate(float deltaTime) {}
@@ -57,23 +183,136 @@ protected:
 
 private:
     void ProcessEvents();
-    void UpdateScreen() const;
+    // OnUpdate + OnRender, then the upscale of a scaled frame; the time feeds dynamic resolution.
+    void RenderFrame(float deltaTime);
+    // Blit a screen texture, draw the overlay and present.
+    void UpdateScreen(uint32_t textureIndex) const;
+    // Point the output plane at the back texture's memory; falls back to framebuffer + upload.
+    void LockBackBuffer();
+    void UnlockBackBuffer();
+    // Async present: hand the finished back buffer to the screen and start the next frame.
+    void PresentAsync(float deltaTime);
+    void StartFrame(float deltaTime);
+    void WaitForFrame();
+    void FrameThreadLoop();
+    // Between frames: snapshot the last frame's overlay stats, drop its transient data and hand
+    // the rasterizers fresh buffers.
+    void ResetFrameArena();
+    // Screen-dependent arena sizes (the rasterizers' bin tables).
+    void PresizeFrameArena();
+    void DrawProfilerOverlay() const;
     // Resize framebuffer and streaming texture.
     void Resize(uint32_t newWidth, uint32_t newHeight);
+    // Between frames: resize the render targets if the dynamic resolution scale moved.
+    void ApplyRenderScale();
+    // Depth, visibility, sample, Hi-Z and tile buffers (and the scaled color plane) at the render size.
+    void ResizeRenderTargets(uint32_t inWidth, uint32_t inHeight);
+    // Render straight into the output plane at full size, otherwise into scaledColor.
+    void BindColorPlane();
+    void ResizeHiZ();
+    // Depth planes are 32-bit words whatever the format: size for inCount values and clear.
+    void AssignDepthPlane(std::vector<uint32_t>& outPlane, size_t inCount) const;
+    void ClearDepthPlane(std::vector<uint32_t>& outPlane) const;
+    RenderTarget GetRenderTarget();
 
 private:
     std::string title;
+    // Render size.
     uint32_t width;
     uint32_t height;
+    // Window, streaming texture and framebuffer size.
+    uint32_t windowWidth;
+    uint32_t windowHeight;
     bool bIsRunning{false};
 
     std::unique_ptr<SDL_Window, SDLDeleter> window;
     std::unique_ptr<SDL_Renderer, SDLDeleter> renderer;
-    std::unique_ptr<SDL_Texture, SDLDeleter> screenTexture;
+    // Streaming textures; the one at backTexture is locked while a frame renders into it.
+    std::unique_ptr<SDL_Texture, SDLDeleter> screenTextures[2];
+    uint32_t backTexture{0};
+    bool bBackLocked{false};
+    // The last frame rendered into the CPU framebuffer and still needs its upload.
+    bool bFramebufferRendered{false};
+    // The back texture holds a finished frame that has not been presented yet (async only).
+    bool bBackFrameReady{false};
 
-    // CPU framebuffer in RGBA.
+    // CPU framebuffer in RGBA. Color plane for headless runs and when locking fails.
     std::vector<uint32_t> framebuffer;
 
+    // Window-sized destination of the frame: locked texture memory or framebuffer.
+    uint32_t* outputPlane{nullptr};
+    uint32_t outputPitch{0};
+    // Where the rasterizer writes color this frame: the output plane, or scaledColor when the
+    // render size is below the window size.
+    uint32_t* colorPlane{nullptr};
+    // Pixels per row of colorPlane.
+    uint32_t colorPitch{0};
+    std::vector<uint32_t> scaledColor;
+    DynamicResolution dynamicResolution;
+
+    bool bAsyncPresent{false};
+    std::thread frameThread;
+    std::mutex frameMutex;
+    std::condition_variable frameCondition;
+    bool bFrameRequested{false};
+    bool bFrameThreadStopping{false};
+    float frameDeltaTime{0.0f};
+
     // 深度缓冲区 (用于处理遮挡关系)
-    std::vector<float> zBuffer;
+    std::vector<uint32_t> zBuffer;
+    DepthFormat depthFormat{DepthFormat::Float32};
+    bool bReverseZ{false};
+
+    // Triangle ID + 1 per pixel for the visibility-buffer path; reset by its shading pass.
+    std::vector<uint32_t> visibilityBuffer;
+    bool bUseVisibilityBuffer{false};
+
+    // Sample planes of the multisample path (see RenderTarget); empty while it is off.
+    std::vector<uint32_t> sampleDepth;
+    std::vector<uint32_t> sampleColor;
+    std::vector<uint32_t> sampleUniform;
+    uint32_t samplePitch{0};
+    bool bMultisample{false};
+
+    // Render color while the planes are tiled; DetileColor copies it to colorPlane.
+    std::vector<uint32_t> tiledColor;
+    bool bTiledTargets{false};
+
+    ShadingModel shadingModel{ShadingModel::Phong};
+    Lighting lighting{DefaultLighting()};
+
+    ShadowMap shadowMap;
+    TileRasterizer shadowRasterizer;
+    ShadowUpdate shadowUpdate{ShadowUpdate::EveryFrame};
+    float lodErrorPixels{DefaultLodErrorPixels};
+
+    // Hierarchical Z: nearest/farthest depth per HiZBlockSize block of zBuffer.
+    uint32_t hiZWidth{0};
+    std::vector<float> hiZMin;
+    std::vector<float> hiZMax;
+    std::vector<uint64_t> hiZCoverage;
+    std::vector<uint8_t> hiZState;
+
+    std::unique_ptr<JobSystem> jobSystem;
+    std::unique_ptr<FrameArena> frameArena;
+    // Taken before each reset, for the overlay: the live counters belong to the frame thread.
+    FrameArenaStats lastFrameArenaStats;
+    // Size and scale of the last finished frame, taken with lastFrameArenaStats: AddFrame on the
+    // frame thread moves the live scale while the overlay is drawn.
+    uint32_t lastRenderWidth{0};
+    uint32_t lastRenderHeight{0};
+    float lastRenderScale{1.0f};
+    TileRasterizer tileRasterizer;
+
+    // Triangles handed to the rasterizer, for the headless report.
+    uint64_t triangleCount{0};
+
+    // Profiler overlay (F1) and trace capture (F2). F3 toggles the visibility buffer, F4 cycles
+    // the shading model, F5 toggles async present, F6 toggles mesh LODs, F7 toggles dynamic
+    // resolution, F8 toggles MSAA, F9 toggles the tiled layout, F10 toggles shadows, F11 cycles
+    // the depth format, F12 toggles reverse-Z.
+    static constexpr const char* TracePath = "renderer_trace.json";
+    bool bImGuiInitialized{false};
+    bool bShowProfiler{false};
+    bool bCapturingTrace{false};
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+class JobSystem;
+
+// Frame budget used when dynamic resolution is switched on without one (60 Hz).
+constexpr float DefaultTargetFrameMs = 1000.0f / 60.0f;
+
+// Picks the internal render scale (per axis, of the window size) from measured frame times.
+// Times are averaged over a window of frames; the scale only moves when the average leaves the
+// band [HeadroomRatio, 1] x target, and always in whole ScaleSteps, so it doesn't oscillate
+// around the budget.
+class DynamicResolution
+{
+public:
+    static constexpr float MinScale = 0.5f;
+    static constexpr float ScaleStep = 1.0f / 16.0f;
+    // Frames averaged per decision; also the settle time after a change.
+    static constexpr uint32_t WindowFrames = 10;
+    // Below this fraction of the budget there is room to scale up.
+    static constexpr float HeadroomRatio = 0.75f;
+
+    // 0 disables scaling and resets the scale to 1.
+    void SetTargetMs(float inTargetMs);
+    float GetTargetMs() const { return targetMs; }
+    bool IsEnabled() const { return targetMs > 0.0f; }
+
+    // Feed the render time of a frame; returns true when the scale changed.
+    bool AddFrame(float inFrameMs);
+    float GetScale() const { return scale; }
+
+    // Render size along one axis for a window size, at least one pixel.
+    uint32_t Apply(uint32_t inWindowSize) const;
+
+private:
+    float targetMs{0.0f};
+    float scale{1.0f};
+    float windowMs{0.0f};
+    uint32_t windowCount{0};
+};
+
+// Bilinear resample of an RGBA8 image with pixel centers aligned and edges clamped, in 7-bit
+// fixed point (SSE2 unless RENDERER_SIMD_SCALAR; both give the same result). Rows are split
+// into bands on inJobs.
+void UpscaleBilinear(const uint32_t* inSrc, uint32_t inSrcWidth, uint32_t inSrcHeight, uint32_t inSrcPitch,
+                     uint32_t* outDst, uint32_t inDstWidth, uint32_t inDstHeight, uint32_t inDstPitch,
+                     JobSystem& inJobs);
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for data that lives until the end of a frame. Allocations only advance an
+// offset and are never freed one by one; Reset drops them all in O(1). A frame that outgrows
+// the block spills into overflow blocks, and the next Reset replaces the lot with one block
+// sized from the high-water mark, so frames that fit never touch the heap.
+// Also a std::pmr::memory_resource, so std::pmr containers can grow inside it.
+// Aligned to a cache line: per-thread arenas sit side by side in FrameArena.
+class alignas(64) LinearArena final : public std::pmr::memory_resource
+{
+public:
+    // Block alignment, and the largest alignment Allocate supports.
+    static constexpr size_t BlockAlignment = 64;
+    // Smallest overflow block.
+    static constexpr size_t MinBlockBytes = 64 * 1024;
+
+    LinearArena() = default;
+
+    // Non-copyable.
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    // inAlignment: a power of two up to BlockAlignment.
+    void* Allocate(size_t inBytes, size_t inAlignment = alignof(std::max_align_t));
+
+    // Uninitialized storage for inCount objects; nothing is destroyed on Reset.
+    template<typename T>
+    T* Allocate(const size_t inCount)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena memory is dropped without destructors.");
+        return static_cast<T*>(Allocate(inCount * sizeof(T), alignof(T)));
+    }
+
+    // Invalidates everything allocated since the last Reset.
+    void Reset();
+    // Capacity for at least inBytes: right away while nothing is allocated, else on Reset.
+    void Reserve(size_t inBytes);
+
+    // Bytes handed out since the last Reset, alignment padding included.
+    size_t GetUsedBytes() const { return used; }
+    // Most bytes any frame used; the block grows to this (plus headroom) and never shrinks.
+    size_t GetHighWaterBytes() const { return highWater; }
+    size_t GetCapacity() const { return capacity; }
+
+private:
+    void* do_allocate(size_t inBytes, size_t inAlignment) override { return Allocate(inBytes, inAlignment); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& inOther) const noexcept override { return this == &inOther; }
+
+    struct BlockDeleter
+    {
+        void operator()(std::byte* inBlock) const { ::operator delete[](inBlock, std::align_val_t{BlockAlignment}); }
+    };
+    using Block = std::unique_ptr<std::byte[], BlockDeleter>;
+    static Block NewBlock(size_t inBytes);
+
+private:
+    Block block;
+    size_t capacity{0};
+    // Spill-over of the current frame.
+    std::vector<Block> overflow;
+
+    // Block being filled: the main block or the last overflow block.
+    std::byte* current{nullptr};
+    size_t currentCapacity{0};
+    size_t offset{0};
+
+    size_t used{0};
+    size_t highWater{0};
+    size_t reserved{0};
+};
+
+// Summed over the sub-arenas of a FrameArena.
+struct FrameArenaStats
+{
+    size_t usedBytes{0};
+    size_t highWaterBytes{0};
+    size_t capacityBytes{0};
+};
+
+// Transient memory of one frame: a LinearArena per job thread, all reset together at the top
+// of the frame loop. Inside JobSystem::ParallelFor a job allocates from Get(threadIndex) and
+// never contends with another thread; index 0 is the thread driving the frame, so code
+// outside jobs uses Get(0). Nothing allocated here may be kept past the next Reset.
+class FrameArena
+{
+public:
+    // One sub-arena per JobSystem thread.
+    explicit FrameArena(uint32_t inThreadCount);
+
+    // Non-copyable.
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    uint32_t GetThreadCount() const { return threadCount; }
+    LinearArena& Get(const uint32_t inThreadIndex = 0) { return arenas[inThreadIndex]; }
+    const LinearArena& Get(const uint32_t inThreadIndex = 0) const { return arenas[inThreadIndex]; }
+
+    void Reset();
+    // Presize the frame thread's arena (also job thread 0) and each worker's.
+    void Reserve(size_t inBytes, size_t inBytesPerThread);
+
+    FrameArenaStats GetStats() const;
+
+private:
+    uint32_t threadCount{0};
+    std::unique_ptr<LinearArena[]> arenas;
+};
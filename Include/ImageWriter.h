@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Writers for packed ABGR8888 pixels (the framebuffer layout), used to dump frames for
+// comparison. Both return false when the file cannot be written.
+
+bool WritePPM(const std::string& inPath, const uint32_t* inPixels, uint32_t inWidth, uint32_t inHeight);
+
+// Uncompressed (stored deflate) RGBA PNG; no external dependencies.
+bool WritePNG(const std::string& inPath, const uint32_t* inPixels, uint32_t inWidth, uint32_t inHeight);
+
+// Picks the format from the extension: ".png", anything else is written as PPM.
+bool WriteImage(const std::string& inPath, const uint32_t* inPixels, uint32_t inWidth, uint32_t inHeight);
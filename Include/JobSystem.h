@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool used by the frame pipeline.
+// The calling thread always takes part in the work as thread index 0,
+// workers use indices [1, GetThreadCount()).
+class JobSystem
+{
+public:
+    // Invoked once per index with the index of the executing thread.
+    using JobFunc = std::function<void(uint32_t index, uint32_t threadIndex)>;
+
+    // 0 picks std::thread::hardware_concurrency().
+    explicit JobSystem(uint32_t inThreadCount = 0);
+    ~JobSystem();
+
+    // Non-copyable.
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Number of threads that can execute jobs, including the caller.
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+    // Run func for every index in [0, count) and block until all are done.
+    void ParallelFor(uint32_t count, const JobFunc& func);
+
+private:
+    struct Job
+    {
+        const JobFunc* func{nullptr};
+        uint32_t count{0};
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> remaining{0};
+    };
+
+    void WorkerLoop(uint32_t threadIndex);
+    // Pull indices from the job until it is exhausted.
+    void Execute(Job& job, uint32_t threadIndex);
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    std::deque<std::shared_ptr<Job>> queue;
+    bool bStopping{false};
+};
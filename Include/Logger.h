@@ -9,14 +9,24 @@
 
 namespace Log
 {
-    inline void Init()
+    // bConsoleToStderr: log to stderr instead of stdout, which then carries only program output
+    // (the headless JSON report).
+    inline void Init(const bool bConsoleToStderr = false)
     {
         if (spdlog::get("Renderer"))
         {
             return;
         }
 
-        auto consoleSink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+        spdlog::sink_ptr consoleSink;
+        if (bConsoleToStderr)
+        {
+            consoleSink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+        }
+        else
+        {
+            consoleSink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+        }
         auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("renderer.log", true);
         std::vector<spdlog::sink_ptr> sinks{consoleSink, fileSink};
         auto logger = std::make_shared<spdlog::logger>("Renderer", sinks.begin(), sinks.end());
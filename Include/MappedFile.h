@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    // Non-copyable.
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& inPath);
+    void Close();
+
+    bool IsOpen() const { return data != nullptr; }
+    const uint8_t* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    const uint8_t* data{nullptr};
+    size_t size{0};
+
+#ifdef _WIN32
+    void* fileHandle{nullptr};
+    void* mappingHandle{nullptr};
+#endif
+};
@@ -1,27 +1,182 @@
 ﻿#pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <vector>
+
+#include "MeshBuffer.h"
 #include "Vector.h"
 
 struct Vertex {
     Vertex() = default;
 
-    Vertex(const Math::Vector3& inPos, const Math::Vector3& inNormal = {0, 0, 0})
-            : position(inPos), normal(inNormal)
+    Vertex(const Math::Vector3& inPos, const Math::Vector3& inNormal = {0, 0, 0},
+           const Math::Vector2& inTexcoord = {0, 0})
+            : position(inPos), normal(inNormal), texcoord(inTexcoord)
     {}
 
     Math::Vector3 position;
     Math::Vector3 normal{};   // 顶点法线
+    Math::Vector2 texcoord{};
+};
+
+// Bitwise position key used to weld corners that share a position. Adding +0 folds -0
+// into +0 so they weld together.
+struct PositionKey
+{
+    std::array<uint32_t, 3> bits{};
+
+    explicit PositionKey(const Math::Vector3& inP)
+        : bits{std::bit_cast<uint32_t>(inP.x + 0.0f), std::bit_cast<uint32_t>(inP.y + 0.0f),
+               std::bit_cast<uint32_t>(inP.z + 0.0f)}
+    {
+    }
+
+    bool operator==(const PositionKey& inOther) const = default;
+};
+
+struct PositionKeyHash
+{
+    size_t operator()(const PositionKey& inKey) const
+    {
+        // FNV-1a over the key words.
+        uint64_t hash = 14695981039346656037ull;
+        for (const uint32_t word : inKey.bits)
+        {
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+
+// Structure-of-arrays vertex data, one stream per component, for the batch vertex stage.
+struct VertexStreams
+{
+    MeshBuffer<float> positionX, positionY, positionZ;
+    MeshBuffer<float> normalX, normalY, normalZ;
+    MeshBuffer<float> texcoordU, texcoordV;
+
+    size_t Size() const { return positionX.size(); }
+
+    void Push(const Vertex& inV)
+    {
+        positionX.push_back(inV.position.x);
+        positionY.push_back(inV.position.y);
+        positionZ.push_back(inV.position.z);
+        normalX.push_back(inV.normal.x);
+        normalY.push_back(inV.normal.y);
+        normalZ.push_back(inV.normal.z);
+        texcoordU.push_back(inV.texcoord.x);
+        texcoordV.push_back(inV.texcoord.y);
+    }
+
+    Vertex Get(size_t inIndex) const
+    {
+        return {
+            {positionX[inIndex], positionY[inIndex], positionZ[inIndex]},
+            {normalX[inIndex], normalY[inIndex], normalZ[inIndex]},
+            {texcoordU[inIndex], texcoordV[inIndex]}
+        };
+    }
+};
+
+
+// Axis-aligned bounding box.
+struct Bounds
+{
+    Math::Vector3 min{};
+    Math::Vector3 max{};
+};
+
+
+// Meshlet size limits.
+constexpr uint32_t MaxMeshletVertices = 64;
+constexpr uint32_t MaxMeshletTriangles = 124;
+
+// Small cluster of a mesh's triangles with its own bounds, so whole clusters can be culled
+// before any of their vertices are transformed. Object space.
+struct Meshlet
+{
+    // Into MeshletBuffers::vertices, and into MeshletBuffers::triangles in triangles.
+    uint32_t vertexOffset{0};
+    uint32_t triangleOffset{0};
+    uint32_t vertexCount{0};
+    uint32_t triangleCount{0};
+
+    // Bounding sphere.
+    Math::Vector3 center{};
+    float radius{0.0f};
+
+    // Normal cone of the front faces (clockwise winding). Every triangle faces away from an eye
+    // with dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius.
+    // coneCutoff is 1 when the normals spread too far to ever cull.
+    Math::Vector3 coneAxis{};
+    float coneCutoff{1.0f};
+};
+
+struct MeshletBuffers
+{
+    MeshBuffer<Meshlet> meshlets;
+    // Mesh vertex index per meshlet vertex.
+    MeshBuffer<uint32_t> vertices;
+    // Three meshlet-local vertex indices per triangle.
+    MeshBuffer<uint8_t> triangles;
+};
+
+// Upper bound on the simplified levels stored with a mesh.
+constexpr uint32_t MaxMeshLods = 7;
+
+// Simplified copy of a mesh with its own compact vertex set.
+struct MeshLod
+{
+    VertexStreams vertices;
+    MeshBuffer<uint32_t> indices;
+    MeshletBuffers clusters;
+    // Object-space distance the surface may deviate from the full-detail mesh.
+    float error{0.0f};
 };
 
 
 struct Mesh
 {
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    VertexStreams vertices;
+    MeshBuffer<uint32_t> indices;
+    // The triangles of indices split into meshlets.
+    MeshletBuffers clusters;
+    // Object-space bounds of all vertices.
+    Bounds bounds;
+    // Coarser levels by increasing error; level 0 is the mesh itself.
+    std::vector<MeshLod> lods;
+
+    uint32_t GetLodCount() const { return static_cast<uint32_t>(lods.size()) + 1; }
+    const VertexStreams& GetVertices(uint32_t inLod) const { return inLod == 0 ? vertices : lods[inLod - 1].vertices; }
+    const MeshBuffer<uint32_t>& GetIndices(uint32_t inLod) const { return inLod == 0 ? indices : lods[inLod - 1].indices; }
+    const MeshletBuffers& GetClusters(uint32_t inLod) const { return inLod == 0 ? clusters : lods[inLod - 1].clusters; }
+
+    // Coarsest level whose error stays within inMaxError (object space).
+    uint32_t SelectLod(float inMaxError) const
+    {
+        uint32_t lod = 0;
+        while (lod < lods.size() && lods[lod].error <= inMaxError) ++lod;
+        return lod;
+    }
 };
 
 
+inline Bounds ComputeBounds(const VertexStreams& inStreams)
+{
+    if (inStreams.Size() == 0) return {};
+
+    const auto [minX, maxX] = std::minmax_element(inStreams.positionX.begin(), inStreams.positionX.end());
+    const auto [minY, maxY] = std::minmax_element(inStreams.positionY.begin(), inStreams.positionY.end());
+    const auto [minZ, maxZ] = std::minmax_element(inStreams.positionZ.begin(), inStreams.positionZ.end());
+    return {{*minX, *minY, *minZ}, {*maxX, *maxY, *maxZ}};
+}
+
+
 // 创建一个单位立方体，中心在原点，边长为 1
 // 范围: [-0.5, 0.5]
 inline Mesh CreateCube()
@@ -29,7 +184,7 @@ inline Mesh CreateCube()
     Mesh mesh;
 
     // 1. 定义 8 个顶点
-    mesh.vertices = {
+    const Vertex corners[] = {
         // Front face (Z = -0.5)
         Math::Vector3{-0.5f, 0.5f, -0.5f}, // 0: Top-Left
         Math::Vector3{0.5f, 0.5f, -0.5f}, // 1: Top-Right
@@ -42,6 +197,10 @@ inline Mesh CreateCube()
         Math::Vector3{0.5f, -0.5f, 0.5f}, // 6: Bottom-Right
         Math::Vector3{-0.5f, -0.5f, 0.5f} // 7: Bottom-Left
     };
+    for (const Vertex& corner : corners)
+    {
+        mesh.vertices.Push(corner);
+    }
 
     // 2. 定义 12 个三角形 (顺时针绕序)
     mesh.indices = {
@@ -59,5 +218,6 @@ inline Mesh CreateCube()
         1, 5, 6, 1, 6, 2
     };
 
+    mesh.bounds = ComputeBounds(mesh.vertices);
     return mesh;
 }
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// Read-mostly array for mesh data. It either owns a std::vector or views memory owned
+// by someone else (e.g. a memory-mapped cache file), which keeps loaded buffers zero-copy.
+// Any mutation turns a view into an owned copy first.
+template<typename T>
+class MeshBuffer
+{
+public:
+    MeshBuffer() = default;
+    MeshBuffer(std::initializer_list<T> inInit) : owned(inInit) { Sync(); }
+    MeshBuffer(std::vector<T> inData) : owned(std::move(inData)) { Sync(); }
+
+    MeshBuffer(const MeshBuffer& inOther) { *this = inOther; }
+    MeshBuffer(MeshBuffer&& inOther) noexcept { *this = std::move(inOther); }
+
+    MeshBuffer& operator=(const MeshBuffer& inOther)
+    {
+        if (this == &inOther) return *this;
+        owner = inOther.owner;
+        if (owner)
+        {
+            owned.clear();
+            ptr = inOther.ptr;
+            count = inOther.count;
+        }
+        else
+        {
+            owned = inOther.owned;
+            Sync();
+        }
+        return *this;
+    }
+
+    MeshBuffer& operator=(MeshBuffer&& inOther) noexcept
+    {
+        if (this == &inOther) return *this;
+        owner = std::move(inOther.owner);
+        owned = std::move(inOther.owned);
+        ptr = inOther.ptr;
+        count = inOther.count;
+        if (!owner) Sync();
+        inOther.owned.clear();
+        inOther.Sync();
+        return *this;
+    }
+
+    // View count elements at inData; inOwner keeps the memory alive.
+    static MeshBuffer View(const T* inData, size_t inCount, std::shared_ptr<const void> inOwner)
+    {
+        MeshBuffer buffer;
+        buffer.ptr = inData;
+        buffer.count = inCount;
+        buffer.owner = std::move(inOwner);
+        return buffer;
+    }
+
+    bool IsView() const { return owner != nullptr; }
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t inIndex) const { return ptr[inIndex]; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+
+    // Mutable access; copies a view into owned storage first.
+    T* MutableData()
+    {
+        Detach();
+        return owned.data();
+    }
+
+    void push_back(const T& inValue)
+    {
+        Detach();
+        owned.push_back(inValue);
+        Sync();
+    }
+
+    void reserve(size_t inCount)
+    {
+        Detach();
+        owned.reserve(inCount);
+        Sync();
+    }
+
+    void resize(size_t inCount)
+    {
+        Detach();
+        owned.resize(inCount);
+        Sync();
+    }
+
+    void clear()
+    {
+        owner.reset();
+        owned.clear();
+        Sync();
+    }
+
+private:
+    void Sync()
+    {
+        ptr = owned.data();
+        count = owned.size();
+    }
+
+    void Detach()
+    {
+        if (!owner) return;
+        owned.assign(ptr, ptr + count);
+        owner.reset();
+        Sync();
+    }
+
+private:
+    std::vector<T> owned;
+    const T* ptr{nullptr};
+    size_t count{0};
+    std::shared_ptr<const void> owner;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "Mesh.h"
+
+// Binary mesh cache stored next to the source asset as "<source>.rmesh".
+// A loaded cache stays memory-mapped and the Mesh buffers (LODs included) view it directly
+// (zero copy).
+// The cache records the source size, mtime and content hash; it is stale when the size
+// or mtime changed and the content hash no longer matches. A matching hash re-stamps the mtime.
+// Indices are range-checked on load, so a corrupt cache is rejected rather than mapped.
+
+std::string GetMeshCachePath(const std::string& inSourcePath);
+
+// Map the cache for inSourcePath into outMesh. Fails when it is missing, corrupt or stale.
+bool LoadMeshCache(const std::string& inSourcePath, Mesh& outMesh);
+
+// Write the cache for inSourcePath through a temporary file and an atomic rename.
+bool SaveMeshCache(const std::string& inSourcePath, const Mesh& inMesh);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Mesh.h"
+
+// Load-time reordering for vertex reuse and overdraw: Forsyth's vertex cache optimization,
+// then Sander et al.'s overdraw clusters sorted outside-in, then vertices in first-use order.
+// The triangle order is built over position-welded corners, so flat-shaded meshes (which
+// share positions but no vertices) still come out in spatially coherent runs for meshlets.
+
+// Cache size the statistics simulate (FIFO).
+constexpr uint32_t AnalysisCacheSize = 16;
+
+// How far (as a factor) the overdraw pass may let ACMR rise within a cluster.
+constexpr float DefaultOverdrawThreshold = 1.05f;
+
+struct MeshOrderStats
+{
+    // Vertex cache misses per triangle.
+    float acmr{0.0f};
+    // The same over position-welded corners.
+    float positionAcmr{0.0f};
+    // Fragments passing the depth test per covered pixel, over six axis-aligned views.
+    float overdraw{0.0f};
+};
+
+MeshOrderStats AnalyzeMeshOrder(const VertexStreams& inVertices, const MeshBuffer<uint32_t>& inIndices);
+
+// Reorder the triangles and vertices of one level. Unreferenced vertices are dropped.
+void OptimizeMeshOrder(VertexStreams& inOutVertices, MeshBuffer<uint32_t>& inOutIndices,
+                       float inOverdrawThreshold = DefaultOverdrawThreshold);
+
+// Every level of inOutMesh. Meshlets refer to the old order, so they are cleared; build them
+// afterwards.
+void OptimizeMeshOrder(Mesh& inOutMesh, float inOverdrawThreshold = DefaultOverdrawThreshold);
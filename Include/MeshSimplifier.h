@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Mesh.h"
+
+// Quadric error metric (Garland-Heckbert) edge-collapse simplification.
+// Vertices are welded by position for the collapse, so attribute seams (hard edges, per-face
+// normals) do not split the surface apart. Collapses move one endpoint onto the other, so
+// every LOD vertex is an original vertex: each corner takes the original vertex at its
+// position whose normal best matches the simplified face.
+
+struct MeshLodSettings
+{
+    // Triangles of a level relative to the previous one.
+    float triangleRatio{0.5f};
+    // No level is built below this many triangles.
+    uint32_t minTriangles{64};
+    uint32_t maxLods{MaxMeshLods};
+};
+
+// Replace inOutMesh.lods with a chain simplified from the full-detail level.
+// Level errors are the largest collapse error so far, so they never decrease.
+void BuildMeshLods(Mesh& inOutMesh, const MeshLodSettings& inSettings = {});
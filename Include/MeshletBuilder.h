@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Mesh.h"
+
+// Split a triangle list into meshlets of at most MaxMeshletVertices vertices and
+// MaxMeshletTriangles triangles. A meshlet starts at the first free triangle in index order and
+// grows with nearby free triangles that add few vertices and face the same way, which keeps
+// the bounding spheres small and the normal cones narrow.
+MeshletBuffers BuildMeshlets(const VertexStreams& inVertices, const MeshBuffer<uint32_t>& inIndices);
+
+// Build the meshlets of every level of inOutMesh.
+void BuildMeshlets(Mesh& inOutMesh);
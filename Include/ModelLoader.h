@@ -1,13 +1,63 @@
 #pragma once
 
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include "JobSystem.h"
 #include "Logger.h"
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
 
+// Bitwise position/normal/texcoord key used to weld identical vertices.
+struct VertexWeldKey
+{
+    std::array<uint32_t, 8> bits{};
 
-inline bool LoadMesh(const std::string &filepath, Mesh &outMesh)
+    explicit VertexWeldKey(const Vertex &inV)
+    {
+        // Adding +0 folds -0 into +0 so they weld together.
+        const float values[8] = {
+            inV.position.x + 0.0f, inV.position.y + 0.0f, inV.position.z + 0.0f,
+            inV.normal.x + 0.0f, inV.normal.y + 0.0f, inV.normal.z + 0.0f,
+            inV.texcoord.x + 0.0f, inV.texcoord.y + 0.0f
+        };
+        for (size_t i = 0; i < bits.size(); ++i)
+        {
+            bits[i] = std::bit_cast<uint32_t>(values[i]);
+        }
+    }
+
+    bool operator==(const VertexWeldKey &inOther) const = default;
+};
+
+struct VertexWeldKeyHash
+{
+    size_t operator()(const VertexWeldKey &inKey) const
+    {
+        // FNV-1a over the key words.
+        uint64_t hash = 14695981039346656037ull;
+        for (const uint32_t word : inKey.bits)
+        {
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+
+// Parse an OBJ through tinyobjloader into the layout ParseObj produces.
+inline bool ParseObjWithTinyObj(const std::string &filepath, ObjData &outData)
 {
     tinyobj::ObjReaderConfig reader_config;
     reader_config.mtl_search_path = "./assets/"; // �����ļ�·�� (��Ȼ���ڻ�û�õ�)
@@ -28,91 +78,227 @@ inline bool LoadMesh(const std::string &filepath, Mesh &outMesh)
         spdlog::warn("TinyObjReader: {}", reader.Warning());
     }
 
-    auto &attrib = reader.GetAttrib();
-    auto &shapes = reader.GetShapes();
-
-    outMesh.indices.clear();
-    outMesh.vertices.clear();
+    const auto &attrib = reader.GetAttrib();
+    const auto &shapes = reader.GetShapes();
 
-    size_t indexCount = 0;
+    outData = {};
+    outData.positions = attrib.vertices;
+    outData.normals = attrib.normals;
+    outData.texcoords = attrib.texcoords;
     for (const auto &shape : shapes)
     {
-        indexCount += shape.mesh.indices.size();
+        for (const auto &idx : shape.mesh.indices)
+        {
+            outData.corners.push_back({idx.vertex_index, idx.normal_index, idx.texcoord_index});
+        }
     }
+    return true;
+}
+
+// Parse an OBJ with the built-in parser on inJobs, falling back to tinyobjloader for files it
+// doesn't handle. Without inJobs a temporary pool is spun up.
+inline bool ParseObjFile(const std::string &filepath, ObjData &outData, JobSystem *inJobs = nullptr)
+{
+    std::optional<JobSystem> localJobs;
+    JobSystem &jobs = inJobs ? *inJobs : localJobs.emplace();
+
+    const auto start = std::chrono::steady_clock::now();
+    if (ParseObj(filepath, jobs, outData))
+    {
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        spdlog::info(SPDLOG_FMT_RUNTIME("Parsed {} in {:.1f} ms on {} threads."), filepath, elapsed.count(),
+                     jobs.GetThreadCount());
+        return true;
+    }
+
+    spdlog::info(SPDLOG_FMT_RUNTIME("Parsing {} with tinyobjloader."), filepath);
+    return ParseObjWithTinyObj(filepath, outData);
+}
+
+// Parse an OBJ with both parsers and report whether they agree bit for bit.
+inline bool VerifyObjParser(const std::string &filepath, JobSystem &inJobs)
+{
+    ObjData parsed;
+    if (!ParseObj(filepath, inJobs, parsed))
+    {
+        spdlog::warn(SPDLOG_FMT_RUNTIME("{} is not supported by the built-in parser."), filepath);
+        return true;
+    }
+    ObjData reference;
+    if (!ParseObjWithTinyObj(filepath, reference)) return false;
+
+    const auto sameBits = [](const std::vector<float> &inA, const std::vector<float> &inB)
+    {
+        return inA.size() == inB.size() && std::memcmp(inA.data(), inB.data(), inA.size() * sizeof(float)) == 0;
+    };
+    const bool bMatches = sameBits(parsed.positions, reference.positions) &&
+                          sameBits(parsed.normals, reference.normals) &&
+                          sameBits(parsed.texcoords, reference.texcoords) && parsed.corners == reference.corners;
+    if (!bMatches)
+    {
+        spdlog::error(SPDLOG_FMT_RUNTIME("{}: built-in parser differs from tinyobjloader."), filepath);
+        return false;
+    }
+    spdlog::info(SPDLOG_FMT_RUNTIME("{}: {} positions, {} triangles, identical to tinyobjloader."), filepath,
+                 parsed.positions.size() / 3, parsed.corners.size() / 3);
+    return true;
+}
+
+// Parse an OBJ into a welded mesh, build its LOD chain, reorder it for vertex reuse and
+// overdraw, and build meshlets.
+inline bool LoadMeshFromObj(const std::string &filepath, Mesh &outMesh, JobSystem *inJobs = nullptr)
+{
+    ObjData data;
+    if (!ParseObjFile(filepath, data, inJobs)) return false;
+
+    outMesh = {};
+
+    const size_t indexCount = data.corners.size();
     outMesh.indices.reserve(indexCount);
-    outMesh.vertices.reserve(indexCount);
 
-    const bool hasNormals = !attrib.normals.empty();
+    // Welds identical corners so shared ones are stored and shaded once.
+    std::unordered_map<VertexWeldKey, uint32_t, VertexWeldKeyHash> weldMap;
+    weldMap.reserve(indexCount);
+    const auto emitVertex = [&](const Math::Vector3 &inPos, const Math::Vector3 &inNormal, const ObjCorner &inCorner)
+    {
+        // Corners without (or with a dangling) vt reference get (0, 0).
+        Math::Vector2 texcoord;
+        if (inCorner.texcoord >= 0 && static_cast<size_t>(inCorner.texcoord) < data.texcoords.size() / 2)
+        {
+            texcoord = {data.texcoords[2 * inCorner.texcoord + 0], data.texcoords[2 * inCorner.texcoord + 1]};
+        }
+        const Vertex vertex{inPos, inNormal, texcoord};
+        const auto [it, bInserted] = weldMap.try_emplace(VertexWeldKey{vertex},
+                                                         static_cast<uint32_t>(outMesh.vertices.Size()));
+        if (bInserted)
+        {
+            outMesh.vertices.Push(vertex);
+        }
+        outMesh.indices.push_back(it->second);
+    };
+
+    const bool hasNormals = !data.normals.empty();
 
-    for (const auto &shape : shapes)
+    for (size_t i = 0; i + 2 < data.corners.size(); i += 3)
     {
-        for (size_t i = 0; i + 2 < shape.mesh.indices.size(); i += 3)
+        const auto &idx0 = data.corners[i + 0];
+        const auto &idx1 = data.corners[i + 1];
+        const auto &idx2 = data.corners[i + 2];
+
+        Math::Vector3 p0{
+            data.positions[3 * idx0.vertex + 0],
+            data.positions[3 * idx0.vertex + 1],
+            data.positions[3 * idx0.vertex + 2]
+        };
+        Math::Vector3 p1{
+            data.positions[3 * idx1.vertex + 0],
+            data.positions[3 * idx1.vertex + 1],
+            data.positions[3 * idx1.vertex + 2]
+        };
+        Math::Vector3 p2{
+            data.positions[3 * idx2.vertex + 0],
+            data.positions[3 * idx2.vertex + 1],
+            data.positions[3 * idx2.vertex + 2]
+        };
+
+        Math::Vector3 n0{};
+        Math::Vector3 n1{};
+        Math::Vector3 n2{};
+
+        if (hasNormals && idx0.normal >= 0 && idx1.normal >= 0 && idx2.normal >= 0)
         {
-            const auto &idx0 = shape.mesh.indices[i + 0];
-            const auto &idx1 = shape.mesh.indices[i + 1];
-            const auto &idx2 = shape.mesh.indices[i + 2];
-
-            Math::Vector3 p0{
-                attrib.vertices[3 * idx0.vertex_index + 0],
-                attrib.vertices[3 * idx0.vertex_index + 1],
-                attrib.vertices[3 * idx0.vertex_index + 2]
+            n0 = {
+                data.normals[3 * idx0.normal + 0],
+                data.normals[3 * idx0.normal + 1],
+                data.normals[3 * idx0.normal + 2]
             };
-            Math::Vector3 p1{
-                attrib.vertices[3 * idx1.vertex_index + 0],
-                attrib.vertices[3 * idx1.vertex_index + 1],
-                attrib.vertices[3 * idx1.vertex_index + 2]
+            n1 = {
+                data.normals[3 * idx1.normal + 0],
+                data.normals[3 * idx1.normal + 1],
+                data.normals[3 * idx1.normal + 2]
             };
-            Math::Vector3 p2{
-                attrib.vertices[3 * idx2.vertex_index + 0],
-                attrib.vertices[3 * idx2.vertex_index + 1],
-                attrib.vertices[3 * idx2.vertex_index + 2]
+            n2 = {
+                data.normals[3 * idx2.normal + 0],
+                data.normals[3 * idx2.normal + 1],
+                data.normals[3 * idx2.normal + 2]
             };
-
-            Math::Vector3 n0{};
-            Math::Vector3 n1{};
-            Math::Vector3 n2{};
-
-            if (hasNormals && idx0.normal_index >= 0 && idx1.normal_index >= 0 && idx2.normal_index >= 0)
-            {
-                n0 = {
-                    attrib.normals[3 * idx0.normal_index + 0],
-                    attrib.normals[3 * idx0.normal_index + 1],
-                    attrib.normals[3 * idx0.normal_index + 2]
-                };
-                n1 = {
-                    attrib.normals[3 * idx1.normal_index + 0],
-                    attrib.normals[3 * idx1.normal_index + 1],
-                    attrib.normals[3 * idx1.normal_index + 2]
-                };
-                n2 = {
-                    attrib.normals[3 * idx2.normal_index + 0],
-                    attrib.normals[3 * idx2.normal_index + 1],
-                    attrib.normals[3 * idx2.normal_index + 2]
-                };
-            }
-            else
-            {
-                // OBJ has no normals; derive a flat normal per triangle.
-                Math::Vector3 faceNormal = Math::Vector3::Cross(p1 - p0, p2 - p0);
-                faceNormal.Normalize();
-                n0 = faceNormal;
-                n1 = faceNormal;
-                n2 = faceNormal;
-            }
-
-            outMesh.vertices.emplace_back(p0, n0);
-            outMesh.indices.push_back(static_cast<uint32_t>(outMesh.vertices.size() - 1));
-
-            outMesh.vertices.emplace_back(p1, n1);
-            outMesh.indices.push_back(static_cast<uint32_t>(outMesh.vertices.size() - 1));
-
-            outMesh.vertices.emplace_back(p2, n2);
-            outMesh.indices.push_back(static_cast<uint32_t>(outMesh.vertices.size() - 1));
         }
+        else
+        {
+            // OBJ has no normals; derive a flat normal per triangle.
+            Math::Vector3 faceNormal = Math::Vector3::Cross(p1 - p0, p2 - p0);
+            faceNormal.Normalize();
+            n0 = faceNormal;
+            n1 = faceNormal;
+            n2 = faceNormal;
+        }
+
+        emitVertex(p0, n0, idx0);
+        emitVertex(p1, n1, idx1);
+        emitVertex(p2, n2, idx2);
+    }
+
+    outMesh.bounds = ComputeBounds(outMesh.vertices);
+
+    // Vertex reuse: how many triangle corners reference each unique vertex on average.
+    const size_t vertexCount = outMesh.vertices.Size();
+    const double reuse = vertexCount == 0 ? 0.0 : static_cast<double>(outMesh.indices.size()) / vertexCount;
+    spdlog::info(SPDLOG_FMT_RUNTIME("Loaded {}: {} vertices, {} triangles, vertex reuse {:.2f}x."), filepath,
+                 vertexCount, outMesh.indices.size() / 3, reuse);
+
+    BuildMeshLods(outMesh);
+    if (!outMesh.lods.empty())
+    {
+        const MeshLod &coarsest = outMesh.lods.back();
+        spdlog::info("Built {} LODs, coarsest {} triangles at error {:.4f}.", outMesh.lods.size(),
+                     coarsest.indices.size() / 3, coarsest.error);
     }
 
-    spdlog::info(SPDLOG_FMT_RUNTIME("Loaded {}: {} vertices, {} triangles."), filepath,
-                 outMesh.vertices.size(), outMesh.indices.size() / 3);
+    const MeshOrderStats before = AnalyzeMeshOrder(outMesh.vertices, outMesh.indices);
+    OptimizeMeshOrder(outMesh);
+    const MeshOrderStats after = AnalyzeMeshOrder(outMesh.vertices, outMesh.indices);
+    spdlog::info("Reordered triangles: ACMR {:.3f} -> {:.3f} (by position {:.3f} -> {:.3f}), overdraw {:.3f} -> {:.3f}.",
+                 before.acmr, after.acmr, before.positionAcmr, after.positionAcmr, before.overdraw, after.overdraw);
+
+    BuildMeshlets(outMesh);
+    spdlog::info("Split into {} meshlets.", outMesh.clusters.meshlets.size());
+
+    return true;
+}
+
+// Load a mesh, preferring the binary cache next to the source.
+// A missing or stale cache is rebuilt from the source and written back.
+inline bool LoadMesh(const std::string &filepath, Mesh &outMesh, const bool bUseCache = true,
+                     JobSystem *inJobs = nullptr)
+{
+    if (bUseCache && LoadMeshCache(filepath, outMesh))
+    {
+        spdlog::info(SPDLOG_FMT_RUNTIME("Loaded {} from cache: {} vertices, {} triangles, {} LODs."), filepath,
+                     outMesh.vertices.Size(), outMesh.indices.size() / 3, outMesh.lods.size());
+        return true;
+    }
+
+    if (!LoadMeshFromObj(filepath, outMesh, inJobs)) return false;
+
+    if (bUseCache && !SaveMeshCache(filepath, outMesh))
+    {
+        spdlog::warn("Could not write mesh cache {}.", GetMeshCachePath(filepath));
+    }
+    return true;
+}
+
+// Rebuild the cache for a source asset regardless of its current state.
+inline bool BakeMeshCache(const std::string &filepath, JobSystem *inJobs = nullptr)
+{
+    Mesh mesh;
+    if (!LoadMeshFromObj(filepath, mesh, inJobs)) return false;
+
+    if (!SaveMeshCache(filepath, mesh))
+    {
+        spdlog::error("Could not write mesh cache {}.", GetMeshCachePath(filepath));
+        return false;
+    }
 
+    spdlog::info("Baked {}.", GetMeshCachePath(filepath));
     return true;
 }
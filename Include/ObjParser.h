@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// One triangle corner; -1 where the face gave no normal or texcoord.
+struct ObjCorner
+{
+    int32_t vertex{-1};
+    int32_t normal{-1};
+    int32_t texcoord{-1};
+
+    bool operator==(const ObjCorner& inOther) const = default;
+};
+
+// Triangulated OBJ geometry in tinyobjloader's layout: flat attribute arrays and three corners
+// per triangle, faces of all groups concatenated in file order.
+struct ObjData
+{
+    std::vector<float> positions;   // xyz
+    std::vector<float> normals;     // xyz
+    std::vector<float> texcoords;   // uv
+    std::vector<ObjCorner> corners;
+};
+
+// Built-in OBJ parser: maps the file, cuts it into chunks at line boundaries and parses the
+// v/vn/vt/f records of every chunk on inJobs, then merges the chunks with prefix sums.
+// Numbers, relative indices and the quad split follow tinyobjloader (triangulate = true), so
+// the result matches it bit for bit. Returns false when the file can't be mapped or needs
+// something only tinyobjloader handles (polygons with more than four corners, zero or
+// out-of-range indices); callers fall back to tinyobjloader then.
+bool ParseObj(const std::string& inPath, JobSystem& inJobs, ObjData& outData);
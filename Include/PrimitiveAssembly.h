@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Renderer.h"
+#include "Vector.h"
+
+// Winding of front-facing triangles as seen on screen.
+enum class FrontFace : uint8_t
+{
+    Clockwise,
+    CounterClockwise
+};
+
+enum class CullMode : uint8_t
+{
+    None,
+    Back,
+    Front
+};
+
+struct PrimitiveAssemblyConfig
+{
+    CullMode cullMode{CullMode::Back};
+    // Meshes in this repo (CreateCube, the sample OBJs) are wound clockwise.
+    FrontFace frontFace{FrontFace::Clockwise};
+    // Reverse-Z projection (PerspectiveFovReverseLH): the near plane is z = w, the far plane z = 0.
+    bool bReverseZ{false};
+};
+
+// Per-stage triangle counters.
+struct PrimitiveStats
+{
+    uint64_t trianglesIn{0};
+    // Entirely outside one clip plane.
+    uint64_t frustumCulled{0};
+    // Facing away by the configured winding, or seen edge-on.
+    uint64_t backFaceCulled{0};
+    // Crossed the near plane and were clipped into one or two triangles.
+    uint64_t nearClipped{0};
+    uint64_t trianglesOut{0};
+
+    PrimitiveStats& operator+=(const PrimitiveStats& inOther)
+    {
+        trianglesIn += inOther.trianglesIn;
+        frustumCulled += inOther.frustumCulled;
+        backFaceCulled += inOther.backFaceCulled;
+        nearClipped += inOther.nearClipped;
+        trianglesOut += inOther.trianglesOut;
+        return *this;
+    }
+};
+
+// Clip-space outcode bits. Depth range is [0, w] (PerspectiveFovLH), near at 0 unless reversed.
+enum ClipOutcode : uint32_t
+{
+    ClipLeft = 1 << 0,
+    ClipRight = 1 << 1,
+    ClipBottom = 1 << 2,
+    ClipTop = 1 << 3,
+    ClipNear = 1 << 4,
+    ClipFar = 1 << 5
+};
+
+// Clip-space distance past the near plane: negative on the camera side of it.
+inline float NearPlaneDistance(const Math::Vector4 &clip, const bool bReverseZ)
+{
+    return bReverseZ ? clip.w - clip.z : clip.z;
+}
+
+inline uint32_t ComputeOutcode(const Math::Vector4 &clip, const bool bReverseZ)
+{
+    uint32_t code = 0;
+    if (clip.x < -clip.w) code |= ClipLeft;
+    if (clip.x > clip.w) code |= ClipRight;
+    if (clip.y < -clip.w) code |= ClipBottom;
+    if (clip.y > clip.w) code |= ClipTop;
+    if (NearPlaneDistance(clip, bReverseZ) < 0.0f) code |= ClipNear;
+    if (bReverseZ ? clip.z < 0.0f : clip.z > clip.w) code |= ClipFar;
+    return code;
+}
+
+// Vertex where edge a-b crosses the near plane; attributes are linear in clip space.
+inline VSOutput ClipNearEdge(const VSOutput &a, const VSOutput &b, int width, int height, const bool bReverseZ)
+{
+    const float distanceA = NearPlaneDistance(a.clipPos, bReverseZ);
+    const float t = distanceA / (distanceA - NearPlaneDistance(b.clipPos, bReverseZ));
+
+    VSOutput out;
+    out.clipPos.x = a.clipPos.x + (b.clipPos.x - a.clipPos.x) * t;
+    out.clipPos.y = a.clipPos.y + (b.clipPos.y - a.clipPos.y) * t;
+    out.clipPos.w = a.clipPos.w + (b.clipPos.w - a.clipPos.w) * t;
+    out.clipPos.z = bReverseZ ? out.clipPos.w : 0.0f;
+    for (int i = 0; i < MaxVaryings; ++i)
+    {
+        out.varyings[i] = a.varyings[i] + (b.varyings[i] - a.varyings[i]) * t;
+    }
+    out.screenPos = ViewportTransform(out.clipPos, width, height);
+    return out;
+}
+
+// Primitive assembly between the vertex stage and the rasterizer:
+// frustum trivial reject, back-face culling, then homogeneous near-plane clipping.
+// emit(v0, v1, v2) is called for every surviving triangle with screenPos filled in.
+template<typename EmitFunc>
+void AssembleTriangle(const VSOutput &v0, const VSOutput &v1, const VSOutput &v2,
+                      const PrimitiveAssemblyConfig &config, int width, int height,
+                      PrimitiveStats &stats, EmitFunc &&emit)
+{
+    ++stats.trianglesIn;
+
+    // 1. All three vertices outside the same plane.
+    const uint32_t code0 = ComputeOutcode(v0.clipPos, config.bReverseZ);
+    const uint32_t code1 = ComputeOutcode(v1.clipPos, config.bReverseZ);
+    const uint32_t code2 = ComputeOutcode(v2.clipPos, config.bReverseZ);
+    if (code0 & code1 & code2)
+    {
+        ++stats.frustumCulled;
+        return;
+    }
+
+    // 2. Winding from the homogeneous (x, y, w) determinant. Its sign tells which side of
+    // the triangle's plane the eye is on, so it is valid before clipping, even across w = 0.
+    // Positive means counter-clockwise on screen.
+    if (config.cullMode != CullMode::None)
+    {
+        const Math::Vector4 &p0 = v0.clipPos;
+        const Math::Vector4 &p1 = v1.clipPos;
+        const Math::Vector4 &p2 = v2.clipPos;
+        const float det = p0.x * (p1.y * p2.w - p2.y * p1.w) +
+                          p1.x * (p2.y * p0.w - p0.y * p2.w) +
+                          p2.x * (p0.y * p1.w - p1.y * p0.w);
+
+        const bool bFrontFacing = config.frontFace == FrontFace::CounterClockwise ? det > 0.0f : det < 0.0f;
+        const bool bCulled = config.cullMode == CullMode::Back ? !bFrontFacing : bFrontFacing;
+        if (bCulled || det == 0.0f)
+        {
+            ++stats.backFaceCulled;
+            return;
+        }
+    }
+
+    // 3. Fully in front of the near plane: nothing to clip.
+    if (!((code0 | code1 | code2) & ClipNear))
+    {
+        ++stats.trianglesOut;
+        emit(v0, v1, v2);
+        return;
+    }
+
+    // Sutherland-Hodgman against the near plane. One plane turns a triangle into at most a quad.
+    ++stats.nearClipped;
+    const VSOutput *in[3] = {&v0, &v1, &v2};
+    VSOutput poly[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const VSOutput &a = *in[i];
+        const VSOutput &b = *in[(i + 1) % 3];
+        const bool bInsideA = NearPlaneDistance(a.clipPos, config.bReverseZ) >= 0.0f;
+        const bool bInsideB = NearPlaneDistance(b.clipPos, config.bReverseZ) >= 0.0f;
+        if (bInsideA) poly[count++] = a;
+        if (bInsideA != bInsideB) poly[count++] = ClipNearEdge(a, b, width, height, config.bReverseZ);
+    }
+
+    // Fan, keeping the original winding.
+    for (int i = 1; i + 1 < count; ++i)
+    {
+        ++stats.trianglesOut;
+        emit(poly[0], poly[i], poly[i + 1]);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compile-time switch (CMake option RENDERER_PROFILER). When 0, PROFILE_SCOPE expands to
+// nothing and the event rings are compiled out; when 1, a disabled profiler costs one relaxed
+// load per scope and EndFrame returns right away.
+#ifndef RENDERER_PROFILER
+#define RENDERER_PROFILER 1
+#endif
+
+// Scoped-timer instrumentation. Every thread records into its own ring buffer, so
+// recording never takes a lock; readers (overlay, trace export) run between frames.
+namespace Profiler
+{
+    // Events kept per thread; older ones are overwritten.
+    constexpr uint32_t RingCapacity = 1 << 15;
+
+    struct Event
+    {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+
+    // Per-stage timings of the last frame, smoothed for display.
+    struct StageStats
+    {
+        const char* name{nullptr};
+        double lastMs{0.0};
+        double averageMs{0.0};
+        uint32_t calls{0};
+    };
+
+    namespace Detail
+    {
+        extern std::atomic<bool> bEnabled;
+    }
+
+    inline bool IsEnabled() { return Detail::bEnabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool bInEnabled);
+
+    // Nanoseconds since the profiler's epoch.
+    uint64_t Now();
+
+    // Append to the calling thread's ring. inName must outlive the profiler (string literal).
+    void Record(const char* inName, uint64_t inStartNs, uint64_t inEndNs);
+
+    // Label for the calling thread in the trace.
+    void SetThreadName(const std::string& inName);
+
+    // Close the current frame and aggregate its events per stage. Main thread only,
+    // while no jobs are running.
+    void EndFrame();
+    const std::vector<StageStats>& GetStageStats();
+    double GetFrameMs();
+
+    // Everything still in the rings as Chrome trace-event JSON (chrome://tracing, Perfetto).
+    bool WriteChromeTrace(const std::string& inPath);
+
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const char* inName) : name(IsEnabled() ? inName : nullptr), start(name ? Now() : 0) {}
+        ~ScopedTimer()
+        {
+            if (name) Record(name, start, Now());
+        }
+
+        // Non-copyable.
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        const char* name;
+        uint64_t start;
+    };
+}
+
+#if RENDERER_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) const Profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
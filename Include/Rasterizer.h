@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameArena.h"
+#include "Shaders.h"
+#include "Vector.h"
+
+class JobSystem;
+
+// Edge length of the hierarchical-Z blocks.
+constexpr int HiZBlockSize = 8;
+// hiZState flag: hiZMax is out of date (still conservative) and may be recomputed.
+constexpr uint8_t HiZDirty = 1;
+// Samples per pixel of the multisample planes.
+constexpr int MsaaSamples = 4;
+
+// Storage of the depth planes. Depth is tested as stored, so the unorm formats trade
+// precision for bandwidth: Unorm16 moves half the bytes of Float32.
+enum class DepthFormat : uint8_t
+{
+    Float32,
+    // Fixed point in the low 24 bits of a 32-bit word.
+    Unorm24,
+    Unorm16
+};
+
+inline const char* GetDepthFormatName(const DepthFormat inFormat)
+{
+    switch (inFormat)
+    {
+    case DepthFormat::Float32: return "float32";
+    case DepthFormat::Unorm24: return "unorm24";
+    case DepthFormat::Unorm16: return "unorm16";
+    }
+    return "unknown";
+}
+
+// Bytes per pixel (or sample) of a depth plane.
+inline size_t GetDepthFormatSize(const DepthFormat inFormat)
+{
+    return inFormat == DepthFormat::Unorm16 ? 2 : 4;
+}
+
+// Depth the planes are cleared to: the far plane, 1, or 0 with reverse-Z.
+inline float GetFarDepth(const bool bReverseZ)
+{
+    return bReverseZ ? 0.0f : 1.0f;
+}
+
+// Color and depth planes the rasterizer writes into.
+struct RenderTarget
+{
+    uint32_t* color{nullptr};
+    // Pixels per color row. The color plane may be locked texture memory with padded rows;
+    // every other plane is tightly packed (width).
+    uint32_t colorPitch{0};
+    // In depthFormat, like sampleDepth.
+    void* depth{nullptr};
+    uint32_t width{0};
+    uint32_t height{0};
+
+    // Coarse depth per HiZBlockSize x HiZBlockSize block: nearest and farthest stored depth.
+    // hiZMax may lag behind (too far), which only makes rejection more conservative.
+    // hiZCoverage has one bit per pixel written since the last clear (one word per sample and
+    // block with multisampling); hiZMax is only recomputed once a block is fully covered.
+    float* hiZMin{nullptr};
+    float* hiZMax{nullptr};
+    uint64_t* hiZCoverage{nullptr};
+    uint8_t* hiZState{nullptr};
+    uint32_t hiZWidth{0};
+
+    // Visibility buffer: triangle index + 1 per pixel, 0 = nothing. When set, the tile
+    // rasterizer only writes depth and IDs, then shades each visible pixel once.
+    uint32_t* visibility{nullptr};
+
+    // Multisampling when set: coverage and depth are tested per sample, and the color plane
+    // only receives the resolve (ResolveSamples). The samples of each Simd::Width-pixel span
+    // are stored together (GetSampleSpanOffset). A pixel flagged in sampleUniform has the
+    // same color in every sample and only its first sample is kept up to date.
+    void* sampleDepth{nullptr};
+    uint32_t* sampleColor{nullptr};
+    uint32_t* sampleUniform{nullptr};
+    // Pixels per row of the sample planes: width rounded up to whole spans.
+    uint32_t samplePitch{0};
+
+    // Tiled layout when set: color, depth and visibility are stored in HiZBlockSize x
+    // HiZBlockSize tiles, tiles row by row and the rows of a tile back to back, so a block is
+    // one run of memory. tilesX is the number of tiles per row; 0 keeps rows linear. A tiled
+    // color plane goes through DetileColor before it is shown.
+    uint32_t tilesX{0};
+
+    // Format of depth and sampleDepth.
+    DepthFormat depthFormat{DepthFormat::Float32};
+    // Screen z comes from PerspectiveFovReverseLH, larger when nearer. The rasterizer negates it
+    // on the way in, so stored depth (and hiZ) still grows with distance, from -1 to 0.
+    bool bReverseZ{false};
+};
+
+// Pixel (x, y) of a plane is at GetRowOffset(y) + GetColumnOffset(x) in either layout. A span
+// of Simd::Width pixels starting at a multiple of Simd::Width is contiguous in both.
+// pitch: pixels per row of the linear layout.
+inline size_t GetRowOffset(const RenderTarget& target, const int y, const uint32_t pitch)
+{
+    if (target.tilesX == 0) return static_cast<size_t>(y) * pitch;
+    return (static_cast<size_t>(y / HiZBlockSize) * target.tilesX * HiZBlockSize + y % HiZBlockSize) * HiZBlockSize;
+}
+
+inline size_t GetColumnOffset(const RenderTarget& target, const int x)
+{
+    if (target.tilesX == 0) return static_cast<size_t>(x);
+    return static_cast<size_t>(x / HiZBlockSize) * HiZBlockSize * HiZBlockSize + x % HiZBlockSize;
+}
+
+// Pixels a plane of width x height takes in the layout of tilesX (0: linear).
+inline size_t GetPlaneSize(const uint32_t width, const uint32_t height, const uint32_t tilesX)
+{
+    if (tilesX == 0) return static_cast<size_t>(width) * height;
+    const size_t tilesY = (height + HiZBlockSize - 1) / HiZBlockSize;
+    return tilesX * tilesY * HiZBlockSize * HiZBlockSize;
+}
+
+// First sample of the span starting at pixel x (a multiple of Simd::Width) of row y; sample
+// s of the span follows at s * Simd::Width.
+inline size_t GetSampleSpanOffset(const RenderTarget& target, const int x, const int y)
+{
+    return (static_cast<size_t>(y) * target.samplePitch + x) * MsaaSamples;
+}
+
+// Inclusive pixel rectangle.
+struct TileRect
+{
+    int minX{0}, minY{0}, maxX{-1}, maxY{-1};
+};
+
+// Screen-space triangle ready for rasterization.
+struct ScreenTriangle
+{
+    Math::Vector3 s[3];
+    // Vertex shader output per vertex; the fragment shader reads the first FS::VaryingCount.
+    float varyings[3][MaxVaryings];
+    uint32_t baseColor{0};
+    // 1 / clip w per vertex, for perspective-correct interpolation of textured shaders.
+    float invW[3]{1.0f, 1.0f, 1.0f};
+    const Texture* texture{nullptr};
+};
+
+// Barycentric coords for a 2D triangle.
+Math::Vector3 ComputeBarycentric2D(float x, float y, const Math::Vector3* inV);
+
+// Fill the part of a triangle that lies inside rect, shaded by the fragment shader FS, into
+// a target whose depth planes are in Format.
+// Instantiated in Rasterizer.cpp for the shaders of Shaders.h and every DepthFormat.
+template<typename FS, DepthFormat Format>
+void RasterizeTriangle(const RenderTarget& target, const TileRect& rect, const ScreenTriangle& tri,
+                       const SimdLighting& lighting);
+
+// As above, with coverage and depth per sample of the multisample planes; FS runs once per
+// pixel a triangle touches.
+template<typename FS, DepthFormat Format>
+void RasterizeTriangleMultisample(const RenderTarget& target, const TileRect& rect, const ScreenTriangle& tri,
+                                  const SimdLighting& lighting);
+
+// Average the samples of every pixel into the color plane; flagged pixels copy their first sample.
+void ResolveSamples(const RenderTarget& target, JobSystem& jobs);
+
+// Copy a tiled color plane into row-major outColor with outPitch pixels per row.
+void DetileColor(const RenderTarget& target, uint32_t* outColor, uint32_t outPitch, JobSystem& jobs);
+
+// Visibility pass: depth test as above, but store triangleId + 1 instead of a color.
+template<DepthFormat Format>
+void RasterizeTriangleId(const RenderTarget& target, const TileRect& rect, const ScreenTriangle& tri,
+                         uint32_t triangleId);
+
+// Depth-only fast path for shadow maps: coverage and depth test into target.depth, nothing
+// else. No varyings, color or hierarchical Z, so the target needs only its depth plane, in
+// Float32.
+void RasterizeDepthOnly(const RenderTarget& target, const TileRect& rect, const ScreenTriangle& tri,
+                        const SimdLighting& lighting);
+
+// Barycentric planes of a screen triangle: w0 = a0 * x + b0 * y + c0, w1 likewise.
+struct TriangleSetup
+{
+    float a0, b0, c0;
+    float a1, b1, c1;
+};
+
+TriangleSetup ComputeTriangleSetup(const ScreenTriangle& tri);
+
+// Shade every pixel of rect with a triangle ID using FS and reset the ID to 0.
+template<typename FS, DepthFormat Format>
+void ShadeVisibility(const RenderTarget& target, const TileRect& rect, const ScreenTriangle* triangles,
+                     const TriangleSetup* setups, const SimdLighting& lighting);
+
+// Fill inCount values of a depth plane in inFormat with the far depth (GetFarDepth).
+void ClearDepth(void* outDepth, size_t inCount, DepthFormat inFormat, bool bReverseZ);
+
+// Rasterizer entry points of one fragment shader and depth format, chosen once per flush
+// instead of per pixel.
+struct RasterPipeline
+{
+    void (*rasterize)(const RenderTarget&, const TileRect&, const ScreenTriangle&, const SimdLighting&){nullptr};
+    void (*rasterizeMultisample)(const RenderTarget&, const TileRect&, const ScreenTriangle&,
+                                 const SimdLighting&){nullptr};
+    void (*rasterizeId)(const RenderTarget&, const TileRect&, const ScreenTriangle&, uint32_t){nullptr};
+    void (*shadeVisibility)(const RenderTarget&, const TileRect&, const ScreenTriangle*, const TriangleSetup*,
+                            const SimdLighting&){nullptr};
+    Lighting lighting;
+
+    // inFormat: depthFormat of the targets the pipeline draws into.
+    template<typename FS>
+    static RasterPipeline Create(const Lighting& inLighting, const DepthFormat inFormat)
+    {
+        switch (inFormat)
+        {
+        case DepthFormat::Unorm24: return Create<FS, DepthFormat::Unorm24>(inLighting);
+        case DepthFormat::Unorm16: return Create<FS, DepthFormat::Unorm16>(inLighting);
+        default: return Create<FS, DepthFormat::Float32>(inLighting);
+        }
+    }
+
+    template<typename FS, DepthFormat Format>
+    static RasterPipeline Create(const Lighting& inLighting)
+    {
+        return {&RasterizeTriangle<FS, Format>, &RasterizeTriangleMultisample<FS, Format>, &RasterizeTriangleId<Format>,
+                &ShadeVisibility<FS, Format>, inLighting};
+    }
+
+    // For depth-only targets (no visibility or sample planes).
+    static RasterPipeline CreateDepthOnly() { return {&RasterizeDepthOnly, nullptr, nullptr, nullptr, {}}; }
+};
+
+// Sorts triangles into fixed-size screen tiles and rasterizes the tiles in parallel.
+// Every tile is owned by a single thread, and triangles inside a tile are drawn in
+// submission order, so the result matches drawing them one by one.
+// With a visibility buffer in the target each tile is shaded right after its raster pass;
+// a target with sample planes is drawn multisampled.
+// Submitted triangles, bins and setups are frame data: they come from the FrameArena given to
+// BeginFrame, the bins of each binning job from its own thread's arena.
+class TileRasterizer
+{
+public:
+    static constexpr int TileSize = 64;
+
+    void Resize(uint32_t inWidth, uint32_t inHeight);
+
+    // Once per frame after inArena was reset, before the first Submit.
+    void BeginFrame(FrameArena& inArena);
+
+    void Submit(const ScreenTriangle& tri)
+    {
+        if (triangleCount == triangleCapacity) GrowTriangles();
+        triangles[triangleCount++] = tri;
+    }
+    // Bin and draw everything submitted since the last flush.
+    void Flush(const RenderTarget& target, JobSystem& jobs, const RasterPipeline& pipeline);
+
+    size_t GetPendingCount() const { return triangleCount; }
+
+    // Arena bytes a flush takes per binning thread regardless of the triangles: a bin table
+    // and about one chunk per tile. Depends on the size only, for presizing at Resize.
+    size_t GetFlushBytesPerThread() const;
+
+private:
+    TileRect GetTileRect(uint32_t tileIndex) const;
+    void GrowTriangles();
+
+    // Triangle indices of one tile from one binning slice, as a list of chunks.
+    static constexpr uint32_t BinChunkSize = 29;
+    struct BinChunk
+    {
+        uint32_t count;
+        uint32_t indices[BinChunkSize];
+        BinChunk* next;
+    };
+    static_assert(sizeof(BinChunk) == 128, "Bin chunks are two cache lines.");
+
+    struct Bin
+    {
+        BinChunk* first;
+        BinChunk* last;
+    };
+
+private:
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t tilesX{0};
+    uint32_t tilesY{0};
+
+    FrameArena* arena{nullptr};
+    ScreenTriangle* triangles{nullptr};
+    size_t triangleCount{0};
+    size_t triangleCapacity{0};
+    // Most triangles of a flush so far; the per-frame array starts at this size.
+    size_t peakTriangles{0};
+};
@@ -1,7 +1,11 @@
 ﻿#pragma once
 
+#include <algorithm>
 #include <cstdlib>
 
+#include "Mesh.h"
+#include "Shaders.h"
+#include "Simd.h"
 #include "Vector.h"
 
 inline Math::Vector3 ViewportTransform(const Math::Vector4 &clipPos, int width, int height)
@@ -27,54 +31,163 @@ inline Math::Vector3 ViewportTransform(const Math::Vector4 &clipPos, int width,
 struct VSOutput
 {
     Math::Vector4 clipPos{};
-    Math::Vector3 worldNormal{};
+    // Written by the vertex shader; only the first VS::VaryingCount are meaningful.
+    float varyings[MaxVaryings]{};
+    // Filled by the batch stage after ViewportTransform.
+    Math::Vector3 screenPos{};
 };
 
-// Transform a position into clip space (column-major).
-inline Math::Vector4 VertexShader(const Math::Vector3 &inPos, const Math::Matrix44 &mvp)
+// Vertex shader VS plus the perspective divide and viewport transform for Simd::Width
+// vertices at a time.
+template<typename VS>
+class VertexBatchShader
 {
-    // Column-major: clip = M * vec4
-    Math::Vector4 clip;
-
-    clip.x =
-            inPos.x * mvp.data[0] +
-            inPos.y * mvp.data[4] +
-            inPos.z * mvp.data[8] +
-            1.0f * mvp.data[12];
-
-    clip.y =
-            inPos.x * mvp.data[1] +
-            inPos.y * mvp.data[5] +
-            inPos.z * mvp.data[9] +
-            1.0f * mvp.data[13];
-
-    clip.z =
-            inPos.x * mvp.data[2] +
-            inPos.y * mvp.data[6] +
-            inPos.z * mvp.data[10] +
-            1.0f * mvp.data[14];
-
-    clip.w =
-            inPos.x * mvp.data[3] +
-            inPos.y * mvp.data[7] +
-            inPos.z * mvp.data[11] +
-            1.0f * mvp.data[15];
-
-    return clip;
+public:
+    VertexBatchShader(const ShaderUniforms &inUniforms, int width, int height)
+        : uniforms(inUniforms),
+          halfWidth(Simd::Float::Broadcast(0.5f * static_cast<float>(width))),
+          halfHeight(Simd::Float::Broadcast(0.5f * static_cast<float>(height)))
+    {
+    }
+
+    // Shade one batch and write its first count lanes to out[0, count).
+    void Shade(const VertexLanes &in, VSOutput *out, int count) const
+    {
+        using Simd::Float;
+        constexpr int W = Simd::Width;
+        constexpr int Varying = VS::VaryingCount;
+        const Float one = Float::Broadcast(1.0f);
+
+        Float clip[4];
+        Varyings<Varying> varyings;
+        VS::Run(in, uniforms, clip, varyings);
+
+        // Perspective divide and NDC -> screen, Y flipped.
+        const Float invW = one / clip[3];
+        const Float sx = (clip[0] * invW + one) * halfWidth;
+        const Float sy = (one - clip[1] * invW) * halfHeight;
+        const Float sz = clip[2] * invW;
+
+        alignas(32) float lanes[7 + Varying][W];
+        const Float *results[7] = {&clip[0], &clip[1], &clip[2], &clip[3], &sx, &sy, &sz};
+        for (int k = 0; k < 7; ++k)
+        {
+            results[k]->Store(lanes[k]);
+        }
+        for (int k = 0; k < Varying; ++k)
+        {
+            varyings[k].Store(lanes[7 + k]);
+        }
+        for (int l = 0; l < count; ++l)
+        {
+            VSOutput &o = out[l];
+            o.clipPos = {lanes[0][l], lanes[1][l], lanes[2][l], lanes[3][l]};
+            o.screenPos = {lanes[4][l], lanes[5][l], lanes[6][l]};
+            for (int k = 0; k < Varying; ++k)
+            {
+                o.varyings[k] = lanes[7 + k][l];
+            }
+        }
+    }
+
+    // Gather vertices inIndices[0, count) of the streams into one batch; the last one is
+    // repeated into the unused lanes.
+    static VertexLanes Gather(const VertexStreams &inStreams, const uint32_t *inIndices, int count)
+    {
+        using Simd::Float;
+        constexpr int W = Simd::Width;
+        const MeshBuffer<float> *streams[8] = {
+            &inStreams.positionX, &inStreams.positionY, &inStreams.positionZ,
+            &inStreams.normalX, &inStreams.normalY, &inStreams.normalZ,
+            &inStreams.texcoordU, &inStreams.texcoordV
+        };
+        alignas(32) float attributes[8][W];
+        for (int k = 0; k < 8; ++k)
+        {
+            for (int l = 0; l < W; ++l)
+            {
+                attributes[k][l] = (*streams[k])[inIndices[std::min(l, count - 1)]];
+            }
+        }
+        return {
+            Float::Load(attributes[0]), Float::Load(attributes[1]), Float::Load(attributes[2]),
+            Float::Load(attributes[3]), Float::Load(attributes[4]), Float::Load(attributes[5]),
+            Float::Load(attributes[6]), Float::Load(attributes[7])
+        };
+    }
+
+private:
+    SimdUniforms uniforms;
+    Simd::Float halfWidth;
+    Simd::Float halfHeight;
+};
+
+// Batch vertex stage: runs the vertex shader VS on vertices [begin, end) of the streams,
+// does the perspective divide and viewport transform in the same pass, and writes to
+// out[begin, end). Simd::Width vertices per instruction; the tail is a padded batch.
+template<typename VS>
+void ProcessVertices(const VertexStreams &inStreams, size_t begin, size_t end, const ShaderUniforms &inUniforms,
+                     int width, int height, VSOutput *out)
+{
+    using Simd::Float;
+    constexpr int W = Simd::Width;
+    const VertexBatchShader<VS> shader(inUniforms, width, height);
+
+    size_t i = begin;
+    for (; i + W <= end; i += W)
+    {
+        const VertexLanes in{
+            Float::Load(&inStreams.positionX[i]), Float::Load(&inStreams.positionY[i]),
+            Float::Load(&inStreams.positionZ[i]), Float::Load(&inStreams.normalX[i]),
+            Float::Load(&inStreams.normalY[i]), Float::Load(&inStreams.normalZ[i]),
+            Float::Load(&inStreams.texcoordU[i]), Float::Load(&inStreams.texcoordV[i])
+        };
+        shader.Shade(in, out + i, W);
+    }
+
+    if (i < end)
+    {
+        uint32_t tail[W];
+        const int count = static_cast<int>(end - i);
+        for (int l = 0; l < count; ++l)
+        {
+            tail[l] = static_cast<uint32_t>(i + l);
+        }
+        shader.Shade(VertexBatchShader<VS>::Gather(inStreams, tail, count), out + i, count);
+    }
 }
 
-inline VSOutput VertexShader(const Vertex &inV, const Math::Matrix44 &model, const Math::Matrix44 &mvp)
+// Indexed variant: shades vertices inIndices[0, count) of the streams into out[0, count),
+// e.g. the vertex list of a meshlet.
+template<typename VS>
+void ProcessVertices(const VertexStreams &inStreams, const uint32_t *inIndices, size_t count,
+                     const ShaderUniforms &inUniforms, int width, int height, VSOutput *out)
 {
-    VSOutput output;
-    // 1. 位置变换到裁剪空间 (用于光栅化)
-    output.clipPos = VertexShader(inV.position, mvp);
-
-    // 2. 法线变换到世界空间 (用于光照计算)
-    // 注意：只取 Model 矩阵左上角 3x3 部分进行方向变换
-    output.worldNormal.x = inV.normal.x * model.data[0] + inV.normal.y * model.data[4] + inV.normal.z * model.data[8];
-    output.worldNormal.y = inV.normal.x * model.data[1] + inV.normal.y * model.data[5] + inV.normal.z * model.data[9];
-    output.worldNormal.z = inV.normal.x * model.data[2] + inV.normal.y * model.data[6] + inV.normal.z * model.data[10];
-    output.worldNormal.Normalize();
-
-    return output;
+    using Simd::Float;
+    constexpr int W = Simd::Width;
+    const VertexBatchShader<VS> shader(inUniforms, width, height);
+    for (size_t i = 0; i < count; i += W)
+    {
+        const int batch = static_cast<int>(std::min<size_t>(W, count - i));
+
+        // Runs of consecutive indices (common after in-order meshlet building) load directly.
+        bool bContiguous = batch == W;
+        for (int l = 1; l < batch && bContiguous; ++l)
+        {
+            bContiguous = inIndices[i + l] == inIndices[i] + l;
+        }
+        if (bContiguous)
+        {
+            const size_t v = inIndices[i];
+            const VertexLanes in{
+                Float::Load(&inStreams.positionX[v]), Float::Load(&inStreams.positionY[v]),
+                Float::Load(&inStreams.positionZ[v]), Float::Load(&inStreams.normalX[v]),
+                Float::Load(&inStreams.normalY[v]), Float::Load(&inStreams.normalZ[v]),
+                Float::Load(&inStreams.texcoordU[v]), Float::Load(&inStreams.texcoordV[v])
+            };
+            shader.Shade(in, out + i, W);
+            continue;
+        }
+        shader.Shade(VertexBatchShader<VS>::Gather(inStreams, inIndices + i, batch), out + i, batch);
+    }
 }
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+#include "Vector.h"
+
+class Texture;
+
+// Index of a mesh asset in a Scene.
+using MeshHandle = uint32_t;
+
+// One placed copy of a shared mesh.
+struct Instance
+{
+    MeshHandle mesh{0};
+    Math::Matrix44 model;
+    uint32_t baseColor{0xFFCCCCCC};
+    // Not owned; null draws untextured.
+    const Texture* texture{nullptr};
+    // Mesh bounds transformed by model.
+    Bounds worldBounds;
+};
+
+// Clip planes of a view-projection matrix as (n, d) with n . p + d >= 0 inside and unit n.
+// Depth range is [0, w] (PerspectiveFovLH).
+struct Frustum
+{
+    Math::Vector4 planes[6];
+
+    static Frustum FromViewProjection(const Math::Matrix44& inViewProj);
+};
+
+// World-space camera position of a view matrix with an orthonormal rotation part.
+Math::Vector3 GetViewPosition(const Math::Matrix44& inView);
+
+enum class FrustumTest : uint8_t
+{
+    Outside,
+    Intersects,
+    Inside
+};
+
+FrustumTest TestBounds(const Frustum& inFrustum, const Bounds& inBounds);
+bool IsSphereOutside(const Frustum& inFrustum, const Math::Vector3& inCenter, float inRadius);
+
+// Axis-aligned box around inBounds after transforming it by inMatrix.
+Bounds TransformBounds(const Bounds& inBounds, const Math::Matrix44& inMatrix);
+
+// Instance counters of one cull.
+struct SceneStats
+{
+    uint64_t instancesVisible{0};
+    uint64_t instancesCulled{0};
+    // BVH nodes tested against the frustum.
+    uint64_t nodesTested{0};
+
+    SceneStats& operator+=(const SceneStats& inOther)
+    {
+        instancesVisible += inOther.instancesVisible;
+        instancesCulled += inOther.instancesCulled;
+        nodesTested += inOther.nodesTested;
+        return *this;
+    }
+};
+
+// Meshlet counters of one frame.
+struct MeshletStats
+{
+    uint64_t meshletsVisible{0};
+    uint64_t frustumCulled{0};
+    // Normal cone facing away from the eye.
+    uint64_t backFaceCulled{0};
+
+    MeshletStats& operator+=(const MeshletStats& inOther)
+    {
+        meshletsVisible += inOther.meshletsVisible;
+        frustumCulled += inOther.frustumCulled;
+        backFaceCulled += inOther.backFaceCulled;
+        return *this;
+    }
+};
+
+// Append the indices of inClusters' meshlets that may be visible when drawn with inModel:
+// bounding sphere against the frustum, then (with bInConeCull) normal cone against the world
+// space eye. Cones assume the model matrix has no shear or non-uniform scale.
+void CullMeshlets(const MeshletBuffers& inClusters, const Math::Matrix44& inModel, const Frustum& inFrustum,
+                  const Math::Vector3& inEye, bool bInConeCull, std::vector<uint32_t>& outVisible,
+                  MeshletStats& outStats);
+
+// Shared mesh assets plus instances, with a bounding-volume hierarchy over the instance
+// bounds. Moving instances only refits the hierarchy; adding or removing them rebuilds it.
+class Scene
+{
+public:
+    // Leaves hold at most this many instances.
+    static constexpr uint32_t MaxLeafInstances = 4;
+
+    // Meshes without meshlets (e.g. procedural ones) get them built here.
+    MeshHandle AddMesh(Mesh inMesh);
+    uint32_t AddInstance(MeshHandle inMesh, const Math::Matrix44& inModel, uint32_t inBaseColor = 0xFFCCCCCC,
+                         const Texture* inTexture = nullptr);
+    void SetTransform(uint32_t inInstance, const Math::Matrix44& inModel);
+    void Clear();
+
+    const Mesh& GetMesh(MeshHandle inMesh) const { return meshes[inMesh]; }
+    const Instance& GetInstance(uint32_t inInstance) const { return instances[inInstance]; }
+    size_t GetMeshCount() const { return meshes.size(); }
+    size_t GetInstanceCount() const { return instances.size(); }
+    // Box around every instance; empty scenes give a zero box.
+    Bounds GetBounds() const;
+    // Changes whenever an instance is added, moved or removed, for caches of the whole scene.
+    uint64_t GetRevision() const { return revision; }
+
+    // Rebuild or refit the hierarchy if instances changed since the last call.
+    void UpdateBvh();
+
+    // Append the indices of instances that may be inside the frustum, sorted by mesh so
+    // draws of the same mesh are adjacent. Calls UpdateBvh first.
+    void Cull(const Frustum& inFrustum, std::vector<uint32_t>& outVisible, SceneStats& outStats);
+
+private:
+    struct BvhNode
+    {
+        Bounds bounds;
+        // Instances [first, first + instanceCount) of bvhInstances; every subtree owns a
+        // contiguous range.
+        uint32_t first{0};
+        uint32_t instanceCount{0};
+        // Children at child and child + 1; 0 for leaves (the root is never a child).
+        uint32_t child{0};
+    };
+
+    void BuildBvh();
+    void BuildNode(uint32_t inNode, uint32_t inBegin, uint32_t inEnd);
+    void RefitBvh();
+
+private:
+    std::vector<Mesh> meshes;
+    std::vector<Instance> instances;
+
+    std::vector<BvhNode> nodes;
+    // Instance indices in leaf order.
+    std::vector<uint32_t> bvhInstances;
+    bool bBvhNeedsBuild{false};
+    bool bBvhNeedsRefit{false};
+    uint64_t revision{0};
+};
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "Simd.h"
+#include "Texture.h"
+#include "Vector.h"
+
+// Shader policies. A vertex shader declares how many varyings it writes, a fragment shader
+// how many it reads; the vertex stage and the rasterizer are instantiated per shader, so
+// every combination compiles to its own loop with no runtime branches on the shading mode.
+
+class ShadowMap;
+
+// Upper bound on the varyings a vertex shader can declare.
+constexpr int MaxVaryings = 8;
+
+// Scene light shared by the shaders.
+struct Lighting
+{
+    // Unit vector pointing towards the light.
+    Math::Vector3 toLight{};
+    float ambient{0.15f};
+    // Shadows of the light when set; looked up per pixel by the rasterizer.
+    const ShadowMap* shadowMap{nullptr};
+};
+
+inline Lighting DefaultLighting()
+{
+    Math::Vector3 lightDir{0.5f, 1.0f, -1.0f}; // 定义光源方向
+    lightDir.Normalize();
+    return {{-lightDir.x, -lightDir.y, -lightDir.z}, 0.15f};
+}
+
+// Per-draw constants.
+struct ShaderUniforms
+{
+    Math::Matrix44 model;
+    Math::Matrix44 mvp;
+    Lighting lighting;
+};
+
+// Lighting broadcast to every lane.
+struct SimdLighting
+{
+    Simd::Float toLight[3];
+    Simd::Float ambient;
+    // Fraction of the light reaching the lanes being shaded; the rasterizer sets it per span
+    // from shadowMap.
+    Simd::Float visibility;
+    const ShadowMap *shadowMap;
+
+    explicit SimdLighting(const Lighting &inLighting)
+        : toLight{Simd::Float::Broadcast(inLighting.toLight.x), Simd::Float::Broadcast(inLighting.toLight.y),
+                  Simd::Float::Broadcast(inLighting.toLight.z)},
+          ambient(Simd::Float::Broadcast(inLighting.ambient)), visibility(Simd::Float::Broadcast(1.0f)),
+          shadowMap(inLighting.shadowMap)
+    {
+    }
+};
+
+// Uniforms broadcast once per vertex batch.
+struct SimdUniforms
+{
+    Simd::Float mvp[16];
+    // Upper-left 3x3 of the model matrix, column-major.
+    Simd::Float normal[9];
+    SimdLighting lighting;
+
+    explicit SimdUniforms(const ShaderUniforms &inUniforms) : lighting(inUniforms.lighting)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            mvp[i] = Simd::Float::Broadcast(inUniforms.mvp.data[i]);
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                normal[c * 3 + r] = Simd::Float::Broadcast(inUniforms.model.data[c * 4 + r]);
+            }
+        }
+    }
+};
+
+// Vertex attributes of Simd::Width vertices.
+struct VertexLanes
+{
+    Simd::Float px, py, pz;
+    Simd::Float nx, ny, nz;
+    Simd::Float u, v;
+};
+
+struct ColorLanes
+{
+    Simd::Float r, g, b;
+};
+
+template<int Count>
+using Varyings = std::array<Simd::Float, Count>;
+
+// Screen-space derivatives of the texcoords (varyings 0 and 1) of textured shaders.
+struct TexcoordDerivatives
+{
+    Simd::Float dudx, dvdx, dudy, dvdy;
+};
+
+namespace ShaderMath
+{
+    // Column-major: clip = M * vec4(p, 1)
+    inline void TransformPosition(const VertexLanes &in, const SimdUniforms &u, Simd::Float (&clip)[4])
+    {
+        const Simd::Float *m = u.mvp;
+        clip[0] = in.px * m[0] + in.py * m[4] + in.pz * m[8] + m[12];
+        clip[1] = in.px * m[1] + in.py * m[5] + in.pz * m[9] + m[13];
+        clip[2] = in.px * m[2] + in.py * m[6] + in.pz * m[10] + m[14];
+        clip[3] = in.px * m[3] + in.py * m[7] + in.pz * m[11] + m[15];
+    }
+
+    // 法线变换到世界空间: 只取 Model 矩阵左上角 3x3 部分进行方向变换. Zero normals stay zero.
+    inline void TransformNormal(const VertexLanes &in, const SimdUniforms &u,
+                                Simd::Float &outX, Simd::Float &outY, Simd::Float &outZ)
+    {
+        const Simd::Float *n = u.normal;
+        const Simd::Float wx = in.nx * n[0] + in.ny * n[3] + in.nz * n[6];
+        const Simd::Float wy = in.nx * n[1] + in.ny * n[4] + in.nz * n[7];
+        const Simd::Float wz = in.nx * n[2] + in.ny * n[5] + in.nz * n[8];
+        const Simd::Float len = Simd::Sqrt(wx * wx + wy * wy + wz * wz);
+        const Simd::Mask valid = len > Simd::Float::Broadcast(0.0f);
+        outX = Simd::Select(valid, wx / len, wx);
+        outY = Simd::Select(valid, wy / len, wy);
+        outZ = Simd::Select(valid, wz / len, wz);
+    }
+
+    // Ambient + Lambert, the latter scaled by the light visibility, for an unnormalized normal.
+    inline Simd::Float Brightness(const Simd::Float &nx, const Simd::Float &ny, const Simd::Float &nz,
+                                  const SimdLighting &lighting)
+    {
+        const Simd::Float zero = Simd::Float::Broadcast(0.0f);
+        const Simd::Float len = Simd::Sqrt(nx * nx + ny * ny + nz * nz);
+
+        // 计算 Lambert 漫反射强度: I = max(0, N dot L)，零长度法线不受光
+        const Simd::Float nDotL = (nx * lighting.toLight[0] + ny * lighting.toLight[1] + nz * lighting.toLight[2]) / len;
+        const Simd::Float intensity = Simd::Select(len > zero, Simd::Max(zero, nDotL), zero) * lighting.visibility;
+
+        // 最终亮度 = 环境光 + 漫反射光
+        return Simd::Min(Simd::Float::Broadcast(1.0f), lighting.ambient + intensity);
+    }
+
+    // 应用光照到颜色 (简单处理 RGB 通道)
+    inline Simd::Int PackColor(const ColorLanes &base, const Simd::Float &brightness)
+    {
+        const Simd::Int r = Simd::Int::Truncate(base.r * brightness);
+        const Simd::Int g = Simd::Int::Truncate(base.g * brightness);
+        const Simd::Int b = Simd::Int::Truncate(base.b * brightness);
+        return Simd::Int::Broadcast(0xFF000000) | b.ShiftLeft<16>() | g.ShiftLeft<8>() | r;
+    }
+}
+
+// ---- Vertex shaders ----
+
+// Clip position only.
+struct PositionVS
+{
+    static constexpr int VaryingCount = 0;
+
+    static void Run(const VertexLanes &in, const SimdUniforms &u, Simd::Float (&clip)[4], Varyings<VaryingCount> &)
+    {
+        ShaderMath::TransformPosition(in, u, clip);
+    }
+};
+
+// Clip position + world-space normal.
+struct StandardVS
+{
+    static constexpr int VaryingCount = 3;
+
+    static void Run(const VertexLanes &in, const SimdUniforms &u, Simd::Float (&clip)[4], Varyings<VaryingCount> &out)
+    {
+        ShaderMath::TransformPosition(in, u, clip);
+        ShaderMath::TransformNormal(in, u, out[0], out[1], out[2]);
+    }
+};
+
+// Lighting evaluated per vertex; only the brightness is interpolated.
+struct GouraudVS
+{
+    static constexpr int VaryingCount = 1;
+
+    static void Run(const VertexLanes &in, const SimdUniforms &u, Simd::Float (&clip)[4], Varyings<VaryingCount> &out)
+    {
+        ShaderMath::TransformPosition(in, u, clip);
+        Simd::Float nx, ny, nz;
+        ShaderMath::TransformNormal(in, u, nx, ny, nz);
+        out[0] = ShaderMath::Brightness(nx, ny, nz, u.lighting);
+    }
+};
+
+// Clip position + texcoords + world-space normal.
+struct TexturedVS
+{
+    static constexpr int VaryingCount = 5;
+
+    static void Run(const VertexLanes &in, const SimdUniforms &u, Simd::Float (&clip)[4], Varyings<VaryingCount> &out)
+    {
+        ShaderMath::TransformPosition(in, u, clip);
+        out[0] = in.u;
+        out[1] = in.v;
+        ShaderMath::TransformNormal(in, u, out[2], out[3], out[4]);
+    }
+};
+
+// ---- Fragment shaders ----
+// bWritesColor: false leaves the color plane untouched.
+// bFlat: varyings come from the first vertex and the color is computed once per triangle.
+// bUsesShadow: Shade reads lighting.visibility, so the rasterizer looks up the shadow map per
+// pixel. Gouraud lighting is finished in the vertex shader and ignores it.
+// bTextured: varyings are interpolated perspective-correct, and Shade also gets the texcoord
+// derivatives, the triangle's texture and the lanes the triangle covers.
+
+struct DepthOnlyFS
+{
+    static constexpr int VaryingCount = 0;
+    static constexpr bool bWritesColor = false;
+    static constexpr bool bFlat = false;
+    static constexpr bool bUsesShadow = false;
+    static constexpr bool bTextured = false;
+
+    static Simd::Int Shade(const Varyings<VaryingCount> &, const ColorLanes &, const SimdLighting &)
+    {
+        return Simd::Int::Broadcast(0);
+    }
+};
+
+// One normal per triangle.
+struct FlatFS
+{
+    static constexpr int VaryingCount = 3;
+    static constexpr bool bWritesColor = true;
+    static constexpr bool bFlat = true;
+    static constexpr bool bUsesShadow = true;
+    static constexpr bool bTextured = false;
+
+    static Simd::Int Shade(const Varyings<VaryingCount> &in, const ColorLanes &base, const SimdLighting &lighting)
+    {
+        return ShaderMath::PackColor(base, ShaderMath::Brightness(in[0], in[1], in[2], lighting));
+    }
+};
+
+struct GouraudFS
+{
+    static constexpr int VaryingCount = 1;
+    static constexpr bool bWritesColor = true;
+    static constexpr bool bFlat = false;
+    static constexpr bool bUsesShadow = false;
+    static constexpr bool bTextured = false;
+
+    static Simd::Int Shade(const Varyings<VaryingCount> &in, const ColorLanes &base, const SimdLighting &)
+    {
+        return ShaderMath::PackColor(base, in[0]);
+    }
+};
+
+// Interpolated normal, lit per pixel.
+struct PhongFS
+{
+    static constexpr int VaryingCount = 3;
+    static constexpr bool bWritesColor = true;
+    static constexpr bool bFlat = false;
+    static constexpr bool bUsesShadow = true;
+    static constexpr bool bTextured = false;
+
+    static Simd::Int Shade(const Varyings<VaryingCount> &in, const ColorLanes &base, const SimdLighting &lighting)
+    {
+        return ShaderMath::PackColor(base, ShaderMath::Brightness(in[0], in[1], in[2], lighting));
+    }
+};
+
+// Phong modulated by a texture; untextured triangles shade like PhongFS.
+struct TexturedFS
+{
+    static constexpr int VaryingCount = 5;
+    static constexpr bool bWritesColor = true;
+    static constexpr bool bFlat = false;
+    static constexpr bool bUsesShadow = true;
+    static constexpr bool bTextured = true;
+
+    static Simd::Int Shade(const Varyings<VaryingCount> &in, const TexcoordDerivatives &derivatives,
+                           const Texture *texture, const Simd::Mask &coverage, const ColorLanes &base,
+                           const SimdLighting &lighting)
+    {
+        const Simd::Float brightness = ShaderMath::Brightness(in[2], in[3], in[4], lighting);
+        if (!texture) return ShaderMath::PackColor(base, brightness);
+
+        Simd::Float texel[3];
+        texture->Sample(in[0], in[1], derivatives.dudx, derivatives.dvdx, derivatives.dudy, derivatives.dvdy, coverage,
+                        texel);
+        const Simd::Float scale = Simd::Float::Broadcast(1.0f / 255.0f);
+        return ShaderMath::PackColor({base.r * texel[0] * scale, base.g * texel[1] * scale, base.b * texel[2] * scale},
+                                     brightness);
+    }
+};
+
+// ---- Programs ----
+
+template<typename InVS, typename InFS>
+struct ShaderProgram
+{
+    using VS = InVS;
+    using FS = InFS;
+    static_assert(VS::VaryingCount == FS::VaryingCount, "Vertex and fragment shader varyings differ.");
+    static_assert(VS::VaryingCount <= MaxVaryings, "Too many varyings.");
+};
+
+using DepthOnlyProgram = ShaderProgram<PositionVS, DepthOnlyFS>;
+using FlatProgram = ShaderProgram<StandardVS, FlatFS>;
+using GouraudProgram = ShaderProgram<GouraudVS, GouraudFS>;
+using PhongProgram = ShaderProgram<StandardVS, PhongFS>;
+using TexturedProgram = ShaderProgram<TexturedVS, TexturedFS>;
+
+enum class ShadingModel : uint8_t
+{
+    DepthOnly,
+    Flat,
+    Gouraud,
+    Phong,
+    Textured
+};
+
+inline const char* GetShadingModelName(const ShadingModel inModel)
+{
+    switch (inModel)
+    {
+    case ShadingModel::DepthOnly: return "depth";
+    case ShadingModel::Flat: return "flat";
+    case ShadingModel::Gouraud: return "gouraud";
+    case ShadingModel::Phong: return "phong";
+    case ShadingModel::Textured: return "textured";
+    }
+    return "unknown";
+}
+
+// Runtime choice -> compile-time program: calls func(Program{}).
+template<typename Func>
+decltype(auto) DispatchShadingModel(const ShadingModel inModel, Func &&func)
+{
+    switch (inModel)
+    {
+    case ShadingModel::DepthOnly: return func(DepthOnlyProgram{});
+    case ShadingModel::Flat: return func(FlatProgram{});
+    case ShadingModel::Gouraud: return func(GouraudProgram{});
+    case ShadingModel::Textured: return func(TexturedProgram{});
+    case ShadingModel::Phong: break;
+    }
+    return func(PhongProgram{});
+}
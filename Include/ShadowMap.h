@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Rasterizer.h"
+#include "Simd.h"
+#include "Vector.h"
+
+// How often the shadow map is redrawn.
+enum class ShadowUpdate : uint8_t
+{
+    EveryFrame,
+    // Only when the light's view-projection or the scene changed since the last pass.
+    OnChange
+};
+
+inline const char* GetShadowUpdateName(const ShadowUpdate inUpdate)
+{
+    return inUpdate == ShadowUpdate::OnChange ? "change" : "frame";
+}
+
+// Depth of the scene seen from the directional light, drawn by a depth-only pass
+// (RasterizeDepthOnly) with the light's view-projection. The main pass looks it up per pixel:
+// screen position and depth map straight to shadow-map texels through one matrix (SetViewer),
+// so no shader needs extra varyings.
+class ShadowMap
+{
+public:
+    static constexpr uint32_t DefaultSize = 2048;
+
+    // Square map of inSize texels; 0 frees it.
+    void Resize(uint32_t inSize);
+    uint32_t GetSize() const { return size; }
+
+    // Texels on each side of the center tap that PCF averages: 0 is a single tap, 1 a 3x3 kernel.
+    void SetPcfRadius(int inRadius) { pcfRadius = inRadius < 0 ? 0 : inRadius; }
+    int GetPcfRadius() const { return pcfRadius; }
+
+    // Light-space depth a receiver must be behind the map to count as shadowed.
+    void SetDepthBias(float inBias) { depthBias = inBias; }
+
+    void SetLightViewProjection(const Math::Matrix44& inViewProj) { lightViewProj = inViewProj; }
+    const Math::Matrix44& GetLightViewProjection() const { return lightViewProj; }
+
+    // View-projection and render size of the main pass the map is looked up from.
+    // bReverseZ: the main pass stores negated depth (RenderTarget::bReverseZ).
+    void SetViewer(const Math::Matrix44& inViewProj, uint32_t inWidth, uint32_t inHeight, bool bReverseZ);
+
+    // Whether the map has to be redrawn this frame, given the current scene revision.
+    bool NeedsUpdate(ShadowUpdate inUpdate, uint64_t inSceneRevision) const;
+    // Clear before the depth pass; records what the map is drawn from.
+    void BeginUpdate(uint64_t inSceneRevision);
+    // Depth passes drawn so far.
+    uint64_t GetUpdateCount() const { return updateCount; }
+
+    // Depth plane for the depth-only pass.
+    RenderTarget GetRenderTarget();
+
+    // Fraction of the light reaching the main-pass pixels at screen (x, y) with depth z: 1 is
+    // lit, 0 shadowed. Points outside the map are lit.
+    Simd::Float GetVisibility(const Simd::Float& inX, const Simd::Float& inY, const Simd::Float& inDepth) const;
+
+private:
+    std::vector<float> depth;
+    uint32_t size{0};
+    int pcfRadius{1};
+    float depthBias{0.002f};
+    Math::Matrix44 lightViewProj = Math::Matrix44::Identity();
+    // Main-pass (x, y, depth, 1) -> (texel x, texel y, light depth, w).
+    Math::Matrix44 screenToShadow = Math::Matrix44::Identity();
+
+    // What the current contents were drawn from, for ShadowUpdate::OnChange.
+    Math::Matrix44 drawnLightViewProj;
+    uint64_t drawnRevision{0};
+    bool bDrawn{false};
+    uint64_t updateCount{0};
+};
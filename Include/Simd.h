@@ -0,0 +1,311 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Thin wrappers over the widest float/int lanes enabled for the build.
+// RENDERER_SIMD_SCALAR forces the portable path so results can be compared.
+#if !defined(RENDERER_SIMD_SCALAR) && defined(__AVX2__)
+#define RENDERER_SIMD_AVX2 1
+#include <immintrin.h>
+#elif !defined(RENDERER_SIMD_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define RENDERER_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#ifndef RENDERER_SIMD_SCALAR
+#define RENDERER_SIMD_SCALAR 1
+#endif
+#endif
+
+namespace Simd
+{
+#if defined(RENDERER_SIMD_AVX2)
+
+    constexpr int Width = 8;
+
+    struct Mask
+    {
+        __m256 v;
+
+        Mask operator&(const Mask &o) const { return {_mm256_and_ps(v, o.v)}; }
+        Mask operator|(const Mask &o) const { return {_mm256_or_ps(v, o.v)}; }
+        int Bits() const { return _mm256_movemask_ps(v); }
+        bool Any() const { return Bits() != 0; }
+        bool All() const { return Bits() == 0xFF; }
+
+        // Lanes [0, count) set.
+        static Mask FirstN(int count)
+        {
+            const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            return {_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), lane))};
+        }
+    };
+
+    struct Float
+    {
+        __m256 v;
+
+        static Float Broadcast(float f) { return {_mm256_set1_ps(f)}; }
+        // {0, 1, 2, ...}
+        static Float Ramp() { return {_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)}; }
+        static Float Load(const float *p) { return {_mm256_loadu_ps(p)}; }
+        void Store(float *p) const { _mm256_storeu_ps(p, v); }
+
+        Float operator+(const Float &o) const { return {_mm256_add_ps(v, o.v)}; }
+        Float operator-(const Float &o) const { return {_mm256_sub_ps(v, o.v)}; }
+        Float operator*(const Float &o) const { return {_mm256_mul_ps(v, o.v)}; }
+        Float operator/(const Float &o) const { return {_mm256_div_ps(v, o.v)}; }
+        Float &operator+=(const Float &o) { v = _mm256_add_ps(v, o.v); return *this; }
+
+        Mask operator>=(const Float &o) const { return {_mm256_cmp_ps(v, o.v, _CMP_GE_OQ)}; }
+        Mask operator>(const Float &o) const { return {_mm256_cmp_ps(v, o.v, _CMP_GT_OQ)}; }
+        Mask operator<(const Float &o) const { return {_mm256_cmp_ps(v, o.v, _CMP_LT_OQ)}; }
+    };
+
+    struct Int
+    {
+        __m256i v;
+
+        static Int Broadcast(uint32_t i) { return {_mm256_set1_epi32(static_cast<int>(i))}; }
+        static Int Load(const uint32_t *p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))}; }
+        void Store(uint32_t *p) const { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+        // Truncating float -> int conversion.
+        static Int Truncate(const Float &f) { return {_mm256_cvttps_epi32(f.v)}; }
+        // Zero-extending load and narrowing store of 16-bit values; stored lanes must fit.
+        static Int Load16(const uint16_t *p) { return {_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))}; }
+        void Store16(uint16_t *p) const
+        {
+            // The pack works per 128-bit half; gather both halves' results into the low one.
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_castsi256_si128(packed));
+        }
+
+        Int operator|(const Int &o) const { return {_mm256_or_si256(v, o.v)}; }
+        Int operator&(const Int &o) const { return {_mm256_and_si256(v, o.v)}; }
+        Int operator+(const Int &o) const { return {_mm256_add_epi32(v, o.v)}; }
+        Mask operator==(const Int &o) const { return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, o.v))}; }
+        Mask operator!=(const Int &o) const
+        {
+            return {_mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(v, o.v), _mm256_set1_epi32(-1)))};
+        }
+        // Signed compare.
+        Mask operator<(const Int &o) const { return {_mm256_castsi256_ps(_mm256_cmpgt_epi32(o.v, v))}; }
+        template<int Shift>
+        Int ShiftLeft() const { return {_mm256_slli_epi32(v, Shift)}; }
+        template<int Shift>
+        Int ShiftRight() const { return {_mm256_srli_epi32(v, Shift)}; }
+    };
+
+    inline Float Min(const Float &a, const Float &b) { return {_mm256_min_ps(a.v, b.v)}; }
+    inline Float Max(const Float &a, const Float &b) { return {_mm256_max_ps(a.v, b.v)}; }
+    inline Float Sqrt(const Float &a) { return {_mm256_sqrt_ps(a.v)}; }
+    // Signed int -> float conversion.
+    inline Float ToFloat(const Int &a) { return {_mm256_cvtepi32_ps(a.v)}; }
+    // Lanes from a where mask is set, otherwise from b.
+    inline Float Select(const Mask &m, const Float &a, const Float &b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+    inline Int Select(const Mask &m, const Int &a, const Int &b)
+    {
+        return {_mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), m.v))};
+    }
+
+#elif defined(RENDERER_SIMD_SSE)
+
+    constexpr int Width = 4;
+
+    struct Mask
+    {
+        __m128 v;
+
+        Mask operator&(const Mask &o) const { return {_mm_and_ps(v, o.v)}; }
+        Mask operator|(const Mask &o) const { return {_mm_or_ps(v, o.v)}; }
+        int Bits() const { return _mm_movemask_ps(v); }
+        bool Any() const { return Bits() != 0; }
+        bool All() const { return Bits() == 0xF; }
+
+        // Lanes [0, count) set.
+        static Mask FirstN(int count)
+        {
+            const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+            return {_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(count), lane))};
+        }
+    };
+
+    struct Float
+    {
+        __m128 v;
+
+        static Float Broadcast(float f) { return {_mm_set1_ps(f)}; }
+        // {0, 1, 2, ...}
+        static Float Ramp() { return {_mm_setr_ps(0, 1, 2, 3)}; }
+        static Float Load(const float *p) { return {_mm_loadu_ps(p)}; }
+        void Store(float *p) const { _mm_storeu_ps(p, v); }
+
+        Float operator+(const Float &o) const { return {_mm_add_ps(v, o.v)}; }
+        Float operator-(const Float &o) const { return {_mm_sub_ps(v, o.v)}; }
+        Float operator*(const Float &o) const { return {_mm_mul_ps(v, o.v)}; }
+        Float operator/(const Float &o) const { return {_mm_div_ps(v, o.v)}; }
+        Float &operator+=(const Float &o) { v = _mm_add_ps(v, o.v); return *this; }
+
+        Mask operator>=(const Float &o) const { return {_mm_cmpge_ps(v, o.v)}; }
+        Mask operator>(const Float &o) const { return {_mm_cmpgt_ps(v, o.v)}; }
+        Mask operator<(const Float &o) const { return {_mm_cmplt_ps(v, o.v)}; }
+    };
+
+    struct Int
+    {
+        __m128i v;
+
+        static Int Broadcast(uint32_t i) { return {_mm_set1_epi32(static_cast<int>(i))}; }
+        static Int Load(const uint32_t *p) { return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))}; }
+        void Store(uint32_t *p) const { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+        // Truncating float -> int conversion.
+        static Int Truncate(const Float &f) { return {_mm_cvttps_epi32(f.v)}; }
+        // Zero-extending load and narrowing store of 16-bit values; stored lanes must fit.
+        static Int Load16(const uint16_t *p)
+        {
+            return {_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128())};
+        }
+        void Store16(uint16_t *p) const
+        {
+            // SSE2 only packs with signed saturation: shift into the int16 range and back.
+            const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(v, _mm_set1_epi32(0x8000)), _mm_setzero_si128());
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_add_epi16(packed, _mm_set1_epi16(-0x8000)));
+        }
+
+        Int operator|(const Int &o) const { return {_mm_or_si128(v, o.v)}; }
+        Int operator&(const Int &o) const { return {_mm_and_si128(v, o.v)}; }
+        Int operator+(const Int &o) const { return {_mm_add_epi32(v, o.v)}; }
+        Mask operator==(const Int &o) const { return {_mm_castsi128_ps(_mm_cmpeq_epi32(v, o.v))}; }
+        Mask operator!=(const Int &o) const
+        {
+            return {_mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(v, o.v), _mm_set1_epi32(-1)))};
+        }
+        // Signed compare.
+        Mask operator<(const Int &o) const { return {_mm_castsi128_ps(_mm_cmplt_epi32(v, o.v))}; }
+        template<int Shift>
+        Int ShiftLeft() const { return {_mm_slli_epi32(v, Shift)}; }
+        template<int Shift>
+        Int ShiftRight() const { return {_mm_srli_epi32(v, Shift)}; }
+    };
+
+    inline Float Min(const Float &a, const Float &b) { return {_mm_min_ps(a.v, b.v)}; }
+    inline Float Max(const Float &a, const Float &b) { return {_mm_max_ps(a.v, b.v)}; }
+    inline Float Sqrt(const Float &a) { return {_mm_sqrt_ps(a.v)}; }
+    // Signed int -> float conversion.
+    inline Float ToFloat(const Int &a) { return {_mm_cvtepi32_ps(a.v)}; }
+    // Lanes from a where mask is set, otherwise from b (SSE2 has no blendv).
+    inline Float Select(const Mask &m, const Float &a, const Float &b)
+    {
+        return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))};
+    }
+    inline Int Select(const Mask &m, const Int &a, const Int &b)
+    {
+        const __m128i mi = _mm_castps_si128(m.v);
+        return {_mm_or_si128(_mm_and_si128(mi, a.v), _mm_andnot_si128(mi, b.v))};
+    }
+
+#else
+
+    constexpr int Width = 4;
+
+    struct Mask
+    {
+        bool v[Width];
+
+        Mask operator&(const Mask &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] && o.v[i]; return r; }
+        Mask operator|(const Mask &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] || o.v[i]; return r; }
+        int Bits() const { int b = 0; for (int i = 0; i < Width; ++i) b |= v[i] ? 1 << i : 0; return b; }
+        bool Any() const { return Bits() != 0; }
+        bool All() const { return Bits() == (1 << Width) - 1; }
+
+        // Lanes [0, count) set.
+        static Mask FirstN(int count) { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = i < count; return r; }
+    };
+
+    struct Float
+    {
+        float v[Width];
+
+        static Float Broadcast(float f) { Float r; for (float &x : r.v) x = f; return r; }
+        // {0, 1, 2, ...}
+        static Float Ramp() { Float r; for (int i = 0; i < Width; ++i) r.v[i] = static_cast<float>(i); return r; }
+        static Float Load(const float *p) { Float r; for (int i = 0; i < Width; ++i) r.v[i] = p[i]; return r; }
+        void Store(float *p) const { for (int i = 0; i < Width; ++i) p[i] = v[i]; }
+
+        Float operator+(const Float &o) const { Float r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] + o.v[i]; return r; }
+        Float operator-(const Float &o) const { Float r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] - o.v[i]; return r; }
+        Float operator*(const Float &o) const { Float r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] * o.v[i]; return r; }
+        Float operator/(const Float &o) const { Float r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] / o.v[i]; return r; }
+        Float &operator+=(const Float &o) { for (int i = 0; i < Width; ++i) v[i] += o.v[i]; return *this; }
+
+        Mask operator>=(const Float &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] >= o.v[i]; return r; }
+        Mask operator>(const Float &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] > o.v[i]; return r; }
+        Mask operator<(const Float &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] < o.v[i]; return r; }
+    };
+
+    struct Int
+    {
+        uint32_t v[Width];
+
+        static Int Broadcast(uint32_t i) { Int r; for (uint32_t &x : r.v) x = i; return r; }
+        static Int Load(const uint32_t *p) { Int r; for (int i = 0; i < Width; ++i) r.v[i] = p[i]; return r; }
+        void Store(uint32_t *p) const { for (int i = 0; i < Width; ++i) p[i] = v[i]; }
+        // Truncating float -> int conversion.
+        static Int Truncate(const Float &f)
+        {
+            Int r;
+            for (int i = 0; i < Width; ++i) r.v[i] = static_cast<uint32_t>(static_cast<int32_t>(f.v[i]));
+            return r;
+        }
+        // Zero-extending load and narrowing store of 16-bit values; stored lanes must fit.
+        static Int Load16(const uint16_t *p) { Int r; for (int i = 0; i < Width; ++i) r.v[i] = p[i]; return r; }
+        void Store16(uint16_t *p) const { for (int i = 0; i < Width; ++i) p[i] = static_cast<uint16_t>(v[i]); }
+
+        Int operator|(const Int &o) const { Int r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] | o.v[i]; return r; }
+        Int operator&(const Int &o) const { Int r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] & o.v[i]; return r; }
+        Int operator+(const Int &o) const { Int r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] + o.v[i]; return r; }
+        Mask operator==(const Int &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] == o.v[i]; return r; }
+        Mask operator!=(const Int &o) const { Mask r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] != o.v[i]; return r; }
+        // Signed compare.
+        Mask operator<(const Int &o) const
+        {
+            Mask r;
+            for (int i = 0; i < Width; ++i) r.v[i] = static_cast<int32_t>(v[i]) < static_cast<int32_t>(o.v[i]);
+            return r;
+        }
+        template<int Shift>
+        Int ShiftLeft() const { Int r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] << Shift; return r; }
+        template<int Shift>
+        Int ShiftRight() const { Int r; for (int i = 0; i < Width; ++i) r.v[i] = v[i] >> Shift; return r; }
+    };
+
+    inline Float Min(const Float &a, const Float &b) { Float r; for (int i = 0; i < Width; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+    inline Float Max(const Float &a, const Float &b) { Float r; for (int i = 0; i < Width; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+    inline Float Sqrt(const Float &a) { Float r; for (int i = 0; i < Width; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+    // Signed int -> float conversion.
+    inline Float ToFloat(const Int &a) { Float r; for (int i = 0; i < Width; ++i) r.v[i] = static_cast<float>(static_cast<int32_t>(a.v[i])); return r; }
+    // Lanes from a where mask is set, otherwise from b.
+    inline Float Select(const Mask &m, const Float &a, const Float &b) { Float r; for (int i = 0; i < Width; ++i) r.v[i] = m.v[i] ? a.v[i] : b.v[i]; return r; }
+    inline Int Select(const Mask &m, const Int &a, const Int &b) { Int r; for (int i = 0; i < Width; ++i) r.v[i] = m.v[i] ? a.v[i] : b.v[i]; return r; }
+
+#endif
+
+    // Horizontal reductions, used off the per-pixel path.
+    inline float ReduceMin(const Float &a)
+    {
+        alignas(32) float lanes[Width];
+        a.Store(lanes);
+        float result = lanes[0];
+        for (int i = 1; i < Width; ++i) result = lanes[i] < result ? lanes[i] : result;
+        return result;
+    }
+
+    inline float ReduceMax(const Float &a)
+    {
+        alignas(32) float lanes[Width];
+        a.Store(lanes);
+        float result = lanes[0];
+        for (int i = 1; i < Width; ++i) result = lanes[i] > result ? lanes[i] : result;
+        return result;
+    }
+}
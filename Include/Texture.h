@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Simd.h"
+
+enum class TextureFilter : uint8_t
+{
+    // Bilinear within the nearest mip level.
+    Bilinear,
+    // Bilinear in the two nearest levels, blended.
+    Trilinear
+};
+
+// RGBA8 texture with a box-filtered mip chain. Each level is stored in TileSize x TileSize
+// texel tiles (one cache line), tiles row by row and the texels of a tile in Morton order, so
+// the 2x2 footprint of a bilinear tap mostly falls into one line. Coordinates wrap.
+class Texture
+{
+public:
+    static constexpr uint32_t TileSize = 4;
+
+    Texture() = default;
+    // inPixels: row-major, inWidth * inHeight texels.
+    Texture(const uint32_t* inPixels, uint32_t inWidth, uint32_t inHeight);
+
+    // Checkerboard of inCells x inCells squares over an inSize x inSize image.
+    static Texture CreateChecker(uint32_t inSize, uint32_t inCells, uint32_t inColorA, uint32_t inColorB);
+
+    bool IsValid() const { return !levels.empty(); }
+    uint32_t GetWidth() const { return levels.empty() ? 0 : levels[0].width; }
+    uint32_t GetHeight() const { return levels.empty() ? 0 : levels[0].height; }
+    uint32_t GetLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+
+    void SetFilter(TextureFilter inFilter) { filter = inFilter; }
+    TextureFilter GetFilter() const { return filter; }
+
+    uint32_t GetTexel(uint32_t inLevel, uint32_t inX, uint32_t inY) const;
+
+    // Filtered color of Simd::Width lanes, channels in [0, 255]. The mip level comes from the
+    // screen-space derivatives of the texcoords of the lanes in inCoverage; the other lanes get
+    // texel (0, 0). An invalid texture is white.
+    void Sample(const Simd::Float& inU, const Simd::Float& inV, const Simd::Float& inDuDx, const Simd::Float& inDvDx,
+                const Simd::Float& inDuDy, const Simd::Float& inDvDy, const Simd::Mask& inCoverage,
+                Simd::Float (&outColor)[3]) const;
+
+private:
+    struct Level
+    {
+        uint32_t width{0};
+        uint32_t height{0};
+        uint32_t tilesX{0};
+        // First texel of the level in texels.
+        size_t offset{0};
+    };
+
+    size_t GetTexelIndex(const Level& inLevel, uint32_t inX, uint32_t inY) const;
+    // Bilinear footprint of every lane in one level: the four texels (00, 10, 01, 11) and the
+    // blend weights. inU, inV: already wrapped to [0, 1].
+    void FetchTaps(const Level& inLevel, const Simd::Float& inU, const Simd::Float& inV,
+                   uint32_t (&outTaps)[4][Simd::Width], Simd::Float& outFx, Simd::Float& outFy) const;
+
+private:
+    std::vector<Level> levels;
+    std::vector<uint32_t> texels;
+    TextureFilter filter{TextureFilter::Trilinear};
+};
@@ -1,31 +1,66 @@
 ﻿#pragma once
 
 #include <cmath>
+#include <cstddef>
 
 #include <array>
 
+#include "Simd.h"
+
 
 using namespace std;
 
+// Vector4 and Matrix44 are 16-byte aligned, so a vector or a matrix column is one SSE load.
+// Their products use SSE (two columns per register with AVX2); a RENDERER_SIMD_SCALAR build
+// (Simd.h) runs plain loops instead, adding the terms in the same order, so the paths can be
+// compared bit for bit as long as multiplies and adds are not fused (the AVX2 build passes
+// -ffp-contract=off). Construction is constexpr; products evaluated at compile time take the
+// loops.
 namespace Math
 {
+    // 1 / sqrt(inValue) from the hardware estimate and one Newton-Raphson step: about 22 bits
+    // of precision, no divide. The scalar build computes it exactly.
+    inline float ReciprocalSqrtFast(const float inValue)
+    {
+#if defined(RENDERER_SIMD_SCALAR)
+        return 1.0f / std::sqrt(inValue);
+#else
+        const __m128 value = _mm_set_ss(inValue);
+        const __m128 estimate = _mm_rsqrt_ss(value);
+        // y * (1.5 - 0.5 * x * y * y)
+        const __m128 halfValue = _mm_mul_ss(value, _mm_set_ss(0.5f));
+        const __m128 correction = _mm_sub_ss(_mm_set_ss(1.5f), _mm_mul_ss(halfValue, _mm_mul_ss(estimate, estimate)));
+        return _mm_cvtss_f32(_mm_mul_ss(estimate, correction));
+#endif
+    }
+
+    struct Vector2
+    {
+        float x{0.0f}, y{0.0f};
+
+        constexpr Vector2()=default;
+        constexpr Vector2(float inX, float inY) : x(inX), y(inY)
+        {
+        }
+    };
+
     struct Vector3
     {
         float x{0.0f}, y{0.0f}, z{0.0f};
 
-        Vector3()=default;
-        Vector3(float inX, float inY, float inZ) : x(inX), y(inY), z(inZ)
+        constexpr Vector3()=default;
+        constexpr Vector3(float inX, float inY, float inZ) : x(inX), y(inY), z(inZ)
         {
         }
 
         // Dot product.
-        static float Dot(const Vector3 &inA, const Vector3 &inB)
+        static constexpr float Dot(const Vector3 &inA, const Vector3 &inB)
         {
             return inA.x * inB.x + inA.y * inB.y + inA.z * inB.z;
         }
 
         // Cross product.
-        static Vector3 Cross(const Vector3 &inA, const Vector3 &inB)
+        static constexpr Vector3 Cross(const Vector3 &inA, const Vector3 &inB)
         {
             return {
                 inA.y * inB.z - inA.z * inB.y,
@@ -34,9 +69,9 @@ namespace Math
             };
         }
 
-        Vector3 operator-(const Vector3 &inV) const { return {x - inV.x, y - inV.y, z - inV.z}; }
-        Vector3 operator+(const Vector3 &inV) const { return {x + inV.x, y + inV.y, z + inV.z}; }
-        Vector3 operator*(float inF) const { return {x * inF, y * inF, z * inF}; }
+        constexpr Vector3 operator-(const Vector3 &inV) const { return {x - inV.x, y - inV.y, z - inV.z}; }
+        constexpr Vector3 operator+(const Vector3 &inV) const { return {x + inV.x, y + inV.y, z + inV.z}; }
+        constexpr Vector3 operator*(float inF) const { return {x * inF, y * inF, z * inF}; }
 
         float Length() const { return std::sqrt(x * x + y * y + z * z); }
 
@@ -50,21 +85,86 @@ namespace Math
                 z /= len;
             }
         }
+
+        // Normalize with ReciprocalSqrtFast: a multiply instead of a sqrt and three divides, for
+        // directions that tolerate a relative error around 1e-6.
+        void NormalizeFast()
+        {
+            const float lengthSq = x * x + y * y + z * z;
+            if (lengthSq > 0)
+            {
+                const float invLength = ReciprocalSqrtFast(lengthSq);
+                x *= invLength;
+                y *= invLength;
+                z *= invLength;
+            }
+        }
     };
 
-    struct Vector4
+    struct alignas(16) Vector4
     {
-        float x, y, z, w;
+        float x{0.0f}, y{0.0f}, z{0.0f}, w{0.0f};
     };
+    static_assert(sizeof(Vector4) == 16, "Vector4 is loaded as one 4-float register.");
+
+    namespace Detail
+    {
+        // out[i] = m * in[i] for inCount column vectors of 4 floats, m column-major; in and out
+        // may be the same array. Each component sums m column 0 * x, + column 1 * y, and so on.
+        inline void TransformColumns(const float *m, const float *in, float *out, const size_t inCount)
+        {
+#if defined(RENDERER_SIMD_SCALAR)
+            for (size_t i = 0; i < inCount; ++i, in += 4, out += 4)
+            {
+                const float x = in[0], y = in[1], z = in[2], w = in[3];
+                for (int r = 0; r < 4; ++r)
+                {
+                    out[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r] * w;
+                }
+            }
+#else
+            size_t i = 0;
+#if defined(RENDERER_SIMD_AVX2)
+            // Two vectors per register: shuffles broadcast a component within each 128-bit half.
+            const __m256 wide[4] = {_mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m)),
+                                    _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m + 4)),
+                                    _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m + 8)),
+                                    _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m + 12))};
+            for (; i + 2 <= inCount; i += 2)
+            {
+                const __m256 v = _mm256_loadu_ps(in + i * 4);
+                __m256 r = _mm256_mul_ps(wide[0], _mm256_shuffle_ps(v, v, 0x00));
+                r = _mm256_add_ps(r, _mm256_mul_ps(wide[1], _mm256_shuffle_ps(v, v, 0x55)));
+                r = _mm256_add_ps(r, _mm256_mul_ps(wide[2], _mm256_shuffle_ps(v, v, 0xAA)));
+                r = _mm256_add_ps(r, _mm256_mul_ps(wide[3], _mm256_shuffle_ps(v, v, 0xFF)));
+                _mm256_storeu_ps(out + i * 4, r);
+            }
+#endif
+            const __m128 column[4] = {_mm_loadu_ps(m), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12)};
+            for (; i < inCount; ++i)
+            {
+                const __m128 v = _mm_loadu_ps(in + i * 4);
+                __m128 r = _mm_mul_ps(column[0], _mm_shuffle_ps(v, v, 0x00));
+                r = _mm_add_ps(r, _mm_mul_ps(column[1], _mm_shuffle_ps(v, v, 0x55)));
+                r = _mm_add_ps(r, _mm_mul_ps(column[2], _mm_shuffle_ps(v, v, 0xAA)));
+                r = _mm_add_ps(r, _mm_mul_ps(column[3], _mm_shuffle_ps(v, v, 0xFF)));
+                _mm_storeu_ps(out + i * 4, r);
+            }
+#endif
+        }
+    }
 
-    struct Matrix44
+    struct alignas(16) Matrix44
     {
         // Column-major storage.
         std::array<float, 16> data{};
 
-        Matrix44() { data.fill(0.0f); }
+        constexpr Matrix44() = default;
+        constexpr explicit Matrix44(const std::array<float, 16> &inData) : data(inData)
+        {
+        }
 
-        static Matrix44 Identity()
+        static constexpr Matrix44 Identity()
         {
             Matrix44 mat;
             mat.data[0] = mat.data[5] = mat.data[10] = mat.data[15] = 1.0f;
@@ -86,16 +186,16 @@ namespace Math
             Vector3 yAxis = Vector3::Cross(zAxis, xAxis);
             yAxis.Normalize();
 
-            // View matrix with rotation + translation in the last column.
+            // View matrix: the axes are the rows of the rotation, translation in the last column.
             Matrix44 result = Identity();
             result.data[0] = xAxis.x;
-            result.data[1] = xAxis.y;
-            result.data[2] = xAxis.z;
-            result.data[4] = yAxis.x;
+            result.data[4] = xAxis.y;
+            result.data[8] = xAxis.z;
+            result.data[1] = yAxis.x;
             result.data[5] = yAxis.y;
-            result.data[6] = yAxis.z;
-            result.data[8] = zAxis.x;
-            result.data[9] = zAxis.y;
+            result.data[9] = yAxis.z;
+            result.data[2] = zAxis.x;
+            result.data[6] = zAxis.y;
             result.data[10] = zAxis.z;
 
             result.data[12] = -Vector3::Dot(xAxis, inEye);
@@ -129,22 +229,140 @@ namespace Math
             return result;
         }
 
+        // Reverse-Z variant of PerspectiveFovLH: the near plane maps to z = 1 and the far plane
+        // to 0. Float depth is densest near 0, which then covers the distance, where the
+        // hyperbolic z of the standard projection leaves the fewest distinct values.
+        static Matrix44 PerspectiveFovReverseLH(float fovRadians, float aspect, float zNear, float zFar)
+        {
+            Matrix44 result = PerspectiveFovLH(fovRadians, aspect, zNear, zFar);
+
+            // z' = w - z of the standard projection.
+            result.data[10] = -zNear / (zFar - zNear);
+            result.data[14] = zNear * zFar / (zFar - zNear);
+
+            return result;
+        }
+
+        // LH orthographic projection of the view-space box [l, r] x [b, t] x [zNear, zFar]
+        // (column-major). Z range [0, 1], w = 1.
+        static constexpr Matrix44 OrthographicOffCenterLH(float l, float r, float b, float t, float zNear, float zFar)
+        {
+            Matrix44 result = Identity();
+            result.data[0] = 2.0f / (r - l);
+            result.data[5] = 2.0f / (t - b);
+            result.data[10] = 1.0f / (zFar - zNear);
+            result.data[12] = -(r + l) / (r - l);
+            result.data[13] = -(t + b) / (t - b);
+            result.data[14] = -zNear / (zFar - zNear);
+            return result;
+        }
+
+        // General inverse by cofactors; identity for a singular matrix.
+        static constexpr Matrix44 Inverse(const Matrix44 &m)
+        {
+            const auto &a = m.data;
+            Matrix44 inv;
+            auto &o = inv.data;
+            o[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] +
+                   a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+            o[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] -
+                   a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+            o[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] +
+                   a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+            o[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] -
+                    a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+            o[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] -
+                   a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+            o[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] +
+                   a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+            o[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] -
+                   a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+            o[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] +
+                    a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+            o[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] +
+                   a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+            o[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] -
+                   a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+            o[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] +
+                    a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+            o[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] -
+                    a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+            o[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] -
+                   a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+            o[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] +
+                   a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+            o[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] -
+                    a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+            o[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] +
+                    a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+            const float det = a[0] * o[0] + a[1] * o[4] + a[2] * o[8] + a[3] * o[12];
+            if (det == 0.0f) return Identity();
+            const float invDet = 1.0f / det;
+            for (float &value : o) value *= invDet;
+            return inv;
+        }
+
         // Column-major matrix multiply (a * b).
-        static Matrix44 Multiply(const Matrix44 &a, const Matrix44 &b)
+        static constexpr Matrix44 Multiply(const Matrix44 &a, const Matrix44 &b)
         {
             Matrix44 res;
-            for (int r = 0; r < 4; ++r)
+            if consteval
             {
-                for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 4; ++r)
                 {
-                    res.data[c * 4 + r] =
-                            a.data[0 * 4 + r] * b.data[c * 4 + 0] +
-                            a.data[1 * 4 + r] * b.data[c * 4 + 1] +
-                            a.data[2 * 4 + r] * b.data[c * 4 + 2] +
-                            a.data[3 * 4 + r] * b.data[c * 4 + 3];
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        res.data[c * 4 + r] =
+                                a.data[0 * 4 + r] * b.data[c * 4 + 0] +
+                                a.data[1 * 4 + r] * b.data[c * 4 + 1] +
+                                a.data[2 * 4 + r] * b.data[c * 4 + 2] +
+                                a.data[3 * 4 + r] * b.data[c * 4 + 3];
+                    }
                 }
             }
+            else
+            {
+                // Column c of the result is a times column c of b.
+                Detail::TransformColumns(a.data.data(), b.data.data(), res.data.data(), 4);
+            }
             return res;
         }
+
+        // m * v.
+        static Vector4 Transform(const Matrix44 &m, const Vector4 &v)
+        {
+            Vector4 res;
+            Detail::TransformColumns(m.data.data(), &v.x, &res.x, 1);
+            return res;
+        }
+
+        // m * (p, 1).
+        static Vector4 TransformPoint(const Matrix44 &m, const Vector3 &p)
+        {
+            return Transform(m, {p.x, p.y, p.z, 1.0f});
+        }
+
+        // Upper 3x3 of m times v: directions, no translation.
+        static Vector3 TransformVector(const Matrix44 &m, const Vector3 &v)
+        {
+            const Vector4 res = Transform(m, {v.x, v.y, v.z, 0.0f});
+            return {res.x, res.y, res.z};
+        }
+
+        // Batch forms: out[i] = m * in[i] for inCount vectors; Transform may work in place.
+        static void Transform(const Matrix44 &m, const Vector4 *in, Vector4 *out, const size_t inCount)
+        {
+            Detail::TransformColumns(m.data.data(), &in->x, &out->x, inCount);
+        }
+
+        static void TransformPoints(const Matrix44 &m, const Vector3 *in, Vector4 *out, const size_t inCount)
+        {
+            for (size_t i = 0; i < inCount; ++i)
+            {
+                out[i] = {in[i].x, in[i].y, in[i].z, 1.0f};
+            }
+            Transform(m, out, out, inCount);
+        }
     };
 }
@@ -1,22 +1,61 @@
 ﻿#include <stdlib.h>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <imgui.h>
+#include <imgui_impl_sdl2.h>
+#include <imgui_impl_sdlrenderer2.h>
+#include <spdlog/spdlog.h>
 
 #include "../Include/Application.h"
+#include "../Include/ImageWriter.h"
+#include "../Include/Profiler.h"
 
 
 Application::Application(std::string_view inTitle, const uint32_t inWidth, const uint32_t inHeight)
-    : title(inTitle), width(inWidth), height(inHeight)
+    : title(inTitle), width(inWidth), height(inHeight), windowWidth(inWidth), windowHeight(inHeight)
 {
     // Default to black.
     framebuffer.resize(inWidth * inHeight, 0xFF000000);
+    outputPlane = framebuffer.data();
+    outputPitch = inWidth;
+    colorPlane = framebuffer.data();
+    colorPitch = inWidth;
 
     // 默认深度 1.0 (最远)
-    zBuffer.resize(inWidth * inHeight, 1.0f);
+    AssignDepthPlane(zBuffer, static_cast<size_t>(inWidth) * inHeight);
+    visibilityBuffer.resize(inWidth * inHeight, 0);
+    ResizeHiZ();
+
+    Profiler::SetThreadName("Main");
+    jobSystem = std::make_unique<JobSystem>();
+    frameArena = std::make_unique<FrameArena>(jobSystem->GetThreadCount());
+    tileRasterizer.Resize(inWidth, inHeight);
+    PresizeFrameArena();
 }
 
 Application::~Application()
 {
+    if (frameThread.joinable())
+    {
+        {
+            std::lock_guard lock(frameMutex);
+            bFrameThreadStopping = true;
+        }
+        frameCondition.notify_all();
+        frameThread.join();
+    }
+
+    if (bImGuiInitialized)
+    {
+        ImGui_ImplSDLRenderer2_Shutdown();
+        ImGui_ImplSDL2_Shutdown();
+        ImGui::DestroyContext();
+    }
     SDL_Quit();
 }
 
@@ -26,7 +65,7 @@ bool Application::Init()
 
     window.reset(SDL_CreateWindow(title.c_str(),
                                   SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                                  width, height, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE));
+                                  windowWidth, windowHeight, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE));
 
     if (!window)
     {
@@ -36,15 +75,28 @@ bool Application::Init()
     renderer.reset(SDL_CreateRenderer(window.get(), -1, SDL_RENDERER_ACCELERATED));
     if (!renderer) return false;
 
-    // Streaming texture for CPU updates.
-    screenTexture.reset(SDL_CreateTexture(
+    // Streaming textures the rasterizer writes into through SDL_LockTexture.
+    for (auto &texture : screenTextures)
+    {
+        texture.reset(SDL_CreateTexture(
+            renderer.get(),
+            SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
+            windowWidth, windowHeight
+        ));
+
+        if (!texture) return false;
+    }
 
-        renderer.get(),
-        SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
-        width, height
-    ));
+    // Overlay UI drawn on top of the framebuffer in UpdateScreen.
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;
+    ImGui::StyleColorsDark();
+    ImGui_ImplSDL2_InitForSDLRenderer(window.get(), renderer.get());
+    ImGui_ImplSDLRenderer2_Init(renderer.get());
+    bImGuiInitialized = true;
 
-    return screenTexture != nullptr;
+    return true;
 }
 
 void Application::Run()
@@ -54,18 +106,309 @@ void Application::Run()
 
     while (bIsRunning)
     {
-        ProcessEvents();
+        if (bAsyncPresent)
+        {
+            // The frame in flight reads application state; let it finish before events change it.
+            WaitForFrame();
+            Profiler::EndFrame();
+        }
+        ResetFrameArena();
 
-        // Compute delta time.
-        const uint64_t currentTime = SDL_GetPerformanceCounter();
-        const float deltaTime = static_cast<float>(currentTime - lastTime) / SDL_GetPerformanceFrequency();
-        lastTime = currentTime;
+        {
+            PROFILE_SCOPE("Frame");
+            {
+                PROFILE_SCOPE("Events");
+                ProcessEvents();
+            }
 
+            // Compute delta time.
+            const uint64_t currentTime = SDL_GetPerformanceCounter();
+            const float deltaTime = static_cast<float>(currentTime - lastTime) / SDL_GetPerformanceFrequency();
+            lastTime = currentTime;
+
+            if (bAsyncPresent)
+            {
+                PresentAsync(deltaTime);
+            }
+            else
+            {
+                ApplyRenderScale();
+                LockBackBuffer();
+                RenderFrame(deltaTime);
+                bFramebufferRendered = !bBackLocked;
+                UnlockBackBuffer();
+                bBackFrameReady = false;
+
+                UpdateScreen(backTexture);
+            }
+        }
+        if (!bAsyncPresent) Profiler::EndFrame();
+    }
+
+    WaitForFrame();
+    if (bBackLocked) UnlockBackBuffer();
+}
+
+void Application::PresentAsync(const float deltaTime)
+{
+    // The back texture holds the frame the frame thread just finished. It becomes the front,
+    // and the next frame starts in the other texture before the front is presented.
+    const bool bHasFrame = bBackFrameReady;
+    const uint32_t front = backTexture;
+    UnlockBackBuffer();
+
+    backTexture ^= 1;
+    ApplyRenderScale();
+    LockBackBuffer();
+    if (!bBackLocked)
+    {
+        // Both frames would share the CPU framebuffer.
+        spdlog::warn("Streaming texture cannot be locked, async present disabled.");
+        bAsyncPresent = false;
+        return;
+    }
+    StartFrame(deltaTime);
+    bBackFrameReady = true;
+
+    if (bHasFrame) UpdateScreen(front);
+}
+
+void Application::StartFrame(const float deltaTime)
+{
+    if (!frameThread.joinable())
+    {
+        frameThread = std::thread(&Application::FrameThreadLoop, this);
+    }
+    {
+        std::lock_guard lock(frameMutex);
+        frameDeltaTime = deltaTime;
+        bFrameRequested = true;
+    }
+    frameCondition.notify_all();
+}
+
+void Application::WaitForFrame()
+{
+    std::unique_lock lock(frameMutex);
+    frameCondition.wait(lock, [&] { return !bFrameRequested; });
+}
+
+void Application::FrameThreadLoop()
+{
+    Profiler::SetThreadName("Frame");
+
+    std::unique_lock lock(frameMutex);
+    while (true)
+    {
+        frameCondition.wait(lock, [&] { return bFrameThreadStopping || bFrameRequested; });
+        if (bFrameThreadStopping) return;
+        const float deltaTime = frameDeltaTime;
+        lock.unlock();
+
+        RenderFrame(deltaTime);
+
+        lock.lock();
+        bFrameRequested = false;
+        frameCondition.notify_all();
+    }
+}
+
+void Application::RenderFrame(const float deltaTime)
+{
+    const auto start = std::chrono::steady_clock::now();
+    {
+        PROFILE_SCOPE("Update");
         OnUpdate(deltaTime);
+    }
+    {
+        PROFILE_SCOPE("Render");
         OnRender();
+    }
+    if (bMultisample)
+    {
+        PROFILE_SCOPE("Resolve");
+        ResolveSamples(GetRenderTarget(), *jobSystem);
+    }
+    if (bTiledTargets)
+    {
+        PROFILE_SCOPE("Detile");
+        DetileColor(GetRenderTarget(), colorPlane, colorPitch, *jobSystem);
+    }
+    if (colorPlane != outputPlane)
+    {
+        PROFILE_SCOPE("Upscale");
+        UpscaleBilinear(colorPlane, width, height, colorPitch, outputPlane, windowWidth, windowHeight, outputPitch,
+                        *jobSystem);
+    }
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    dynamicResolution.AddFrame(elapsed.count());
+}
+
+void Application::LockBackBuffer()
+{
+    if (bBackLocked) return;
+
+    SDL_Texture *texture = screenTextures[backTexture].get();
+    void *pixels = nullptr;
+    int pitch = 0;
+    if (texture && SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0)
+    {
+        outputPlane = static_cast<uint32_t *>(pixels);
+        outputPitch = static_cast<uint32_t>(pitch) / sizeof(uint32_t);
+        bBackLocked = true;
+        BindColorPlane();
+        return;
+    }
+
+    if (texture) spdlog::error("SDL_LockTexture failed: {}", SDL_GetError());
+    outputPlane = framebuffer.data();
+    outputPitch = windowWidth;
+    BindColorPlane();
+}
+
+void Application::UnlockBackBuffer()
+{
+    SDL_Texture *texture = screenTextures[backTexture].get();
+    if (bBackLocked)
+    {
+        PROFILE_SCOPE("Unlock");
+        SDL_UnlockTexture(texture);
+        bBackLocked = false;
+    }
+    else if (texture && bFramebufferRendered)
+    {
+        PROFILE_SCOPE("Upload");
+        // Lock failed: the frame went to the CPU framebuffer.
+        SDL_UpdateTexture(texture, nullptr, framebuffer.data(), windowWidth * sizeof(uint32_t));
+    }
+    bFramebufferRendered = false;
+    // Between frames nothing may write into the texture.
+    outputPlane = framebuffer.data();
+    outputPitch = windowWidth;
+    BindColorPlane();
+}
+
+bool Application::RunHeadless(const HeadlessOptions &inOptions)
+{
+    if (inOptions.frameCount == 0) return false;
+    if (!inOptions.tracePath.empty()) Profiler::SetEnabled(true);
+    bUseVisibilityBuffer = inOptions.bVisibilityBuffer;
+    SetMultisample(inOptions.bMultisample);
+    SetTiledTargets(inOptions.bTiledTargets);
+    SetDepthFormat(inOptions.depthFormat);
+    SetReverseZ(inOptions.bReverseZ);
+    SetShadowMapSize(inOptions.shadowMapSize);
+    shadowMap.SetPcfRadius(inOptions.shadowPcfRadius);
+    shadowUpdate = inOptions.shadowUpdate;
+    shadingModel = inOptions.shadingModel;
+    lodErrorPixels = inOptions.lodErrorPixels;
+    dynamicResolution.SetTargetMs(inOptions.targetFrameMs);
+
+    std::vector<double> frameMs;
+    frameMs.reserve(inOptions.frameCount);
+    triangleCount = 0;
+    double scaleSum = 0.0;
+
+    for (uint32_t frame = 0; frame < inOptions.frameCount; ++frame)
+    {
+        ResetFrameArena();
+        ApplyRenderScale();
+        scaleSum += dynamicResolution.GetScale();
+
+        const auto start = std::chrono::steady_clock::now();
+        {
+            PROFILE_SCOPE("Frame");
+            RenderFrame(inOptions.deltaTime);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        Profiler::EndFrame();
+    }
+
+    double totalMs = 0.0;
+    for (const double ms : frameMs) totalMs += ms;
+    std::vector<double> sorted = frameMs;
+    ranges::sort(sorted);
+    const size_t count = sorted.size();
+    const double medianMs = count % 2 ? sorted[count / 2] : 0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+    // Nearest-rank percentile.
+    const double p99Ms = sorted[(count * 99 + 99) / 100 - 1];
+    // Frames too fast for the clock sum to 0; report no rate rather than convert inf.
+    const uint64_t trianglesPerSec = totalMs > 0.0 ? static_cast<uint64_t>(triangleCount / (totalMs / 1000.0)) : 0;
+
+    std::ostringstream report;
+    report << "{\n"
+           << "  \"frames\": " << count << ",\n"
+           << "  \"width\": " << windowWidth << ",\n"
+           << "  \"height\": " << windowHeight << ",\n"
+           << "  \"deltaTime\": " << inOptions.deltaTime << ",\n"
+           << "  \"threads\": " << jobSystem->GetThreadCount() << ",\n"
+           << "  \"visibilityBuffer\": " << (bUseVisibilityBuffer ? "true" : "false") << ",\n"
+           << "  \"msaa\": " << (bMultisample ? "true" : "false") << ",\n"
+           << "  \"tiled\": " << (bTiledTargets ? "true" : "false") << ",\n"
+           << "  \"depthFormat\": \"" << GetDepthFormatName(depthFormat) << "\",\n"
+           << "  \"reverseZ\": " << (bReverseZ ? "true" : "false") << ",\n"
+           << "  \"shadowMapSize\": " << shadowMap.GetSize() << ",\n"
+           << "  \"shadowPcfRadius\": " << shadowMap.GetPcfRadius() << ",\n"
+           << "  \"shadowUpdate\": \"" << GetShadowUpdateName(shadowUpdate) << "\",\n"
+           << "  \"shadowPasses\": " << shadowMap.GetUpdateCount() << ",\n"
+           << "  \"shading\": \"" << GetShadingModelName(shadingModel) << "\",\n"
+           << "  \"lodErrorPixels\": " << lodErrorPixels << ",\n"
+           << "  \"targetFrameMs\": " << dynamicResolution.GetTargetMs() << ",\n"
+           << "  \"averageRenderScale\": " << scaleSum / count << ",\n"
+           << "  \"minMs\": " << sorted.front() << ",\n"
+           << "  \"medianMs\": " << medianMs << ",\n"
+           << "  \"p99Ms\": " << p99Ms << ",\n"
+           << "  \"maxMs\": " << sorted.back() << ",\n"
+           << "  \"arenaHighWaterBytes\": " << frameArena->GetStats().highWaterBytes << ",\n"
+           << "  \"arenaCapacityBytes\": " << frameArena->GetStats().capacityBytes << ",\n"
+           << "  \"trianglesPerFrame\": " << triangleCount / count << ",\n"
+           << "  \"trianglesPerSec\": " << trianglesPerSec << "\n"
+           << "}\n";
+
+    bool bSucceeded = true;
+    if (inOptions.reportPath.empty())
+    {
+        std::cout << report.str() << std::flush;
+    }
+    else
+    {
+        std::ofstream file(inOptions.reportPath);
+        file << report.str();
+        if (!file)
+        {
+            spdlog::error("Failed to write report {}.", inOptions.reportPath);
+            bSucceeded = false;
+        }
+    }
 
-        UpdateScreen();
+    if (!inOptions.tracePath.empty())
+    {
+        if (Profiler::WriteChromeTrace(inOptions.tracePath))
+        {
+            spdlog::info("Wrote trace to {}.", inOptions.tracePath);
+        }
+        else
+        {
+            spdlog::error("Failed to write trace {}.", inOptions.tracePath);
+            bSucceeded = false;
+        }
     }
+
+    if (!inOptions.imagePath.empty())
+    {
+        if (WriteImage(inOptions.imagePath, framebuffer.data(), windowWidth, windowHeight))
+        {
+            spdlog::info("Wrote final frame to {}.", inOptions.imagePath);
+        }
+        else
+        {
+            spdlog::error("Failed to write image {}.", inOptions.imagePath);
+            bSucceeded = false;
+        }
+    }
+
+    return bSucceeded;
 }
 
 void Application::ProcessEvents()
@@ -73,7 +416,90 @@ void Application::ProcessEvents()
     SDL_Event event;
     while (SDL_PollEvent(&event))
     {
+        if (bImGuiInitialized) ImGui_ImplSDL2_ProcessEvent(&event);
+
         if (event.type == SDL_QUIT) bIsRunning = false;
+        if (event.type == SDL_KEYDOWN && !event.key.repeat)
+        {
+            // F1: profiler overlay. F2: start a trace capture, press again to write it.
+            if (event.key.keysym.sym == SDLK_F1)
+            {
+                bShowProfiler = !bShowProfiler;
+                Profiler::SetEnabled(bShowProfiler || bCapturingTrace);
+            }
+            else if (event.key.keysym.sym == SDLK_F2)
+            {
+                if (bCapturingTrace)
+                {
+                    if (Profiler::WriteChromeTrace(TracePath))
+                    {
+                        spdlog::info("Wrote trace to {}.", TracePath);
+                    }
+                    else
+                    {
+                        spdlog::error("Failed to write trace {}.", TracePath);
+                    }
+                }
+                else
+                {
+                    spdlog::info("Trace capture started, press F2 again to save it.");
+                }
+                bCapturingTrace = !bCapturingTrace;
+                Profiler::SetEnabled(bShowProfiler || bCapturingTrace);
+            }
+            else if (event.key.keysym.sym == SDLK_F3)
+            {
+                bUseVisibilityBuffer = !bUseVisibilityBuffer;
+                spdlog::info("Visibility buffer {}.", bUseVisibilityBuffer ? "on" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F5)
+            {
+                bAsyncPresent = !bAsyncPresent;
+                spdlog::info("Async present {}.", bAsyncPresent ? "on" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F4)
+            {
+                shadingModel = static_cast<ShadingModel>((static_cast<int>(shadingModel) + 1) %
+                                                         (static_cast<int>(ShadingModel::Textured) + 1));
+                spdlog::info("Shading model {}.", GetShadingModelName(shadingModel));
+            }
+            else if (event.key.keysym.sym == SDLK_F6)
+            {
+                lodErrorPixels = lodErrorPixels > 0.0f ? 0.0f : DefaultLodErrorPixels;
+                spdlog::info("Mesh LODs {}.", lodErrorPixels > 0.0f ? "on" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F7)
+            {
+                dynamicResolution.SetTargetMs(dynamicResolution.IsEnabled() ? 0.0f : DefaultTargetFrameMs);
+                spdlog::info("Dynamic resolution {}.", dynamicResolution.IsEnabled() ? "on" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F8)
+            {
+                SetMultisample(!bMultisample);
+                spdlog::info("MSAA {}.", bMultisample ? "4x" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F9)
+            {
+                SetTiledTargets(!bTiledTargets);
+                spdlog::info("Tiled render targets {}.", bTiledTargets ? "on" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F10)
+            {
+                SetShadowMapSize(IsShadowEnabled() ? 0 : ShadowMap::DefaultSize);
+                spdlog::info("Shadows {}.", IsShadowEnabled() ? "on" : "off");
+            }
+            else if (event.key.keysym.sym == SDLK_F11)
+            {
+                SetDepthFormat(static_cast<DepthFormat>((static_cast<int>(depthFormat) + 1) %
+                                                        (static_cast<int>(DepthFormat::Unorm16) + 1)));
+                spdlog::info("Depth format {}.", GetDepthFormatName(depthFormat));
+            }
+            else if (event.key.keysym.sym == SDLK_F12)
+            {
+                SetReverseZ(!bReverseZ);
+                spdlog::info("Reverse-Z {}.", bReverseZ ? "on" : "off");
+            }
+        }
         if (event.type == SDL_WINDOWEVENT)
         {
             if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ||
@@ -83,53 +509,278 @@ void Application::ProcessEvents()
                        static_cast<uint32_t>(event.window.data2));
             }
         }
-        // ImGui event handling can go here.
     }
 }
 
-void Application::UpdateScreen() const
+void Application::UpdateScreen(const uint32_t textureIndex) const
 {
-    // Upload framebuffer to the GPU texture.
-    SDL_UpdateTexture(screenTexture.get(), nullptr, framebuffer.data(), width * sizeof(uint32_t));
+    {
+        PROFILE_SCOPE("Blit");
+        SDL_RenderClear(renderer.get());
+        SDL_RenderCopy(renderer.get(), screenTextures[textureIndex].get(), nullptr, nullptr);
+    }
 
-    SDL_RenderClear(renderer.get());
-    SDL_RenderCopy(renderer.get(), screenTexture.get(), nullptr, nullptr);
+    // ImGui rendering after the texture upload.
+    if (bImGuiInitialized)
+    {
+        PROFILE_SCOPE("Overlay");
+        ImGui_ImplSDLRenderer2_NewFrame();
+        ImGui_ImplSDL2_NewFrame();
+        ImGui::NewFrame();
+        if (bShowProfiler) DrawProfilerOverlay();
+        ImGui::Render();
+        ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), renderer.get());
+    }
 
-    // ImGui rendering can go here after the texture upload.
+    {
+        PROFILE_SCOPE("Present");
+        SDL_RenderPresent(renderer.get());
+    }
+}
 
-    SDL_RenderPresent(renderer.get());
+void Application::ResetFrameArena()
+{
+    lastFrameArenaStats = frameArena->GetStats();
+    lastRenderWidth = width;
+    lastRenderHeight = height;
+    lastRenderScale = dynamicResolution.GetScale();
+    frameArena->Reset();
+    tileRasterizer.BeginFrame(*frameArena);
+    shadowRasterizer.BeginFrame(*frameArena);
+}
+
+void Application::PresizeFrameArena()
+{
+    const size_t binBytes = tileRasterizer.GetFlushBytesPerThread() + shadowRasterizer.GetFlushBytesPerThread();
+    frameArena->Reserve(binBytes, binBytes);
+}
+
+void Application::DrawProfilerOverlay() const
+{
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    if (ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        const double frameMs = Profiler::GetFrameMs();
+        ImGui::Text("Frame %.2f ms (%.0f fps), %u threads", frameMs, frameMs > 0.0 ? 1000.0 / frameMs : 0.0,
+                    jobSystem->GetThreadCount());
+        if (dynamicResolution.IsEnabled())
+        {
+            ImGui::Text("Render %ux%u (%.0f%%), budget %.1f ms", lastRenderWidth, lastRenderHeight,
+                        lastRenderScale * 100.0f, dynamicResolution.GetTargetMs());
+        }
+        ImGui::Text("Frame arena %.1f MB, peak %.1f of %.1f MB",
+                    static_cast<double>(lastFrameArenaStats.usedBytes) / 1048576.0,
+                    static_cast<double>(lastFrameArenaStats.highWaterBytes) / 1048576.0,
+                    static_cast<double>(lastFrameArenaStats.capacityBytes) / 1048576.0);
+        ImGui::Separator();
+
+        // Times are summed over threads, so parallel stages can exceed the frame time.
+        if (ImGui::BeginTable("Stages", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("ms");
+            ImGui::TableSetupColumn("avg ms");
+            ImGui::TableSetupColumn("calls");
+            ImGui::TableHeadersRow();
+            for (const Profiler::StageStats &stage : Profiler::GetStageStats())
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stage.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stage.lastMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stage.averageMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", stage.calls);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
 }
 
 void Application::Resize(uint32_t newWidth, uint32_t newHeight)
 {
     if (newWidth == 0 || newHeight == 0) return;
-    if (newWidth == width && newHeight == height) return;
+    if (newWidth == windowWidth && newHeight == windowHeight) return;
+
+    windowWidth = newWidth;
+    windowHeight = newHeight;
+
+    // Called between frames, so nothing is in flight; with async present the finished frame
+    // may still be locked in the back texture and is dropped.
+    if (bBackLocked) UnlockBackBuffer();
+    framebuffer.assign(windowWidth * windowHeight, 0xFF000000);
+    outputPlane = framebuffer.data();
+    outputPitch = windowWidth;
+    ResizeRenderTargets(dynamicResolution.Apply(windowWidth), dynamicResolution.Apply(windowHeight));
+
+    for (auto &texture : screenTextures)
+    {
+        texture.reset(SDL_CreateTexture(
+            renderer.get(),
+            SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
+            windowWidth, windowHeight
+        ));
+    }
+    // The unpresented frame went with the old textures.
+    bBackFrameReady = false;
+}
+
+void Application::ApplyRenderScale()
+{
+    const uint32_t renderWidth = dynamicResolution.Apply(windowWidth);
+    const uint32_t renderHeight = dynamicResolution.Apply(windowHeight);
+    if (renderWidth == width && renderHeight == height) return;
+
+    ResizeRenderTargets(renderWidth, renderHeight);
+    spdlog::info("Render resolution {}x{} ({:.0f}%).", width, height, dynamicResolution.GetScale() * 100.0f);
+}
+
+void Application::ResizeRenderTargets(const uint32_t inWidth, const uint32_t inHeight)
+{
+    width = inWidth;
+    height = inHeight;
+
+    // Shrinking keeps the allocations, so scale changes after the first are cheap.
+    const bool bScaled = width != windowWidth || height != windowHeight;
+    scaledColor.assign(bScaled ? width * height : 0, 0xFF000000);
+    // Tiled planes are padded to whole tiles.
+    const uint32_t tilesX = bTiledTargets ? (width + HiZBlockSize - 1) / HiZBlockSize : 0;
+    const size_t planeSize = GetPlaneSize(width, height, tilesX);
+    AssignDepthPlane(zBuffer, planeSize);
+    visibilityBuffer.assign(planeSize, 0);
+    tiledColor.assign(bTiledTargets ? planeSize : 0, 0xFF000000);
+    if (bMultisample)
+    {
+        samplePitch = (width + Simd::Width - 1) / Simd::Width * Simd::Width;
+        AssignDepthPlane(sampleDepth, static_cast<size_t>(samplePitch) * height * MsaaSamples);
+        sampleColor.assign(static_cast<size_t>(samplePitch) * height * MsaaSamples, 0xFF000000);
+        sampleUniform.assign(static_cast<size_t>(samplePitch) * height, ~0u);
+    }
+    else
+    {
+        samplePitch = 0;
+        sampleDepth = {};
+        sampleColor = {};
+        sampleUniform = {};
+    }
+    ResizeHiZ();
+    tileRasterizer.Resize(width, height);
+    PresizeFrameArena();
+    BindColorPlane();
+}
+
+void Application::SetMultisample(const bool bInEnabled)
+{
+    if (bInEnabled == bMultisample) return;
+    bMultisample = bInEnabled;
+    ResizeRenderTargets(width, height);
+}
+
+void Application::SetDepthFormat(const DepthFormat inFormat)
+{
+    if (inFormat == depthFormat) return;
+    depthFormat = inFormat;
+    ResizeRenderTargets(width, height);
+}
+
+void Application::SetReverseZ(const bool bInEnabled)
+{
+    if (bInEnabled == bReverseZ) return;
+    bReverseZ = bInEnabled;
+    ResizeRenderTargets(width, height);
+}
 
-    width = newWidth;
-    height = newHeight;
+void Application::SetShadowMapSize(const uint32_t inSize)
+{
+    if (inSize == shadowMap.GetSize()) return;
+    shadowMap.Resize(inSize);
+    shadowRasterizer.Resize(inSize, inSize);
+    PresizeFrameArena();
+    lighting.shadowMap = inSize > 0 ? &shadowMap : nullptr;
+}
 
-    framebuffer.assign(width * height, 0xFF000000);
-    zBuffer.assign(width * height, 1.0f);
+void Application::SetTiledTargets(const bool bInEnabled)
+{
+    if (bInEnabled == bTiledTargets) return;
+    bTiledTargets = bInEnabled;
+    ResizeRenderTargets(width, height);
+}
 
-    screenTexture.reset(SDL_CreateTexture(
-        renderer.get(),
-        SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
-        width, height
-    ));
+void Application::BindColorPlane()
+{
+    if (width != windowWidth || height != windowHeight)
+    {
+        colorPlane = scaledColor.data();
+        colorPitch = width;
+    }
+    else
+    {
+        colorPlane = outputPlane;
+        colorPitch = outputPitch;
+    }
+}
+
+void Application::ResizeHiZ()
+{
+    hiZWidth = (width + HiZBlockSize - 1) / HiZBlockSize;
+    const uint32_t hiZHeight = (height + HiZBlockSize - 1) / HiZBlockSize;
+    hiZMin.assign(hiZWidth * hiZHeight, GetFarDepth(bReverseZ));
+    hiZMax.assign(hiZWidth * hiZHeight, GetFarDepth(bReverseZ));
+    hiZCoverage.assign(hiZWidth * hiZHeight * (bMultisample ? MsaaSamples : 1), 0);
+    hiZState.assign(hiZWidth * hiZHeight, 0);
 }
 
 void Application::SetPixel(uint32_t x, uint32_t y, uint32_t color)
 {
     if (x < width && y < height)
     {
-        framebuffer[y * width + x] = color;
+        const RenderTarget target = GetRenderTarget();
+        const int px = static_cast<int>(x);
+        const int py = static_cast<int>(y);
+        target.color[GetRowOffset(target, py, target.colorPitch) + GetColumnOffset(target, px)] = color;
     }
 }
 
 void Application::Clear(const uint32_t color)
 {
-    ranges::fill(framebuffer, color);
-    ranges::fill(zBuffer, 1.0f);
+    PROFILE_SCOPE("Clear");
+    if (bMultisample)
+    {
+        // The resolve overwrites the color plane. Flagged pixels only read their first sample.
+        ClearDepthPlane(sampleDepth);
+        ranges::fill(sampleUniform, ~0u);
+        for (size_t span = 0; span < sampleColor.size(); span += MsaaSamples * Simd::Width)
+        {
+            std::fill_n(sampleColor.data() + span, Simd::Width, color);
+        }
+    }
+    else if (bTiledTargets)
+    {
+        ranges::fill(tiledColor, color);
+        ClearDepthPlane(zBuffer);
+    }
+    else if (colorPitch == width)
+    {
+        std::fill_n(colorPlane, static_cast<size_t>(width) * height, color);
+        ClearDepthPlane(zBuffer);
+    }
+    else
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            std::fill_n(colorPlane + static_cast<size_t>(y) * colorPitch, width, color);
+        }
+        ClearDepthPlane(zBuffer);
+    }
+    // One entry per 8x8 block, so this is 1/64th of the depth clear.
+    ranges::fill(hiZMin, GetFarDepth(bReverseZ));
+    ranges::fill(hiZMax, GetFarDepth(bReverseZ));
+    ranges::fill(hiZCoverage, 0);
+    ranges::fill(hiZState, 0);
 }
 
 void Application::DrawLine(int inX0, int inY0, const int inX1, const int inY1, const uint32_t inColor)
@@ -161,75 +812,84 @@ void Application::DrawLine(int inX0, int inY0, const int inX1, const int inY1, c
 
 Math::Vector3 Application::ComputeBarycentric2D(float x, float y, const Math::Vector3 *inV)
 {
-    float c1 = (x * (inV[1].y - inV[2].y) + (inV[2].x - inV[1].x) * y + inV[1].x * inV[2].y - inV[2].x * inV[1].y) /
-               (inV[0].x * (inV[1].y - inV[2].y) + (inV[2].x - inV[1].x) * inV[0].y + inV[1].x * inV[2].y - inV[2].x *
-                inV[1].y);
-    float c2 = (x * (inV[2].y - inV[0].y) + (inV[0].x - inV[2].x) * y + inV[2].x * inV[0].y - inV[0].x * inV[2].y) /
-               (inV[1].x * (inV[2].y - inV[0].y) + (inV[0].x - inV[2].x) * inV[1].y + inV[2].x * inV[0].y - inV[0].x *
-                inV[2].y);
-    return {c1, c2, 1.0f - c1 - c2};
+    return ::ComputeBarycentric2D(x, y, inV);
+}
+
+void Application::AssignDepthPlane(std::vector<uint32_t> &outPlane, const size_t inCount) const
+{
+    outPlane.resize((inCount * GetDepthFormatSize(depthFormat) + 3) / 4);
+    ClearDepthPlane(outPlane);
+}
+
+void Application::ClearDepthPlane(std::vector<uint32_t> &outPlane) const
+{
+    ClearDepth(outPlane.data(), outPlane.size() * 4 / GetDepthFormatSize(depthFormat), depthFormat, bReverseZ);
 }
 
+RenderTarget Application::GetRenderTarget()
+{
+    // MSAA shades in the raster pass, so it bypasses the visibility buffer.
+    RenderTarget target{colorPlane, colorPitch, zBuffer.data(), width, height, hiZMin.data(), hiZMax.data(),
+                        hiZCoverage.data(), hiZState.data(), hiZWidth,
+                        bUseVisibilityBuffer && !bMultisample ? visibilityBuffer.data() : nullptr};
+    target.depthFormat = depthFormat;
+    target.bReverseZ = bReverseZ;
+    if (bMultisample)
+    {
+        target.sampleDepth = sampleDepth.data();
+        target.sampleColor = sampleColor.data();
+        target.sampleUniform = sampleUniform.data();
+        target.samplePitch = samplePitch;
+    }
+    if (bTiledTargets)
+    {
+        target.color = tiledColor.data();
+        target.colorPitch = width;
+        target.tilesX = hiZWidth;
+    }
+    return target;
+}
 
 void Application::DrawTriangle(const Math::Vector3 &s0, const Math::Vector3 &s1, const Math::Vector3 &s2,
                                const Math::Vector3 &n0, const Math::Vector3 &n1, const Math::Vector3 &n2,
                                uint32_t baseColor)
 {
-    // Bounding box in screen space.
-    // 计算包围盒 (Bounding Box) 并限制在屏幕范围内 (Clamping)
-    // 这一步能显著提升性能，防止在屏幕外无效循环
-    int minX = static_cast<int>(std::floor(std::min({s0.x, s1.x, s2.x})));
-    int maxX = static_cast<int>(std::ceil(std::max({s0.x, s1.x, s2.x})));
-    int minY = static_cast<int>(std::floor(std::min({s0.y, s1.y, s2.y})));
-    int maxY = static_cast<int>(std::ceil(std::max({s0.y, s1.y, s2.y})));
-
-    minX = std::max(0, minX);
-    maxX = std::min(static_cast<int>(width) - 1, maxX);
-    minY = std::max(0, minY);
-    maxY = std::min(static_cast<int>(height) - 1, maxY);
-
-    Math::Vector3 lightDir{0.5f, 1.0f, -1.0f}; // 定义光源方向
-    lightDir.Normalize();
-
-    const Math::Vector3 pts[3] = {s0, s1, s2};
-
-    for (int y = minY; y <= maxY; ++y)
+    ++triangleCount;
+    // Normals are the Phong varyings.
+    const ScreenTriangle tri{
+        {s0, s1, s2}, {{n0.x, n0.y, n0.z}, {n1.x, n1.y, n1.z}, {n2.x, n2.y, n2.z}}, baseColor
+    };
+    const TileRect screen{0, 0, static_cast<int>(width) - 1, static_cast<int>(height) - 1};
+    const RasterPipeline pipeline = RasterPipeline::Create<PhongFS>(lighting, depthFormat);
+    if (bMultisample)
     {
-        for (int x = minX; x <= maxX; ++x)
-        {
-            Math::Vector3 bc = ComputeBarycentric2D(x + 0.5f, y + 0.5f, pts);
-            if (bc.x >= 0 && bc.y >= 0 && bc.z >= 0)
-            {
-                // 1. 深度插值与测试
-                float depth = bc.x * s0.z + bc.y * s1.z + bc.z * s2.z;
-                int idx = y * width + x;
-                if (depth < zBuffer[idx])
-                {
-                    zBuffer[idx] = depth;
-
-                    // 2. 法线插值 (Phong Shading 基础)
-                    Math::Vector3 normal;
-                    normal.x = bc.x * n0.x + bc.y * n1.x + bc.z * n2.x;
-                    normal.y = bc.x * n0.y + bc.y * n1.y + bc.z * n2.y;
-                    normal.z = bc.x * n0.z + bc.y * n1.z + bc.z * n2.z;
-                    normal.Normalize();
-
-                    // 1. 定义一个基础环境光强度 (建议 0.1 到 0.2 之间)
-                    float ambient = 0.15f;
-                    // 3. 计算 Lambert 漫反射强度: I = max(0, N dot L)
-                    float intensity = std::max(0.0f, Math::Vector3::Dot(normal, lightDir * -1.0f));
+        pipeline.rasterizeMultisample(GetRenderTarget(), screen, tri, SimdLighting(lighting));
+    }
+    else
+    {
+        pipeline.rasterize(GetRenderTarget(), screen, tri, SimdLighting(lighting));
+    }
+}
 
-                    // 最终亮度 = 环境光 + 漫反射光
-                    float finalBrightness = std::min(1.0f, ambient + intensity);
+void Application::SubmitTriangle(const VSOutput &v0, const VSOutput &v1, const VSOutput &v2, uint32_t baseColor,
+                                 const Texture *texture)
+{
+    ++triangleCount;
+    // Clipping keeps w at or beyond the near plane, so it is positive here.
+    ScreenTriangle tri{{v0.screenPos, v1.screenPos, v2.screenPos}, {}, baseColor,
+                       {1.0f / v0.clipPos.w, 1.0f / v1.clipPos.w, 1.0f / v2.clipPos.w}, texture};
+    std::copy_n(v0.varyings, MaxVaryings, tri.varyings[0]);
+    std::copy_n(v1.varyings, MaxVaryings, tri.varyings[1]);
+    std::copy_n(v2.varyings, MaxVaryings, tri.varyings[2]);
+    tileRasterizer.Submit(tri);
+}
 
-                    // 4. 应用光照到颜色 (简单处理 RGB 通道)
-                    const uint8_t r = (uint8_t) ((baseColor & 0x000000FF) * finalBrightness);
-                    const uint8_t g = (uint8_t) (((baseColor & 0x0000FF00) >> 8) * finalBrightness);
-                    const uint8_t b = (uint8_t) (((baseColor & 0x00FF0000) >> 16) * finalBrightness);
+void Application::SubmitShadowTriangle(const VSOutput &v0, const VSOutput &v1, const VSOutput &v2)
+{
+    shadowRasterizer.Submit({{v0.screenPos, v1.screenPos, v2.screenPos}, {}, 0});
+}
 
-                    framebuffer[idx] = 0xFF000000 | (b << 16) | (g << 8) | r;
-                }
-            }
-        }
-    }
+void Application::FlushShadowTriangles()
+{
+    shadowRasterizer.Flush(shadowMap.GetRenderTarget(), *jobSystem, RasterPipeline::CreateDepthOnly());
 }
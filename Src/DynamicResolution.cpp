@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../Include/DynamicResolution.h"
+#include "../Include/JobSystem.h"
+#include "../Include/Simd.h"
+
+namespace
+{
+    // Output rows per upscale job.
+    constexpr uint32_t UpscaleRowsPerJob = 16;
+    // Weights are 0..128, so (b - a) * w + rounding stays inside 16 bits.
+    constexpr int WeightBits = 7;
+    constexpr int WeightOne = 1 << WeightBits;
+
+    // Left (or top) source texel and the weight of its neighbour, for each output position.
+    // The left texel stays at least one short of the edge so both can be loaded as a pair.
+    struct SampleTap
+    {
+        uint32_t first;
+        int weight;
+    };
+
+    SampleTap GetTap(const uint32_t inDst, const uint32_t inDstSize, const uint32_t inSrcSize)
+    {
+        if (inSrcSize < 2) return {0, 0};
+        const float position = std::clamp((static_cast<float>(inDst) + 0.5f) * static_cast<float>(inSrcSize) /
+                                          static_cast<float>(inDstSize) - 0.5f,
+                                          0.0f, static_cast<float>(inSrcSize - 1));
+        const auto first = std::min(static_cast<uint32_t>(position), inSrcSize - 2);
+        return {first, static_cast<int>(std::lround((position - static_cast<float>(first)) * WeightOne))};
+    }
+
+    // a + (b - a) * w, per channel.
+    int Lerp(const int inA, const int inB, const int inWeight)
+    {
+        return inA + (((inB - inA) * inWeight + WeightOne / 2) >> WeightBits);
+    }
+
+    // Blend two source rows into outColumn, four 16-bit channels per texel.
+    void BlendRows(const uint32_t* inRow0, const uint32_t* inRow1, const int inWeightY, const uint32_t inWidth,
+                   int16_t* outColumn)
+    {
+        uint32_t x = 0;
+#if !defined(RENDERER_SIMD_SCALAR)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(WeightOne / 2);
+        const __m128i weight = _mm_set1_epi16(static_cast<short>(inWeightY));
+        const auto lerp = [&](const __m128i inA, const __m128i inB)
+        {
+            return _mm_add_epi16(
+                inA, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(inB, inA), weight), round), WeightBits));
+        };
+        for (; x + 4 <= inWidth; x += 4)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inRow0 + x));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inRow1 + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(outColumn + 4 * x),
+                             lerp(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(outColumn + 4 * x + 8),
+                             lerp(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+        }
+#endif
+        for (; x < inWidth; ++x)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const auto channel = [c](const uint32_t inTexel) { return static_cast<int>((inTexel >> (8 * c)) & 0xFF); };
+                outColumn[4 * x + c] = static_cast<int16_t>(Lerp(channel(inRow0[x]), channel(inRow1[x]), inWeightY));
+            }
+        }
+    }
+
+    // Blend neighbouring texels of the blended row into the output row. inWeights holds each
+    // output pixel's weight four times, once per channel; only the SIMD path reads it.
+    void BlendColumns(const int16_t* inColumn, const SampleTap* inTaps, [[maybe_unused]] const int16_t* inWeights,
+                      const uint32_t inDstWidth, const uint32_t inSecondOffset, uint32_t* outRow)
+    {
+        const auto blendPixel = [&](const uint32_t inX)
+        {
+            const int16_t* left = inColumn + 4 * inTaps[inX].first;
+            const int16_t* right = left + 4 * inSecondOffset;
+            uint32_t pixel = 0;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                pixel |= static_cast<uint32_t>(Lerp(left[c], right[c], inTaps[inX].weight)) << (8 * c);
+            }
+            return pixel;
+        };
+
+        uint32_t x = 0;
+#if !defined(RENDERER_SIMD_SCALAR)
+        if (inSecondOffset == 1)
+        {
+            // Two output pixels per blend: each load brings a texel and its right neighbour.
+            const __m128i round = _mm_set1_epi16(WeightOne / 2);
+            const auto blendPair = [&](const uint32_t inX)
+            {
+                const __m128i pairA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inColumn + 4 * inTaps[inX].first));
+                const __m128i pairB =
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(inColumn + 4 * inTaps[inX + 1].first));
+                const __m128i left = _mm_unpacklo_epi64(pairA, pairB);
+                const __m128i right = _mm_unpackhi_epi64(pairA, pairB);
+                const __m128i weight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inWeights + 4 * inX));
+                return _mm_add_epi16(
+                    left, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(right, left), weight), round),
+                                         WeightBits));
+            };
+            // One pixel first when the row starts 4 bytes off an 8-byte boundary, so the pair
+            // steps below can reach 16-byte alignment.
+            if (x < inDstWidth && (reinterpret_cast<uintptr_t>(outRow + x) & 7) != 0)
+            {
+                outRow[x] = blendPixel(x);
+                ++x;
+            }
+            for (; x + 2 <= inDstWidth && (reinterpret_cast<uintptr_t>(outRow + x) & 15) != 0; x += 2)
+            {
+                const __m128i result = blendPair(x);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(outRow + x), _mm_packus_epi16(result, result));
+            }
+            // The output is only read again by the presenter, so bypass the cache.
+            for (; x + 4 <= inDstWidth; x += 4)
+            {
+                _mm_stream_si128(reinterpret_cast<__m128i*>(outRow + x), _mm_packus_epi16(blendPair(x), blendPair(x + 2)));
+            }
+        }
+#endif
+        for (; x < inDstWidth; ++x)
+        {
+            outRow[x] = blendPixel(x);
+        }
+    }
+}
+
+void DynamicResolution::SetTargetMs(const float inTargetMs)
+{
+    targetMs = std::max(0.0f, inTargetMs);
+    if (!IsEnabled()) scale = 1.0f;
+    windowMs = 0.0f;
+    windowCount = 0;
+}
+
+bool DynamicResolution::AddFrame(const float inFrameMs)
+{
+    if (!IsEnabled()) return false;
+
+    windowMs += inFrameMs;
+    if (++windowCount < WindowFrames) return false;
+    const float averageMs = windowMs / static_cast<float>(windowCount);
+    windowMs = 0.0f;
+    windowCount = 0;
+    if (averageMs <= targetMs && averageMs >= HeadroomRatio * targetMs) return false;
+
+    // Cost goes roughly with the pixel count, the square of the scale. Aim for the middle of
+    // the band; fixed per-frame work makes this undershoot, which the next windows correct.
+    const float aimMs = 0.5f * (1.0f + HeadroomRatio) * targetMs;
+    const float desired = scale * std::sqrt(aimMs / std::max(averageMs, 0.001f));
+    const float steps = std::floor(desired / ScaleStep) * ScaleStep;
+    const float next = std::clamp(averageMs > targetMs ? std::min(steps, scale - ScaleStep)
+                                                       : std::max(steps, scale + ScaleStep),
+                                  MinScale, 1.0f);
+    if (next == scale) return false;
+    scale = next;
+    return true;
+}
+
+uint32_t DynamicResolution::Apply(const uint32_t inWindowSize) const
+{
+    return std::max(1u, static_cast<uint32_t>(std::lround(static_cast<float>(inWindowSize) * scale)));
+}
+
+void UpscaleBilinear(const uint32_t* inSrc, const uint32_t inSrcWidth, const uint32_t inSrcHeight,
+                     const uint32_t inSrcPitch, uint32_t* outDst, const uint32_t inDstWidth, const uint32_t inDstHeight,
+                     const uint32_t inDstPitch, JobSystem& inJobs)
+{
+    if (inSrcWidth == 0 || inSrcHeight == 0 || inDstWidth == 0 || inDstHeight == 0) return;
+
+    std::vector<SampleTap> columns(inDstWidth);
+    std::vector<int16_t> weights(4 * static_cast<size_t>(inDstWidth));
+    for (uint32_t x = 0; x < inDstWidth; ++x)
+    {
+        columns[x] = GetTap(x, inDstWidth, inSrcWidth);
+        std::fill_n(&weights[4 * static_cast<size_t>(x)], 4, static_cast<int16_t>(columns[x].weight));
+    }
+    const uint32_t secondOffset = inSrcWidth >= 2 ? 1 : 0;
+
+    const uint32_t jobCount = (inDstHeight + UpscaleRowsPerJob - 1) / UpscaleRowsPerJob;
+    inJobs.ParallelFor(jobCount, [&](const uint32_t inJob, uint32_t)
+    {
+        std::vector<int16_t> column(4 * static_cast<size_t>(inSrcWidth));
+        const uint32_t end = std::min(inDstHeight, (inJob + 1) * UpscaleRowsPerJob);
+        for (uint32_t y = inJob * UpscaleRowsPerJob; y < end; ++y)
+        {
+            const SampleTap row = GetTap(y, inDstHeight, inSrcHeight);
+            const uint32_t* row0 = inSrc + static_cast<size_t>(row.first) * inSrcPitch;
+            const uint32_t* row1 = inSrcHeight >= 2 ? row0 + inSrcPitch : row0;
+            BlendRows(row0, row1, row.weight, inSrcWidth, column.data());
+            BlendColumns(column.data(), columns.data(), weights.data(), inDstWidth, secondOffset,
+                         outDst + static_cast<size_t>(y) * inDstPitch);
+        }
+#if !defined(RENDERER_SIMD_SCALAR)
+        _mm_sfence();
+#endif
+    });
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <new>
+
+#include "../Include/FrameArena.h"
+
+namespace
+{
+    size_t AlignUp(const size_t inValue, const size_t inAlignment)
+    {
+        return (inValue + inAlignment - 1) & ~(inAlignment - 1);
+    }
+}
+
+LinearArena::Block LinearArena::NewBlock(const size_t inBytes)
+{
+    return Block(static_cast<std::byte*>(::operator new[](inBytes, std::align_val_t{BlockAlignment})));
+}
+
+void* LinearArena::Allocate(const size_t inBytes, const size_t inAlignment)
+{
+    size_t start = AlignUp(offset, inAlignment);
+    if (current == nullptr || start + inBytes > currentCapacity)
+    {
+        // Spill; the next Reset folds this into the main block.
+        const size_t size = std::max({inBytes, currentCapacity, MinBlockBytes});
+        overflow.push_back(NewBlock(size));
+        current = overflow.back().get();
+        currentCapacity = size;
+        offset = 0;
+        start = 0;
+    }
+
+    used += start + inBytes - offset;
+    highWater = std::max(highWater, used);
+    offset = start + inBytes;
+    return current + start;
+}
+
+void LinearArena::Reset()
+{
+    // An eighth of headroom, so a frame a few bytes of padding larger doesn't spill again.
+    const size_t wanted = std::max(highWater + highWater / 8, reserved);
+    if (!overflow.empty() || wanted > capacity)
+    {
+        overflow.clear();
+        capacity = AlignUp(wanted, BlockAlignment);
+        block = capacity > 0 ? NewBlock(capacity) : nullptr;
+    }
+    current = block.get();
+    currentCapacity = capacity;
+    offset = 0;
+    used = 0;
+}
+
+void LinearArena::Reserve(const size_t inBytes)
+{
+    reserved = inBytes;
+    if (used == 0) Reset();
+}
+
+FrameArena::FrameArena(const uint32_t inThreadCount)
+    : threadCount(std::max(inThreadCount, 1u)), arenas(std::make_unique<LinearArena[]>(threadCount))
+{
+}
+
+void FrameArena::Reset()
+{
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        arenas[i].Reset();
+    }
+}
+
+void FrameArena::Reserve(const size_t inBytes, const size_t inBytesPerThread)
+{
+    arenas[0].Reserve(inBytes);
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        arenas[i].Reserve(inBytesPerThread);
+    }
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+    FrameArenaStats stats;
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        stats.usedBytes += arenas[i].GetUsedBytes();
+        stats.highWaterBytes += arenas[i].GetHighWaterBytes();
+        stats.capacityBytes += arenas[i].GetCapacity();
+    }
+    return stats;
+}
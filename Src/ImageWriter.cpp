@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "../Include/ImageWriter.h"
+
+namespace
+{
+    // Framebuffer pixels are 0xAABBGGRR, i.e. R, G, B, A in memory on little-endian.
+    uint8_t Channel(const uint32_t inPixel, const int inShift)
+    {
+        return static_cast<uint8_t>((inPixel >> inShift) & 0xFF);
+    }
+
+    uint32_t Crc32(const uint8_t* inData, const size_t inSize, uint32_t crc = 0)
+    {
+        static const std::array<uint32_t, 256> table = []
+        {
+            std::array<uint32_t, 256> result{};
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                result[n] = c;
+            }
+            return result;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < inSize; ++i)
+        {
+            crc = table[(crc ^ inData[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void PutBigEndian(std::vector<uint8_t>& outBytes, const uint32_t inValue)
+    {
+        outBytes.push_back(static_cast<uint8_t>(inValue >> 24));
+        outBytes.push_back(static_cast<uint8_t>(inValue >> 16));
+        outBytes.push_back(static_cast<uint8_t>(inValue >> 8));
+        outBytes.push_back(static_cast<uint8_t>(inValue));
+    }
+
+    // Length, type, data and CRC of the type + data.
+    void WriteChunk(std::ofstream& inFile, const char* inType, const std::vector<uint8_t>& inData)
+    {
+        std::vector<uint8_t> chunk;
+        chunk.reserve(inData.size() + 12);
+        PutBigEndian(chunk, static_cast<uint32_t>(inData.size()));
+        chunk.insert(chunk.end(), inType, inType + 4);
+        chunk.insert(chunk.end(), inData.begin(), inData.end());
+        PutBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+        inFile.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+bool WritePPM(const std::string& inPath, const uint32_t* inPixels, const uint32_t inWidth, const uint32_t inHeight)
+{
+    std::ofstream file(inPath, std::ios::binary);
+    if (!file) return false;
+
+    file << "P6\n" << inWidth << " " << inHeight << "\n255\n";
+
+    std::vector<uint8_t> row(static_cast<size_t>(inWidth) * 3);
+    for (uint32_t y = 0; y < inHeight; ++y)
+    {
+        const uint32_t* src = inPixels + static_cast<size_t>(y) * inWidth;
+        for (uint32_t x = 0; x < inWidth; ++x)
+        {
+            row[x * 3 + 0] = Channel(src[x], 0);
+            row[x * 3 + 1] = Channel(src[x], 8);
+            row[x * 3 + 2] = Channel(src[x], 16);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+bool WritePNG(const std::string& inPath, const uint32_t* inPixels, const uint32_t inWidth, const uint32_t inHeight)
+{
+    std::ofstream file(inPath, std::ios::binary);
+    if (!file) return false;
+
+    static constexpr uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    // IHDR: 8-bit RGBA, no interlacing.
+    std::vector<uint8_t> header;
+    PutBigEndian(header, inWidth);
+    PutBigEndian(header, inHeight);
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    WriteChunk(file, "IHDR", header);
+
+    // Scanlines, each prefixed with filter type 0.
+    const size_t rowBytes = static_cast<size_t>(inWidth) * 4 + 1;
+    std::vector<uint8_t> raw(rowBytes * inHeight);
+    for (uint32_t y = 0; y < inHeight; ++y)
+    {
+        uint8_t* dst = raw.data() + y * rowBytes;
+        *dst++ = 0;
+        const uint32_t* src = inPixels + static_cast<size_t>(y) * inWidth;
+        for (uint32_t x = 0; x < inWidth; ++x)
+        {
+            *dst++ = Channel(src[x], 0);
+            *dst++ = Channel(src[x], 8);
+            *dst++ = Channel(src[x], 16);
+            *dst++ = Channel(src[x], 24);
+        }
+    }
+
+    // zlib stream made of stored deflate blocks (at most 65535 bytes each) + Adler-32.
+    std::vector<uint8_t> zlib{0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    size_t offset = 0;
+    do
+    {
+        const auto length = static_cast<uint16_t>(std::min<size_t>(65535, raw.size() - offset));
+        const bool bFinal = offset + length == raw.size();
+        zlib.push_back(bFinal ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(length));
+        zlib.push_back(static_cast<uint8_t>(length >> 8));
+        zlib.push_back(static_cast<uint8_t>(~length));
+        zlib.push_back(static_cast<uint8_t>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + static_cast<ptrdiff_t>(offset),
+                    raw.begin() + static_cast<ptrdiff_t>(offset + length));
+        offset += length;
+    } while (offset < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (const uint8_t byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutBigEndian(zlib, (b << 16) | a);
+    WriteChunk(file, "IDAT", zlib);
+
+    WriteChunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
+
+bool WriteImage(const std::string& inPath, const uint32_t* inPixels, const uint32_t inWidth, const uint32_t inHeight)
+{
+    std::string extension = std::filesystem::path(inPath).extension().string();
+    std::ranges::transform(extension, extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+    if (extension == ".png")
+    {
+        return WritePNG(inPath, inPixels, inWidth, inHeight);
+    }
+    return WritePPM(inPath, inPixels, inWidth, inHeight);
+}
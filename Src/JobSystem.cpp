@@ -0,0 +1,107 @@
+#include "../Include/JobSystem.h"
+#include "../Include/Profiler.h"
+
+#include <algorithm>
+#include <string>
+
+JobSystem::JobSystem(uint32_t inThreadCount)
+{
+    if (inThreadCount == 0)
+    {
+        inThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers.reserve(inThreadCount - 1);
+    for (uint32_t i = 1; i < inThreadCount; ++i)
+    {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(mutex);
+        bStopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::ParallelFor(const uint32_t count, const JobFunc& func)
+{
+    if (count == 0) return;
+
+    // Nothing to share: skip the queue entirely.
+    if (workers.empty() || count == 1)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            func(i, 0);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->func = &func;
+    job->count = count;
+    job->remaining = count;
+
+    {
+        std::lock_guard lock(mutex);
+        queue.push_back(job);
+    }
+    wakeCondition.notify_all();
+
+    Execute(*job, 0);
+
+    std::unique_lock lock(mutex);
+    doneCondition.wait(lock, [&] { return job->remaining.load() == 0; });
+    std::erase(queue, job);
+}
+
+void JobSystem::WorkerLoop(const uint32_t threadIndex)
+{
+    Profiler::SetThreadName("Worker " + std::to_string(threadIndex));
+
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock lock(mutex);
+            wakeCondition.wait(lock, [&] { return bStopping || !queue.empty(); });
+            if (queue.empty()) return;
+
+            job = queue.front();
+            if (job->next.load() >= job->count)
+            {
+                // Every index is already claimed; let the owner finish it.
+                queue.pop_front();
+                continue;
+            }
+        }
+
+        Execute(*job, threadIndex);
+    }
+}
+
+void JobSystem::Execute(Job& job, const uint32_t threadIndex)
+{
+    uint32_t index;
+    while ((index = job.next.fetch_add(1)) < job.count)
+    {
+        (*job.func)(index, threadIndex);
+
+        if (job.remaining.fetch_sub(1) == 1)
+        {
+            {
+                std::lock_guard lock(mutex);
+            }
+            doneCondition.notify_all();
+        }
+    }
+}
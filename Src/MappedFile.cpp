@@ -0,0 +1,104 @@
+#include "../Include/MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& inPath)
+{
+    Close();
+
+    HANDLE file = CreateFileA(inPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data) UnmapViewOfFile(data);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& inPath)
+{
+    Close();
+
+    const int fd = open(inPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (view == MAP_FAILED) return false;
+
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+
+    data = nullptr;
+    size = 0;
+}
+
+#endif
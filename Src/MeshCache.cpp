@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <type_traits>
+
+#include <spdlog/spdlog.h>
+
+#include "../Include/MeshCache.h"
+#include "../Include/MappedFile.h"
+
+namespace
+{
+    constexpr uint32_t CacheMagic = 0x48534D52; // "RMSH"
+    constexpr uint32_t CacheVersion = 5;
+    constexpr uint64_t SectionAlignment = 64;
+    static_assert(std::is_trivially_copyable_v<Meshlet>, "Meshlets are stored as raw bytes.");
+
+    enum CacheSection : uint32_t
+    {
+        PositionX, PositionY, PositionZ,
+        NormalX, NormalY, NormalZ,
+        TexcoordU, TexcoordV,
+        Indices,
+        Meshlets, MeshletVertices, MeshletTriangles,
+        SectionCount
+    };
+
+    struct CacheSectionEntry
+    {
+        uint64_t offset;
+        uint64_t byteSize;
+    };
+
+    // Vertex streams and indices of one LOD.
+    struct CacheLevel
+    {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t meshletCount;
+        uint32_t meshletVertexCount;
+        uint32_t meshletTriangleCount;
+        float error;
+        CacheSectionEntry sections[SectionCount];
+    };
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+
+        // Source stamp.
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+
+        float boundsMin[3];
+        float boundsMax[3];
+
+        // Level 0 is the full-detail mesh.
+        uint32_t levelCount;
+        CacheLevel levels[MaxMeshLods + 1];
+    };
+
+    struct SourceStamp
+    {
+        uint64_t size{0};
+        int64_t time{0};
+    };
+
+    bool GetSourceStamp(const std::string& inPath, SourceStamp& outStamp)
+    {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(inPath, error);
+        if (error) return false;
+        const auto time = std::filesystem::last_write_time(inPath, error);
+        if (error) return false;
+
+        outStamp.size = size;
+        outStamp.time = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    // FNV-1a over the whole source file.
+    bool HashSource(const std::string& inPath, uint64_t& outHash)
+    {
+        MappedFile source;
+        if (!source.Open(inPath)) return false;
+
+        uint64_t hash = 14695981039346656037ull;
+        const uint8_t* bytes = source.GetData();
+        for (size_t i = 0; i < source.GetSize(); ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        outHash = hash;
+        return true;
+    }
+
+    template<typename T>
+    bool MapSection(const CacheLevel& inLevel, CacheSection inSection, size_t inExpectedCount,
+                    const std::shared_ptr<MappedFile>& inFile, MeshBuffer<T>& outBuffer)
+    {
+        const CacheSectionEntry& entry = inLevel.sections[inSection];
+        if (entry.offset % alignof(T) != 0 || entry.byteSize != inExpectedCount * sizeof(T)) return false;
+        if (entry.offset > inFile->GetSize() || entry.byteSize > inFile->GetSize() - entry.offset) return false;
+
+        const auto* data = reinterpret_cast<const T*>(inFile->GetData() + entry.offset);
+        outBuffer = MeshBuffer<T>::View(data, inExpectedCount, inFile);
+        return true;
+    }
+
+    // Every index the vertex and raster stages will follow stays inside its buffer.
+    bool ValidateLevel(const size_t inVertexCount, const MeshBuffer<uint32_t>& inIndices,
+                       const MeshletBuffers& inClusters)
+    {
+        for (const uint32_t index : inIndices)
+        {
+            if (index >= inVertexCount) return false;
+        }
+        for (const uint32_t vertex : inClusters.vertices)
+        {
+            if (vertex >= inVertexCount) return false;
+        }
+
+        const uint64_t triangleCount = inClusters.triangles.size() / 3;
+        for (const Meshlet& meshlet : inClusters.meshlets)
+        {
+            if (static_cast<uint64_t>(meshlet.vertexOffset) + meshlet.vertexCount > inClusters.vertices.size() ||
+                static_cast<uint64_t>(meshlet.triangleOffset) + meshlet.triangleCount > triangleCount)
+            {
+                return false;
+            }
+            const uint8_t* local = inClusters.triangles.data() + static_cast<size_t>(meshlet.triangleOffset) * 3;
+            for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i)
+            {
+                if (local[i] >= meshlet.vertexCount) return false;
+            }
+        }
+        return true;
+    }
+
+    bool MapLevel(const CacheLevel& inLevel, const std::shared_ptr<MappedFile>& inFile,
+                  VertexStreams& outVertices, MeshBuffer<uint32_t>& outIndices, MeshletBuffers& outClusters)
+    {
+        const size_t vertexCount = inLevel.vertexCount;
+        return inLevel.indexCount % 3 == 0 &&
+               MapSection(inLevel, PositionX, vertexCount, inFile, outVertices.positionX) &&
+               MapSection(inLevel, PositionY, vertexCount, inFile, outVertices.positionY) &&
+               MapSection(inLevel, PositionZ, vertexCount, inFile, outVertices.positionZ) &&
+               MapSection(inLevel, NormalX, vertexCount, inFile, outVertices.normalX) &&
+               MapSection(inLevel, NormalY, vertexCount, inFile, outVertices.normalY) &&
+               MapSection(inLevel, NormalZ, vertexCount, inFile, outVertices.normalZ) &&
+               MapSection(inLevel, TexcoordU, vertexCount, inFile, outVertices.texcoordU) &&
+               MapSection(inLevel, TexcoordV, vertexCount, inFile, outVertices.texcoordV) &&
+               MapSection(inLevel, Indices, inLevel.indexCount, inFile, outIndices) &&
+               MapSection(inLevel, Meshlets, inLevel.meshletCount, inFile, outClusters.meshlets) &&
+               MapSection(inLevel, MeshletVertices, inLevel.meshletVertexCount, inFile, outClusters.vertices) &&
+               MapSection(inLevel, MeshletTriangles, static_cast<size_t>(inLevel.meshletTriangleCount) * 3, inFile,
+                          outClusters.triangles) &&
+               ValidateLevel(vertexCount, outIndices, outClusters);
+    }
+
+    // Record the new mtime of a source whose content still matches, so later loads take the
+    // cheap stamp check again. Best effort: a cache that cannot be written is still valid.
+    void RestampCache(const std::string& inCachePath, const int64_t inSourceTime)
+    {
+        std::fstream file(inCachePath, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file) return;
+        file.seekp(static_cast<std::streamoff>(offsetof(CacheHeader, sourceTime)));
+        file.write(reinterpret_cast<const char*>(&inSourceTime), sizeof(inSourceTime));
+    }
+}
+
+std::string GetMeshCachePath(const std::string& inSourcePath)
+{
+    return inSourcePath + ".rmesh";
+}
+
+bool LoadMeshCache(const std::string& inSourcePath, Mesh& outMesh)
+{
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(GetMeshCachePath(inSourcePath))) return false;
+
+    CacheHeader header{};
+    if (file->GetSize() < sizeof(header)) return false;
+    std::memcpy(&header, file->GetData(), sizeof(header));
+    if (header.magic != CacheMagic || header.version != CacheVersion) return false;
+
+    // Cheap stamp first; only hash the source when size or mtime moved.
+    // A cache baked offline and shipped without its source is always accepted.
+    SourceStamp stamp;
+    bool bRestamp = false;
+    if (GetSourceStamp(inSourcePath, stamp))
+    {
+        if (stamp.size != header.sourceSize || stamp.time != header.sourceTime)
+        {
+            uint64_t hash = 0;
+            if (stamp.size != header.sourceSize || !HashSource(inSourcePath, hash) || hash != header.sourceHash)
+            {
+                spdlog::info("Mesh cache for {} is stale.", inSourcePath);
+                return false;
+            }
+            // Only touched (checkout, copy): same content under a new mtime.
+            bRestamp = true;
+        }
+    }
+
+    Mesh mesh;
+    bool bMapped = header.levelCount >= 1 && header.levelCount <= MaxMeshLods + 1 &&
+                   MapLevel(header.levels[0], file, mesh.vertices, mesh.indices, mesh.clusters);
+    if (bMapped) mesh.lods.resize(header.levelCount - 1);
+    for (uint32_t level = 1; bMapped && level < header.levelCount; ++level)
+    {
+        MeshLod& lod = mesh.lods[level - 1];
+        lod.error = header.levels[level].error;
+        bMapped = MapLevel(header.levels[level], file, lod.vertices, lod.indices, lod.clusters);
+    }
+    if (!bMapped)
+    {
+        spdlog::warn("Mesh cache for {} is corrupt.", inSourcePath);
+        return false;
+    }
+
+    mesh.bounds.min = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+    mesh.bounds.max = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+    if (bRestamp) RestampCache(GetMeshCachePath(inSourcePath), stamp.time);
+
+    outMesh = std::move(mesh);
+    return true;
+}
+
+bool SaveMeshCache(const std::string& inSourcePath, const Mesh& inMesh)
+{
+    SourceStamp stamp;
+    CacheHeader header{};
+    if (!GetSourceStamp(inSourcePath, stamp) || !HashSource(inSourcePath, header.sourceHash)) return false;
+
+    header.magic = CacheMagic;
+    header.version = CacheVersion;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.boundsMin[0] = inMesh.bounds.min.x;
+    header.boundsMin[1] = inMesh.bounds.min.y;
+    header.boundsMin[2] = inMesh.bounds.min.z;
+    header.boundsMax[0] = inMesh.bounds.max.x;
+    header.boundsMax[1] = inMesh.bounds.max.y;
+    header.boundsMax[2] = inMesh.bounds.max.z;
+
+    struct SectionSource
+    {
+        const void* data;
+        uint64_t byteSize;
+    };
+    const auto floatSection = [](const MeshBuffer<float>& inBuffer)
+    {
+        return SectionSource{inBuffer.data(), inBuffer.size() * sizeof(float)};
+    };
+
+    header.levelCount = std::min(inMesh.GetLodCount(), MaxMeshLods + 1);
+    std::vector<SectionSource> sources;
+    uint64_t offset = sizeof(CacheHeader);
+    for (uint32_t level = 0; level < header.levelCount; ++level)
+    {
+        const VertexStreams& vertices = inMesh.GetVertices(level);
+        const MeshBuffer<uint32_t>& indices = inMesh.GetIndices(level);
+        const MeshletBuffers& clusters = inMesh.GetClusters(level);
+        CacheLevel& cacheLevel = header.levels[level];
+        cacheLevel.vertexCount = static_cast<uint32_t>(vertices.Size());
+        cacheLevel.indexCount = static_cast<uint32_t>(indices.size());
+        cacheLevel.meshletCount = static_cast<uint32_t>(clusters.meshlets.size());
+        cacheLevel.meshletVertexCount = static_cast<uint32_t>(clusters.vertices.size());
+        cacheLevel.meshletTriangleCount = static_cast<uint32_t>(clusters.triangles.size() / 3);
+        cacheLevel.error = level == 0 ? 0.0f : inMesh.lods[level - 1].error;
+
+        const SectionSource levelSources[SectionCount] = {
+            floatSection(vertices.positionX),
+            floatSection(vertices.positionY),
+            floatSection(vertices.positionZ),
+            floatSection(vertices.normalX),
+            floatSection(vertices.normalY),
+            floatSection(vertices.normalZ),
+            floatSection(vertices.texcoordU),
+            floatSection(vertices.texcoordV),
+            {indices.data(), indices.size() * sizeof(uint32_t)},
+            {clusters.meshlets.data(), clusters.meshlets.size() * sizeof(Meshlet)},
+            {clusters.vertices.data(), clusters.vertices.size() * sizeof(uint32_t)},
+            {clusters.triangles.data(), clusters.triangles.size()},
+        };
+        for (uint32_t i = 0; i < SectionCount; ++i)
+        {
+            offset = (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+            cacheLevel.sections[i] = {offset, levelSources[i].byteSize};
+            offset += levelSources[i].byteSize;
+            sources.push_back(levelSources[i]);
+        }
+    }
+
+    const std::string cachePath = GetMeshCachePath(inSourcePath);
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        static constexpr char padding[SectionAlignment] = {};
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            const CacheSectionEntry& entry = header.levels[i / SectionCount].sections[i % SectionCount];
+            out.write(padding, static_cast<std::streamsize>(entry.offset - static_cast<uint64_t>(out.tellp())));
+            out.write(static_cast<const char*>(sources[i].data), static_cast<std::streamsize>(sources[i].byteSize));
+        }
+        if (!out) return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error)
+    {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "../Include/MeshOptimizer.h"
+
+namespace
+{
+    // Forsyth's scoring constants (Linear-Speed Vertex Cache Optimisation).
+    constexpr uint32_t ForsythCacheSize = 32;
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriangleScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+
+    // Overdraw clusters are cut no smaller than a full meshlet, so meshlets built from the
+    // final order still cover compact patches.
+    constexpr uint32_t MinClusterTriangles = MaxMeshletTriangles;
+
+    // Long side of the overdraw views in pixels.
+    constexpr uint32_t OverdrawGridSize = 256;
+
+    constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+    Math::Vector3 GetPosition(const VertexStreams& inVertices, const uint32_t inIndex)
+    {
+        return {inVertices.positionX[inIndex], inVertices.positionY[inIndex], inVertices.positionZ[inIndex]};
+    }
+
+    // Position id per vertex; outCount ids in total.
+    std::vector<uint32_t> WeldPositions(const VertexStreams& inVertices, uint32_t& outCount)
+    {
+        const size_t vertexCount = inVertices.Size();
+        std::vector<uint32_t> positionIds(vertexCount);
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> weldMap;
+        weldMap.reserve(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            const auto [it, bInserted] = weldMap.try_emplace(PositionKey{GetPosition(inVertices, static_cast<uint32_t>(i))},
+                                                             static_cast<uint32_t>(weldMap.size()));
+            positionIds[i] = it->second;
+        }
+        outCount = static_cast<uint32_t>(weldMap.size());
+        return positionIds;
+    }
+
+    // FIFO post-transform cache over timestamps; Reset is O(1).
+    class FifoCache
+    {
+    public:
+        FifoCache(const size_t inKeyCount, const uint32_t inSize)
+            : stamps(inKeyCount, 0), time(inSize + 1), size(inSize)
+        {
+        }
+
+        void Reset() { time += size + 1; }
+
+        // Misses of one triangle.
+        uint32_t Touch(const uint32_t* inTriangle)
+        {
+            uint32_t misses = 0;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                if (time - stamps[inTriangle[i]] > size)
+                {
+                    stamps[inTriangle[i]] = time++;
+                    ++misses;
+                }
+            }
+            return misses;
+        }
+
+    private:
+        std::vector<uint32_t> stamps;
+        uint32_t time;
+        uint32_t size;
+    };
+
+    float ComputeAcmr(const uint32_t* inCorners, const size_t inTriangleCount, const size_t inKeyCount)
+    {
+        if (inTriangleCount == 0) return 0.0f;
+        FifoCache cache(inKeyCount, AnalysisCacheSize);
+        uint64_t misses = 0;
+        for (size_t t = 0; t < inTriangleCount; ++t)
+        {
+            misses += cache.Touch(inCorners + 3 * t);
+        }
+        return static_cast<float>(misses) / static_cast<float>(inTriangleCount);
+    }
+
+    float VertexScore(const int32_t inCachePosition, const uint32_t inLiveTriangles)
+    {
+        if (inLiveTriangles == 0) return -1.0f;
+
+        float score = 0.0f;
+        if (inCachePosition >= 0)
+        {
+            // The last triangle's vertices score a fixed amount so the next one isn't always
+            // its direct neighbour; the rest decay with age.
+            score = inCachePosition < 3
+                        ? LastTriangleScore
+                        : std::pow(1.0f - static_cast<float>(inCachePosition - 3) / (ForsythCacheSize - 3),
+                                   CacheDecayPower);
+        }
+        // Vertices with few triangles left are worth finishing off.
+        return score + ValenceBoostScale * std::pow(static_cast<float>(inLiveTriangles), -ValenceBoostPower);
+    }
+
+    // Greedy Forsyth order: always emit the best-scoring triangle touching the simulated LRU
+    // cache; at dead ends continue with the next unemitted triangle in input order.
+    std::vector<uint32_t> OrderForCache(const std::vector<uint32_t>& inCorners, const uint32_t inKeyCount)
+    {
+        const auto triangleCount = static_cast<uint32_t>(inCorners.size() / 3);
+        const auto distinct = [&](const uint32_t inTriangle, const uint32_t inCorner)
+        {
+            const uint32_t* corners = &inCorners[3 * inTriangle];
+            return inCorner == 0 || (corners[inCorner] != corners[0] && (inCorner == 1 || corners[2] != corners[1]));
+        };
+
+        // Triangles per key, as ranges of one array; the live ones come first.
+        std::vector<uint32_t> liveTriangles(inKeyCount, 0);
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                if (distinct(t, c)) ++liveTriangles[inCorners[3 * t + c]];
+            }
+        }
+        std::vector<uint32_t> adjacencyStart(inKeyCount + 1, 0);
+        std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyStart.begin() + 1);
+        std::vector<uint32_t> adjacency(adjacencyStart.back());
+        {
+            std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (uint32_t t = 0; t < triangleCount; ++t)
+            {
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    if (distinct(t, c)) adjacency[fill[inCorners[3 * t + c]]++] = t;
+                }
+            }
+        }
+
+        std::vector<int32_t> cachePosition(inKeyCount, -1);
+        std::vector<float> vertexScores(inKeyCount);
+        for (uint32_t k = 0; k < inKeyCount; ++k)
+        {
+            vertexScores[k] = VertexScore(-1, liveTriangles[k]);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            const uint32_t* corners = &inCorners[3 * t];
+            triangleScores[t] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+        }
+
+        std::vector<uint8_t> bEmitted(triangleCount, 0);
+        std::vector<uint32_t> order;
+        order.reserve(triangleCount);
+
+        std::array<uint32_t, ForsythCacheSize + 3> cache{};
+        std::array<uint32_t, ForsythCacheSize + 3> nextCache{};
+        uint32_t cacheCount = 0;
+        uint32_t cursor = 0;
+        uint32_t best = InvalidIndex;
+
+        while (order.size() < triangleCount)
+        {
+            if (best == InvalidIndex)
+            {
+                while (bEmitted[cursor]) ++cursor;
+                best = cursor;
+            }
+
+            bEmitted[best] = 1;
+            order.push_back(best);
+
+            // The triangle's keys move to the front of the cache, and it leaves their lists.
+            uint32_t nextCount = 0;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                if (!distinct(best, c)) continue;
+                const uint32_t key = inCorners[3 * best + c];
+                nextCache[nextCount++] = key;
+
+                uint32_t* first = &adjacency[adjacencyStart[key]];
+                uint32_t* last = first + liveTriangles[key];
+                std::iter_swap(std::find(first, last, best), last - 1);
+                --liveTriangles[key];
+            }
+            for (uint32_t i = 0; i < cacheCount; ++i)
+            {
+                const uint32_t key = cache[i];
+                if (std::find(nextCache.begin(), nextCache.begin() + nextCount, key) == nextCache.begin() + nextCount)
+                {
+                    nextCache[nextCount++] = key;
+                }
+            }
+
+            // Rescore the keys that were or are cached, then their live triangles.
+            for (uint32_t i = 0; i < nextCount; ++i)
+            {
+                const uint32_t key = nextCache[i];
+                cachePosition[key] = i < ForsythCacheSize ? static_cast<int32_t>(i) : -1;
+                vertexScores[key] = VertexScore(cachePosition[key], liveTriangles[key]);
+            }
+            best = InvalidIndex;
+            float bestScore = -std::numeric_limits<float>::infinity();
+            for (uint32_t i = 0; i < nextCount; ++i)
+            {
+                const uint32_t key = nextCache[i];
+                for (uint32_t a = 0; a < liveTriangles[key]; ++a)
+                {
+                    const uint32_t t = adjacency[adjacencyStart[key] + a];
+                    const uint32_t* corners = &inCorners[3 * t];
+                    triangleScores[t] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+                    if (triangleScores[t] > bestScore)
+                    {
+                        bestScore = triangleScores[t];
+                        best = t;
+                    }
+                }
+            }
+
+            cacheCount = std::min(nextCount, ForsythCacheSize);
+            std::copy_n(nextCache.begin(), cacheCount, cache.begin());
+        }
+        return order;
+    }
+
+    // Split the (cache-ordered) triangles into clusters that can be drawn in any order without
+    // losing much vertex reuse (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+    // Locality and Reduced Overdraw"). Returns the first triangle of every cluster.
+    std::vector<uint32_t> BuildOverdrawClusters(const std::vector<uint32_t>& inCorners, const uint32_t inKeyCount,
+                                                const float inThreshold)
+    {
+        const auto triangleCount = static_cast<uint32_t>(inCorners.size() / 3);
+        FifoCache cache(inKeyCount, AnalysisCacheSize);
+
+        // Hard boundaries where a triangle misses on all three corners: a new patch starts.
+        std::vector<uint32_t> hard;
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            if (cache.Touch(&inCorners[3 * t]) == 3 || t == 0) hard.push_back(t);
+        }
+
+        // Soft boundaries inside each patch, as soon as the running ACMR gets within the
+        // threshold of the patch's own.
+        std::vector<uint32_t> clusters;
+        for (size_t h = 0; h < hard.size(); ++h)
+        {
+            const uint32_t begin = hard[h];
+            const uint32_t end = h + 1 < hard.size() ? hard[h + 1] : triangleCount;
+
+            cache.Reset();
+            uint32_t patchMisses = 0;
+            for (uint32_t t = begin; t < end; ++t) patchMisses += cache.Touch(&inCorners[3 * t]);
+            const float target = inThreshold * static_cast<float>(patchMisses) / static_cast<float>(end - begin);
+
+            clusters.push_back(begin);
+            cache.Reset();
+            uint32_t misses = 0;
+            uint32_t count = 0;
+            for (uint32_t t = begin; t < end; ++t)
+            {
+                misses += cache.Touch(&inCorners[3 * t]);
+                if (++count >= MinClusterTriangles && static_cast<float>(misses) <= target * static_cast<float>(count))
+                {
+                    clusters.push_back(t + 1);
+                    cache.Reset();
+                    misses = 0;
+                    count = 0;
+                }
+            }
+            // The trailing cluster is whatever was left over and usually poor: merge it into
+            // the one before (this also drops a boundary at end).
+            if (clusters.back() != begin) clusters.pop_back();
+        }
+        return clusters;
+    }
+
+    // Reorder inOutTriangles (a permutation of triangles) cluster by cluster so clusters
+    // facing out from the mesh center come first; they tend to occlude the others.
+    void SortClusters(const VertexStreams& inVertices, const MeshBuffer<uint32_t>& inIndices,
+                      const std::vector<uint32_t>& inClusters, std::vector<uint32_t>& inOutTriangles)
+    {
+        const size_t triangleCount = inOutTriangles.size();
+
+        Math::Vector3 meshCenter{};
+        for (const uint32_t index : inIndices) meshCenter = meshCenter + GetPosition(inVertices, index);
+        meshCenter = meshCenter * (1.0f / static_cast<float>(std::max<size_t>(inIndices.size(), 1)));
+
+        std::vector<float> keys(inClusters.size());
+        for (size_t c = 0; c < inClusters.size(); ++c)
+        {
+            const uint32_t end = c + 1 < inClusters.size() ? inClusters[c + 1] : static_cast<uint32_t>(triangleCount);
+
+            // Area-weighted centroid and normal; cross(p1 - p0, p2 - p0) points out of
+            // clockwise front faces.
+            Math::Vector3 centroid{};
+            Math::Vector3 normal{};
+            float area = 0.0f;
+            for (uint32_t i = inClusters[c]; i < end; ++i)
+            {
+                const uint32_t t = inOutTriangles[i];
+                const Math::Vector3 p0 = GetPosition(inVertices, inIndices[3 * t + 0]);
+                const Math::Vector3 p1 = GetPosition(inVertices, inIndices[3 * t + 1]);
+                const Math::Vector3 p2 = GetPosition(inVertices, inIndices[3 * t + 2]);
+                const Math::Vector3 n = Math::Vector3::Cross(p1 - p0, p2 - p0);
+                const float a = n.Length();
+                centroid = centroid + (p0 + p1 + p2) * (a / 3.0f);
+                normal = normal + n;
+                area += a;
+            }
+            if (area > 0.0f) centroid = centroid * (1.0f / area);
+            const float length = normal.Length();
+            keys[c] = length > 0.0f ? Math::Vector3::Dot(centroid - meshCenter, normal) / length : 0.0f;
+        }
+
+        std::vector<uint32_t> clusterOrder(inClusters.size());
+        std::iota(clusterOrder.begin(), clusterOrder.end(), 0u);
+        std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+                         [&](const uint32_t inA, const uint32_t inB) { return keys[inA] > keys[inB]; });
+
+        std::vector<uint32_t> sorted;
+        sorted.reserve(triangleCount);
+        for (const uint32_t c : clusterOrder)
+        {
+            const uint32_t end = c + 1 < inClusters.size() ? inClusters[c + 1] : static_cast<uint32_t>(triangleCount);
+            sorted.insert(sorted.end(), inOutTriangles.begin() + inClusters[c], inOutTriangles.begin() + end);
+        }
+        inOutTriangles = std::move(sorted);
+    }
+
+    // Renumber vertices in order of first use and drop the unused ones.
+    void OptimizeVertexFetch(VertexStreams& inOutVertices, MeshBuffer<uint32_t>& inOutIndices)
+    {
+        std::vector<uint32_t> remap(inOutVertices.Size(), InvalidIndex);
+        uint32_t vertexCount = 0;
+        uint32_t* indices = inOutIndices.MutableData();
+        for (size_t i = 0; i < inOutIndices.size(); ++i)
+        {
+            uint32_t& target = remap[indices[i]];
+            if (target == InvalidIndex) target = vertexCount++;
+            indices[i] = target;
+        }
+
+        const auto permute = [&](MeshBuffer<float>& inOutStream)
+        {
+            std::vector<float> values(vertexCount);
+            for (size_t v = 0; v < remap.size(); ++v)
+            {
+                if (remap[v] != InvalidIndex) values[remap[v]] = inOutStream[v];
+            }
+            inOutStream = MeshBuffer<float>(std::move(values));
+        };
+        permute(inOutVertices.positionX);
+        permute(inOutVertices.positionY);
+        permute(inOutVertices.positionZ);
+        permute(inOutVertices.normalX);
+        permute(inOutVertices.normalY);
+        permute(inOutVertices.normalZ);
+        permute(inOutVertices.texcoordU);
+        permute(inOutVertices.texcoordV);
+    }
+
+    // Depth-tested orthographic rasterization of the front faces from both ends of each axis.
+    float EstimateOverdraw(const VertexStreams& inVertices, const MeshBuffer<uint32_t>& inIndices)
+    {
+        const Bounds bounds = ComputeBounds(inVertices);
+        const Math::Vector3 size = bounds.max - bounds.min;
+        const float extent = std::max({size.x, size.y, size.z});
+        if (extent <= 0.0f) return 0.0f;
+
+        const float scale = static_cast<float>(OverdrawGridSize - 1) / extent;
+        std::vector<float> depth(OverdrawGridSize * OverdrawGridSize);
+        uint64_t covered = 0;
+        uint64_t shaded = 0;
+
+        const auto component = [](const Math::Vector3& inV, const uint32_t inAxis)
+        {
+            return inAxis == 0 ? inV.x : inAxis == 1 ? inV.y : inV.z;
+        };
+        const auto edge = [](const float ax, const float ay, const float bx, const float by, const float px,
+                             const float py)
+        {
+            return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+        };
+
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            const uint32_t axisU = (axis + 1) % 3;
+            const uint32_t axisV = (axis + 2) % 3;
+            for (const float direction : {1.0f, -1.0f})
+            {
+                std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+
+                for (size_t i = 0; i + 2 < inIndices.size(); i += 3)
+                {
+                    const Math::Vector3 p[3] = {
+                        GetPosition(inVertices, inIndices[i]), GetPosition(inVertices, inIndices[i + 1]),
+                        GetPosition(inVertices, inIndices[i + 2])
+                    };
+                    // The viewer sits at +direction along the axis.
+                    if (component(Math::Vector3::Cross(p[1] - p[0], p[2] - p[0]), axis) * direction <= 0.0f) continue;
+
+                    float x[3], y[3], z[3];
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        x[c] = (component(p[c], axisU) - component(bounds.min, axisU)) * scale;
+                        y[c] = (component(p[c], axisV) - component(bounds.min, axisV)) * scale;
+                        z[c] = -direction * component(p[c], axis);
+                    }
+                    const float area = edge(x[0], y[0], x[1], y[1], x[2], y[2]);
+                    if (area == 0.0f) continue;
+
+                    const auto minX = static_cast<uint32_t>(std::max(0.0f, std::floor(std::min({x[0], x[1], x[2]}))));
+                    const auto minY = static_cast<uint32_t>(std::max(0.0f, std::floor(std::min({y[0], y[1], y[2]}))));
+                    const auto maxX = std::min(OverdrawGridSize - 1, static_cast<uint32_t>(std::max({x[0], x[1], x[2]})));
+                    const auto maxY = std::min(OverdrawGridSize - 1, static_cast<uint32_t>(std::max({y[0], y[1], y[2]})));
+                    for (uint32_t py = minY; py <= maxY; ++py)
+                    {
+                        for (uint32_t px = minX; px <= maxX; ++px)
+                        {
+                            const float cx = static_cast<float>(px) + 0.5f;
+                            const float cy = static_cast<float>(py) + 0.5f;
+                            const float w0 = edge(x[1], y[1], x[2], y[2], cx, cy) / area;
+                            const float w1 = edge(x[2], y[2], x[0], y[0], cx, cy) / area;
+                            const float w2 = edge(x[0], y[0], x[1], y[1], cx, cy) / area;
+                            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+                            const float fragmentDepth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+                            float& stored = depth[py * OverdrawGridSize + px];
+                            if (fragmentDepth < stored)
+                            {
+                                stored = fragmentDepth;
+                                ++shaded;
+                            }
+                        }
+                    }
+                }
+
+                covered += std::count_if(depth.begin(), depth.end(), [](const float inDepth) { return std::isfinite(inDepth); });
+            }
+        }
+        return covered == 0 ? 0.0f : static_cast<float>(shaded) / static_cast<float>(covered);
+    }
+}
+
+MeshOrderStats AnalyzeMeshOrder(const VertexStreams& inVertices, const MeshBuffer<uint32_t>& inIndices)
+{
+    const size_t triangleCount = inIndices.size() / 3;
+
+    uint32_t positionCount = 0;
+    const std::vector<uint32_t> positionIds = WeldPositions(inVertices, positionCount);
+    std::vector<uint32_t> positionCorners(triangleCount * 3);
+    for (size_t i = 0; i < positionCorners.size(); ++i) positionCorners[i] = positionIds[inIndices[i]];
+
+    MeshOrderStats stats;
+    stats.acmr = ComputeAcmr(inIndices.data(), triangleCount, inVertices.Size());
+    stats.positionAcmr = ComputeAcmr(positionCorners.data(), triangleCount, positionCount);
+    stats.overdraw = EstimateOverdraw(inVertices, inIndices);
+    return stats;
+}
+
+void OptimizeMeshOrder(VertexStreams& inOutVertices, MeshBuffer<uint32_t>& inOutIndices, const float inOverdrawThreshold)
+{
+    const size_t triangleCount = inOutIndices.size() / 3;
+    if (triangleCount == 0) return;
+
+    uint32_t positionCount = 0;
+    const std::vector<uint32_t> positionIds = WeldPositions(inOutVertices, positionCount);
+    std::vector<uint32_t> corners(triangleCount * 3);
+    for (size_t i = 0; i < corners.size(); ++i) corners[i] = positionIds[inOutIndices[i]];
+
+    std::vector<uint32_t> triangles = OrderForCache(corners, positionCount);
+
+    // Clusters are cut in cache order.
+    std::vector<uint32_t> orderedCorners(corners.size());
+    for (size_t i = 0; i < triangleCount; ++i)
+    {
+        std::copy_n(&corners[3 * triangles[i]], 3, &orderedCorners[3 * i]);
+    }
+    const std::vector<uint32_t> clusters = BuildOverdrawClusters(orderedCorners, positionCount, inOverdrawThreshold);
+    SortClusters(inOutVertices, inOutIndices, clusters, triangles);
+
+    std::vector<uint32_t> indices(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount; ++i)
+    {
+        std::copy_n(&inOutIndices[3 * triangles[i]], 3, &indices[3 * i]);
+    }
+    inOutIndices = MeshBuffer<uint32_t>(std::move(indices));
+
+    OptimizeVertexFetch(inOutVertices, inOutIndices);
+}
+
+void OptimizeMeshOrder(Mesh& inOutMesh, const float inOverdrawThreshold)
+{
+    OptimizeMeshOrder(inOutMesh.vertices, inOutMesh.indices, inOverdrawThreshold);
+    inOutMesh.clusters = {};
+    for (MeshLod& lod : inOutMesh.lods)
+    {
+        OptimizeMeshOrder(lod.vertices, lod.indices, inOverdrawThreshold);
+        lod.clusters = {};
+    }
+}
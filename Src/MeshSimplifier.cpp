@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+#include "../Include/MeshSimplifier.h"
+
+namespace
+{
+    // Open boundary edges are held in place by a plane through the edge, perpendicular to
+    // its face, weighted this much more than a face of the same size.
+    constexpr double BoundaryWeight = 10.0;
+    // A collapse may not turn any remaining face by more than acos(0.25) (~75 degrees).
+    constexpr float MinNormalCosine = 0.25f;
+
+    // Symmetric 4x4 plane quadric and the total weight (area) of its planes.
+    struct Quadric
+    {
+        double a00{0.0}, a01{0.0}, a02{0.0}, a03{0.0};
+        double a11{0.0}, a12{0.0}, a13{0.0};
+        double a22{0.0}, a23{0.0};
+        double a33{0.0};
+        double weight{0.0};
+
+        // Plane n . p + d = 0 with unit n.
+        void AddPlane(const Math::Vector3& n, const double d, const double w)
+        {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        Quadric& operator+=(const Quadric& inOther)
+        {
+            a00 += inOther.a00; a01 += inOther.a01; a02 += inOther.a02; a03 += inOther.a03;
+            a11 += inOther.a11; a12 += inOther.a12; a13 += inOther.a13;
+            a22 += inOther.a22; a23 += inOther.a23;
+            a33 += inOther.a33;
+            weight += inOther.weight;
+            return *this;
+        }
+
+        // Weighted mean squared distance from p to the planes.
+        double Error(const Math::Vector3& p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            const double e = a00 * x * x + a11 * y * y + a22 * z * z +
+                             2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                             2.0 * (a03 * x + a13 * y + a23 * z) + a33;
+            return weight > 0.0 ? std::max(0.0, e) / weight : 0.0;
+        }
+    };
+
+    // Move vertex from onto vertex to. Stale once either vertex changed after the push.
+    struct Collapse
+    {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+
+        bool operator>(const Collapse& inOther) const { return cost > inOther.cost; }
+    };
+
+    uint64_t EdgeKey(const uint32_t inA, const uint32_t inB)
+    {
+        return static_cast<uint64_t>(std::min(inA, inB)) << 32 | std::max(inA, inB);
+    }
+
+    // Progressive simplifier over the welded positions of a mesh. Reduce can be called with
+    // decreasing targets, Emit snapshots the current state as a LOD.
+    class Simplifier
+    {
+    public:
+        explicit Simplifier(const Mesh& inMesh);
+
+        // Collapse until at most inTargetTriangles remain; false when no valid collapse is left.
+        bool Reduce(uint32_t inTargetTriangles);
+        MeshLod Emit();
+
+        uint32_t GetTriangleCount() const { return aliveTriangles; }
+
+    private:
+        void PushEdge(uint32_t inA, uint32_t inB);
+        bool IsCollapseValid(uint32_t inFrom, uint32_t inTo) const;
+        void ApplyCollapse(const Collapse& inCollapse);
+
+    private:
+        const Mesh& mesh;
+
+        std::vector<Math::Vector3> positions;
+        // Original vertices at each position: wedges[wedgeStart[p], wedgeStart[p + 1]).
+        std::vector<uint32_t> wedgeStart;
+        std::vector<uint32_t> wedges;
+        // +1 when the mesh normals point along cross(p1 - p0, p2 - p0), -1 otherwise.
+        float orientation{1.0f};
+
+        std::vector<std::array<uint32_t, 3>> triangles;
+        std::vector<uint8_t> bAlive;
+        uint32_t aliveTriangles{0};
+
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<uint32_t>> vertexTriangles;
+        std::vector<uint32_t> versions;
+        std::vector<uint8_t> bRemoved;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+        double maxError{0.0};
+
+        // Scratch.
+        std::vector<uint32_t> neighbors;
+        std::vector<uint32_t> remap;
+    };
+
+    Simplifier::Simplifier(const Mesh& inMesh) : mesh(inMesh)
+    {
+        const VertexStreams& vertices = inMesh.vertices;
+        const size_t vertexCount = vertices.Size();
+
+        // Weld by position only.
+        std::vector<uint32_t> vertexPosition(vertexCount);
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> weldMap;
+        weldMap.reserve(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            const Math::Vector3 p{vertices.positionX[i], vertices.positionY[i], vertices.positionZ[i]};
+            const auto [it, bInserted] = weldMap.try_emplace(PositionKey{p}, static_cast<uint32_t>(positions.size()));
+            if (bInserted) positions.push_back(p);
+            vertexPosition[i] = it->second;
+        }
+
+        const auto positionCount = static_cast<uint32_t>(positions.size());
+        wedgeStart.assign(positionCount + 1, 0);
+        for (const uint32_t p : vertexPosition) ++wedgeStart[p + 1];
+        for (uint32_t p = 0; p < positionCount; ++p) wedgeStart[p + 1] += wedgeStart[p];
+        wedges.resize(vertexCount);
+        std::vector<uint32_t> fill(wedgeStart.begin(), wedgeStart.end() - 1);
+        for (uint32_t i = 0; i < vertexCount; ++i) wedges[fill[vertexPosition[i]]++] = i;
+
+        // Triangles over positions; ones that are already degenerate are dropped.
+        double winding = 0.0;
+        const MeshBuffer<uint32_t>& indices = inMesh.indices;
+        triangles.reserve(indices.size() / 3);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const std::array<uint32_t, 3> tri{vertexPosition[indices[i]], vertexPosition[indices[i + 1]],
+                                              vertexPosition[indices[i + 2]]};
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+            triangles.push_back(tri);
+
+            const Math::Vector3 n = Math::Vector3::Cross(positions[tri[1]] - positions[tri[0]],
+                                                         positions[tri[2]] - positions[tri[0]]);
+            for (int k = 0; k < 3; ++k)
+            {
+                const Vertex v = vertices.Get(indices[i + k]);
+                winding += Math::Vector3::Dot(n, v.normal);
+            }
+        }
+        orientation = winding < 0.0 ? -1.0f : 1.0f;
+        bAlive.assign(triangles.size(), 1);
+        aliveTriangles = static_cast<uint32_t>(triangles.size());
+
+        // Area-weighted face quadrics, and edge use counts to find open boundaries.
+        quadrics.resize(positionCount);
+        vertexTriangles.resize(positionCount);
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(triangles.size() * 3);
+        for (uint32_t t = 0; t < triangles.size(); ++t)
+        {
+            const auto& tri = triangles[t];
+            Math::Vector3 n = Math::Vector3::Cross(positions[tri[1]] - positions[tri[0]],
+                                                   positions[tri[2]] - positions[tri[0]]);
+            const float length = n.Length();
+            for (int k = 0; k < 3; ++k)
+            {
+                vertexTriangles[tri[k]].push_back(t);
+                ++edgeUses[EdgeKey(tri[k], tri[(k + 1) % 3])];
+            }
+            if (length == 0.0f) continue;
+
+            n = n * (1.0f / length);
+            const double d = -Math::Vector3::Dot(n, positions[tri[0]]);
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics[tri[k]].AddPlane(n, d, 0.5 * length);
+            }
+        }
+
+        for (const auto& tri : triangles)
+        {
+            Math::Vector3 n = Math::Vector3::Cross(positions[tri[1]] - positions[tri[0]],
+                                                   positions[tri[2]] - positions[tri[0]]);
+            for (int k = 0; k < 3; ++k)
+            {
+                const uint32_t a = tri[k];
+                const uint32_t b = tri[(k + 1) % 3];
+                if (edgeUses[EdgeKey(a, b)] != 1) continue;
+
+                const Math::Vector3 edge = positions[b] - positions[a];
+                Math::Vector3 side = Math::Vector3::Cross(edge, n);
+                const float length = side.Length();
+                if (length == 0.0f) continue;
+
+                side = side * (1.0f / length);
+                const double d = -Math::Vector3::Dot(side, positions[a]);
+                const double w = BoundaryWeight * Math::Vector3::Dot(edge, edge);
+                quadrics[a].AddPlane(side, d, w);
+                quadrics[b].AddPlane(side, d, w);
+            }
+        }
+
+        versions.assign(positionCount, 0);
+        bRemoved.assign(positionCount, 0);
+        for (const auto& [key, uses] : edgeUses)
+        {
+            PushEdge(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key));
+        }
+    }
+
+    void Simplifier::PushEdge(const uint32_t inA, const uint32_t inB)
+    {
+        Quadric q = quadrics[inA];
+        q += quadrics[inB];
+        queue.push({q.Error(positions[inB]), inA, inB, versions[inA], versions[inB]});
+        queue.push({q.Error(positions[inA]), inB, inA, versions[inB], versions[inA]});
+    }
+
+    bool Simplifier::IsCollapseValid(const uint32_t inFrom, const uint32_t inTo) const
+    {
+        for (const uint32_t t : vertexTriangles[inFrom])
+        {
+            if (!bAlive[t]) continue;
+            const auto& tri = triangles[t];
+            if (tri[0] == inTo || tri[1] == inTo || tri[2] == inTo) continue;
+
+            // Faces that survive must not flip or fold over.
+            Math::Vector3 p[3] = {positions[tri[0]], positions[tri[1]], positions[tri[2]]};
+            const Math::Vector3 before = Math::Vector3::Cross(p[1] - p[0], p[2] - p[0]);
+            for (int k = 0; k < 3; ++k)
+            {
+                if (tri[k] == inFrom) p[k] = positions[inTo];
+            }
+            const Math::Vector3 after = Math::Vector3::Cross(p[1] - p[0], p[2] - p[0]);
+            if (Math::Vector3::Dot(before, after) <= MinNormalCosine * before.Length() * after.Length()) return false;
+        }
+        return true;
+    }
+
+    void Simplifier::ApplyCollapse(const Collapse& inCollapse)
+    {
+        const uint32_t from = inCollapse.from;
+        const uint32_t to = inCollapse.to;
+        maxError = std::max(maxError, inCollapse.cost);
+
+        std::vector<uint32_t>& toTriangles = vertexTriangles[to];
+        for (const uint32_t t : vertexTriangles[from])
+        {
+            if (!bAlive[t]) continue;
+            auto& tri = triangles[t];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                bAlive[t] = 0;
+                --aliveTriangles;
+                continue;
+            }
+            for (uint32_t& v : tri)
+            {
+                if (v == from) v = to;
+            }
+            toTriangles.push_back(t);
+        }
+        vertexTriangles[from] = {};
+        std::erase_if(toTriangles, [&](const uint32_t t) { return !bAlive[t]; });
+
+        bRemoved[from] = 1;
+        quadrics[to] += quadrics[from];
+        ++versions[to];
+
+        // Every edge at to has a new cost now.
+        neighbors.clear();
+        for (const uint32_t t : toTriangles)
+        {
+            for (const uint32_t v : triangles[t])
+            {
+                if (v != to) neighbors.push_back(v);
+            }
+        }
+        std::ranges::sort(neighbors);
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (const uint32_t v : neighbors)
+        {
+            PushEdge(to, v);
+        }
+    }
+
+    bool Simplifier::Reduce(const uint32_t inTargetTriangles)
+    {
+        while (aliveTriangles > inTargetTriangles)
+        {
+            if (queue.empty()) return false;
+            const Collapse collapse = queue.top();
+            queue.pop();
+
+            if (bRemoved[collapse.from] || bRemoved[collapse.to] || versions[collapse.from] != collapse.fromVersion ||
+                versions[collapse.to] != collapse.toVersion) continue;
+            if (!IsCollapseValid(collapse.from, collapse.to)) continue;
+
+            ApplyCollapse(collapse);
+        }
+        return true;
+    }
+
+    MeshLod Simplifier::Emit()
+    {
+        const VertexStreams& vertices = mesh.vertices;
+        MeshLod lod;
+        lod.error = static_cast<float>(std::sqrt(maxError));
+
+        remap.assign(vertices.Size(), ~0u);
+        std::vector<uint32_t> indices;
+        indices.reserve(static_cast<size_t>(aliveTriangles) * 3);
+        for (uint32_t t = 0; t < triangles.size(); ++t)
+        {
+            if (!bAlive[t]) continue;
+            const auto& tri = triangles[t];
+            const Math::Vector3 face = Math::Vector3::Cross(positions[tri[1]] - positions[tri[0]],
+                                                            positions[tri[2]] - positions[tri[0]]) * orientation;
+            for (const uint32_t p : tri)
+            {
+                // Original vertex at this position whose normal is closest to the new face.
+                uint32_t best = wedges[wedgeStart[p]];
+                float bestDot = -INFINITY;
+                for (uint32_t w = wedgeStart[p]; w < wedgeStart[p + 1]; ++w)
+                {
+                    const uint32_t v = wedges[w];
+                    const float dot = face.x * vertices.normalX[v] + face.y * vertices.normalY[v] +
+                                      face.z * vertices.normalZ[v];
+                    if (dot > bestDot)
+                    {
+                        bestDot = dot;
+                        best = v;
+                    }
+                }
+
+                if (remap[best] == ~0u)
+                {
+                    remap[best] = static_cast<uint32_t>(lod.vertices.Size());
+                    lod.vertices.Push(vertices.Get(best));
+                }
+                indices.push_back(remap[best]);
+            }
+        }
+        lod.indices = std::move(indices);
+        return lod;
+    }
+}
+
+void BuildMeshLods(Mesh& inOutMesh, const MeshLodSettings& inSettings)
+{
+    inOutMesh.lods.clear();
+    if (inOutMesh.indices.size() / 3 < inSettings.minTriangles) return;
+
+    Simplifier simplifier(inOutMesh);
+    uint32_t previous = simplifier.GetTriangleCount();
+    while (inOutMesh.lods.size() < std::min(inSettings.maxLods, MaxMeshLods))
+    {
+        const auto target = static_cast<uint32_t>(static_cast<float>(previous) * inSettings.triangleRatio);
+        if (target < inSettings.minTriangles) break;
+
+        const bool bReached = simplifier.Reduce(target);
+        const uint32_t count = simplifier.GetTriangleCount();
+        // Stuck short of the target: only keep a level that still saves a tenth.
+        if (static_cast<uint64_t>(count) * 10 > static_cast<uint64_t>(previous) * 9) break;
+
+        inOutMesh.lods.push_back(simplifier.Emit());
+        const MeshLod& lod = inOutMesh.lods.back();
+        spdlog::debug("LOD {}: {} vertices, {} triangles, error {:.4f}.", inOutMesh.lods.size(), lod.vertices.Size(),
+                      count, lod.error);
+        previous = count;
+        if (!bReached) break;
+    }
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../Include/MeshletBuilder.h"
+
+namespace
+{
+    // Normals spread wider than this (cosine to the axis) make a cone that never culls.
+    constexpr float MinConeCosine = 0.1f;
+    // Free triangles, in index order, considered for each step of growing a meshlet.
+    constexpr uint32_t MeshletLookAhead = 256;
+
+    Math::Vector3 GetPosition(const VertexStreams& inVertices, const uint32_t inIndex)
+    {
+        return {inVertices.positionX[inIndex], inVertices.positionY[inIndex], inVertices.positionZ[inIndex]};
+    }
+
+    void ComputeMeshletBounds(const VertexStreams& inVertices, const uint32_t* inMeshletVertices,
+                              const uint8_t* inMeshletTriangles, Meshlet& inOutMeshlet)
+    {
+        // Sphere around the center of the box of the vertices.
+        Math::Vector3 min = GetPosition(inVertices, inMeshletVertices[0]);
+        Math::Vector3 max = min;
+        for (uint32_t i = 1; i < inOutMeshlet.vertexCount; ++i)
+        {
+            const Math::Vector3 p = GetPosition(inVertices, inMeshletVertices[i]);
+            min = {std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+            max = {std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+        }
+        inOutMeshlet.center = (min + max) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = 0; i < inOutMeshlet.vertexCount; ++i)
+        {
+            radius = std::max(radius, (GetPosition(inVertices, inMeshletVertices[i]) - inOutMeshlet.center).Length());
+        }
+        inOutMeshlet.radius = radius;
+
+        // Cone around the mean face normal; cross(p1 - p0, p2 - p0) points at the viewer for
+        // clockwise front faces.
+        Math::Vector3 normals[MaxMeshletTriangles];
+        uint32_t normalCount = 0;
+        Math::Vector3 axis{};
+        for (uint32_t t = 0; t < inOutMeshlet.triangleCount; ++t)
+        {
+            const uint8_t* tri = inMeshletTriangles + t * 3;
+            const Math::Vector3 p0 = GetPosition(inVertices, inMeshletVertices[tri[0]]);
+            Math::Vector3 n = Math::Vector3::Cross(GetPosition(inVertices, inMeshletVertices[tri[1]]) - p0,
+                                                   GetPosition(inVertices, inMeshletVertices[tri[2]]) - p0);
+            const float length = n.Length();
+            if (length == 0.0f) continue;
+            n = n * (1.0f / length);
+            normals[normalCount++] = n;
+            axis = axis + n;
+        }
+
+        inOutMeshlet.coneCutoff = 1.0f;
+        const float axisLength = axis.Length();
+        if (normalCount == 0 || axisLength == 0.0f) return;
+        axis = axis * (1.0f / axisLength);
+        inOutMeshlet.coneAxis = axis;
+
+        float minDot = 1.0f;
+        for (uint32_t i = 0; i < normalCount; ++i)
+        {
+            minDot = std::min(minDot, Math::Vector3::Dot(normals[i], axis));
+        }
+        // Every face is back-facing once the view direction is within 90 - acos(minDot)
+        // degrees of the axis: cos(90 - a) = sin(a).
+        if (minDot > MinConeCosine)
+        {
+            inOutMeshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+}
+
+MeshletBuffers BuildMeshlets(const VertexStreams& inVertices, const MeshBuffer<uint32_t>& inIndices)
+{
+    const size_t triangleCount = inIndices.size() / 3;
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint8_t> meshletTriangles;
+    meshletVertices.reserve(inIndices.size());
+    meshletTriangles.reserve(inIndices.size());
+
+    // Centroid and unit normal per triangle for the greedy growth.
+    std::vector<Math::Vector3> centroids(triangleCount);
+    std::vector<Math::Vector3> normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const Math::Vector3 p0 = GetPosition(inVertices, inIndices[t * 3]);
+        const Math::Vector3 p1 = GetPosition(inVertices, inIndices[t * 3 + 1]);
+        const Math::Vector3 p2 = GetPosition(inVertices, inIndices[t * 3 + 2]);
+        centroids[t] = (p0 + p1 + p2) * (1.0f / 3.0f);
+        normals[t] = Math::Vector3::Cross(p1 - p0, p2 - p0);
+        normals[t].Normalize();
+    }
+
+    // Mesh vertex -> local index in the open meshlet.
+    constexpr uint8_t Unused = 0xFF;
+    std::vector<uint8_t> local(inVertices.Size(), Unused);
+    std::vector<uint8_t> bTaken(triangleCount, 0);
+
+    Meshlet current;
+    Math::Vector3 centroidSum{};
+    Math::Vector3 normalSum{};
+    const auto finish = [&]
+    {
+        if (current.triangleCount == 0) return;
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+        {
+            local[meshletVertices[current.vertexOffset + i]] = Unused;
+        }
+        ComputeMeshletBounds(inVertices, meshletVertices.data() + current.vertexOffset,
+                             meshletTriangles.data() + current.triangleOffset * 3, current);
+        meshlets.push_back(current);
+        current = {};
+        current.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+        current.triangleOffset = static_cast<uint32_t>(meshletTriangles.size() / 3);
+        centroidSum = {};
+        normalSum = {};
+    };
+    const auto countNewVertices = [&](const size_t t)
+    {
+        const uint32_t a = inIndices[t * 3], b = inIndices[t * 3 + 1], c = inIndices[t * 3 + 2];
+        return static_cast<uint32_t>((local[a] == Unused) + (local[b] == Unused && b != a) +
+                                     (local[c] == Unused && c != a && c != b));
+    };
+
+    size_t first = 0;
+    while (true)
+    {
+        while (first < triangleCount && bTaken[first]) ++first;
+        if (first == triangleCount) break;
+
+        // Grow the open meshlet with the best of the next MeshletLookAhead free triangles: fewest
+        // new vertices, then closest to its centroid and normal. Falls back to index order.
+        size_t best = triangleCount;
+        if (current.triangleCount > 0)
+        {
+            const Math::Vector3 center = centroidSum * (1.0f / static_cast<float>(current.triangleCount));
+            Math::Vector3 axis = normalSum;
+            axis.Normalize();
+            uint32_t bestNew = MaxMeshletVertices + 1;
+            float bestScore = 0.0f;
+            uint32_t candidates = 0;
+            for (size_t t = first; t < triangleCount && candidates < MeshletLookAhead; ++t)
+            {
+                if (bTaken[t]) continue;
+                ++candidates;
+                const uint32_t newVertices = countNewVertices(t);
+                if (current.vertexCount + newVertices > MaxMeshletVertices) continue;
+
+                const float score = (centroids[t] - center).Length() * (2.0f - Math::Vector3::Dot(normals[t], axis));
+                if (newVertices < bestNew || (newVertices == bestNew && score < bestScore))
+                {
+                    best = t;
+                    bestNew = newVertices;
+                    bestScore = score;
+                }
+            }
+            if (best == triangleCount) finish();
+        }
+        if (best == triangleCount) best = first;
+
+        bTaken[best] = 1;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = inIndices[best * 3 + k];
+            if (local[v] == Unused)
+            {
+                local[v] = static_cast<uint8_t>(current.vertexCount++);
+                meshletVertices.push_back(v);
+            }
+            meshletTriangles.push_back(local[v]);
+        }
+        ++current.triangleCount;
+        centroidSum = centroidSum + centroids[best];
+        normalSum = normalSum + normals[best];
+        if (current.triangleCount == MaxMeshletTriangles) finish();
+    }
+    finish();
+
+    MeshletBuffers buffers;
+    buffers.meshlets = std::move(meshlets);
+    buffers.vertices = std::move(meshletVertices);
+    buffers.triangles = std::move(meshletTriangles);
+    return buffers;
+}
+
+void BuildMeshlets(Mesh& inOutMesh)
+{
+    inOutMesh.clusters = BuildMeshlets(inOutMesh.vertices, inOutMesh.indices);
+    for (MeshLod& lod : inOutMesh.lods)
+    {
+        lod.clusters = BuildMeshlets(lod.vertices, lod.indices);
+    }
+}
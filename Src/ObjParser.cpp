@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "../Include/JobSystem.h"
+#include "../Include/MappedFile.h"
+#include "../Include/ObjParser.h"
+#include "../Include/Profiler.h"
+
+namespace
+{
+    // Chunks are at least this large, so small files don't pay for the fan-out.
+    constexpr size_t MinChunkBytes = size_t{1} << 18;
+    // Chunks per thread, so threads that drew cheap chunks pick up more.
+    constexpr uint32_t ChunksPerThread = 4;
+
+    // Index slots of a raw corner.
+    enum : uint32_t { SlotVertex, SlotTexcoord, SlotNormal, SlotCount };
+
+    // Face corner as read, before the chunk's attribute offsets are known.
+    struct RawCorner
+    {
+        // 0-based; relative indices are counted from the start of the chunk.
+        int32_t index[SlotCount]{-1, -1, -1};
+        // Bit per slot whose index was relative.
+        uint8_t relativeMask{0};
+    };
+
+    struct Chunk
+    {
+        const char* begin{nullptr};
+        const char* end{nullptr};
+
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        // Corner count per face, corners of all faces back to back.
+        std::vector<uint8_t> faceSizes;
+        std::vector<RawCorner> corners;
+        uint32_t triangleCount{0};
+        bool bSupported{true};
+
+        // Prefix sums over the chunks before this one.
+        size_t positionOffset{0};
+        size_t normalOffset{0};
+        size_t texcoordOffset{0};
+        size_t cornerOffset{0};
+    };
+
+    bool IsSpace(const char c) { return c == ' ' || c == '\t'; }
+    bool IsDigit(const char c) { return c >= '0' && c <= '9'; }
+    // Token delimiters within a line.
+    bool IsTokenEnd(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    const char* SkipSpace(const char* inCurr, const char* inEnd)
+    {
+        while (inCurr != inEnd && IsSpace(*inCurr)) ++inCurr;
+        return inCurr;
+    }
+
+    // tinyobjloader's tryParseDouble: the same operations in the same order, so every value
+    // rounds exactly like it does.
+    bool TryParseDouble(const char* inBegin, const char* inEnd, double& outValue)
+    {
+        if (inBegin >= inEnd) return false;
+
+        static constexpr double PowLut[] = {1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+        constexpr int LutEntries = sizeof(PowLut) / sizeof(PowLut[0]);
+
+        double mantissa = 0.0;
+        int exponent = 0;
+        char sign = '+';
+        const char* curr = inBegin;
+        bool bLeadingDot = false;
+
+        if (*curr == '+' || *curr == '-')
+        {
+            sign = *curr++;
+            bLeadingDot = curr != inEnd && *curr == '.';
+        }
+        else if (*curr == '.')
+        {
+            bLeadingDot = true;
+        }
+        else if (!IsDigit(*curr))
+        {
+            return false;
+        }
+
+        if (!bLeadingDot)
+        {
+            int read = 0;
+            for (; curr != inEnd && IsDigit(*curr); ++curr, ++read)
+            {
+                mantissa *= 10;
+                mantissa += static_cast<int>(*curr - '0');
+            }
+            if (read == 0) return false;
+        }
+
+        if (curr != inEnd && *curr == '.')
+        {
+            ++curr;
+            for (int read = 1; curr != inEnd && IsDigit(*curr); ++curr, ++read)
+            {
+                mantissa += static_cast<int>(*curr - '0') * (read < LutEntries ? PowLut[read] : std::pow(10.0, -read));
+            }
+        }
+
+        if (curr != inEnd && (*curr == 'e' || *curr == 'E'))
+        {
+            ++curr;
+            char exponentSign = '+';
+            if (curr != inEnd && (*curr == '+' || *curr == '-'))
+            {
+                exponentSign = *curr++;
+            }
+            else if (curr == inEnd || !IsDigit(*curr))
+            {
+                return false;
+            }
+
+            int read = 0;
+            for (; curr != inEnd && IsDigit(*curr); ++curr, ++read)
+            {
+                if (exponent > 2147483647 / 10) return false;
+                exponent = exponent * 10 + static_cast<int>(*curr - '0');
+            }
+            exponent *= exponentSign == '+' ? 1 : -1;
+            if (read == 0) return false;
+        }
+
+        outValue = (sign == '+' ? 1 : -1) *
+                   (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return true;
+    }
+
+    // Next whitespace-separated number of the line; 0 when it is missing or malformed.
+    float ParseReal(const char*& inOutCurr, const char* inLineEnd)
+    {
+        const char* begin = SkipSpace(inOutCurr, inLineEnd);
+        const char* end = begin;
+        while (end != inLineEnd && !IsTokenEnd(*end)) ++end;
+
+        double value = 0.0;
+        TryParseDouble(begin, end, value);
+        inOutCurr = end;
+        return static_cast<float>(value);
+    }
+
+    // atoi within the line. Saturates instead of overflowing; such indices fail the range
+    // check later anyway.
+    int ParseInt(const char* inCurr, const char* inLineEnd)
+    {
+        inCurr = SkipSpace(inCurr, inLineEnd);
+        bool bNegative = false;
+        if (inCurr != inLineEnd && (*inCurr == '+' || *inCurr == '-'))
+        {
+            bNegative = *inCurr++ == '-';
+        }
+        int64_t value = 0;
+        for (; inCurr != inLineEnd && IsDigit(*inCurr); ++inCurr)
+        {
+            value = std::min<int64_t>(value * 10 + (*inCurr - '0'), INT32_MAX);
+        }
+        return static_cast<int>(bNegative ? -value : value);
+    }
+
+    const char* SkipIndex(const char* inCurr, const char* inLineEnd)
+    {
+        while (inCurr != inLineEnd && *inCurr != '/' && !IsTokenEnd(*inCurr)) ++inCurr;
+        return inCurr;
+    }
+
+    // One v, v/vt, v//vn or v/vt/vn corner; absent normal and texcoord indices stay -1. A zero
+    // (or empty) index in any slot is rejected, as tinyobjloader fails such a face, so the file
+    // falls back to it.
+    bool ParseCorner(const char*& inOutCurr, const char* inLineEnd, const Chunk& inChunk, RawCorner& outCorner)
+    {
+        const size_t counts[SlotCount] = {
+            inChunk.positions.size() / 3, inChunk.texcoords.size() / 2, inChunk.normals.size() / 3
+        };
+        const auto fix = [&](const uint32_t inSlot, const int inIndex)
+        {
+            if (inIndex > 0)
+            {
+                outCorner.index[inSlot] = inIndex - 1;
+            }
+            else if (inIndex < 0)
+            {
+                outCorner.index[inSlot] = static_cast<int32_t>(counts[inSlot]) + inIndex;
+                outCorner.relativeMask |= 1u << inSlot;
+            }
+            return inIndex != 0;
+        };
+
+        const char* curr = inOutCurr;
+        if (!fix(SlotVertex, ParseInt(curr, inLineEnd))) return false;
+        curr = SkipIndex(curr, inLineEnd);
+        if (curr != inLineEnd && *curr == '/')
+        {
+            ++curr;
+            if (curr != inLineEnd && *curr == '/')
+            {
+                ++curr;
+                if (!fix(SlotNormal, ParseInt(curr, inLineEnd))) return false;
+                curr = SkipIndex(curr, inLineEnd);
+            }
+            else
+            {
+                if (!fix(SlotTexcoord, ParseInt(curr, inLineEnd))) return false;
+                curr = SkipIndex(curr, inLineEnd);
+                if (curr != inLineEnd && *curr == '/')
+                {
+                    ++curr;
+                    if (!fix(SlotNormal, ParseInt(curr, inLineEnd))) return false;
+                    curr = SkipIndex(curr, inLineEnd);
+                }
+            }
+        }
+        inOutCurr = curr;
+        return true;
+    }
+
+    // Parse the records of one chunk. Lines end at \n, \r\n or a lone \r.
+    void ParseChunk(Chunk& inOutChunk)
+    {
+        const char* curr = inOutChunk.begin;
+        while (curr != inOutChunk.end && inOutChunk.bSupported)
+        {
+            const char* lineEnd = curr;
+            while (lineEnd != inOutChunk.end && *lineEnd != '\n' && *lineEnd != '\r') ++lineEnd;
+            const char* next = lineEnd;
+            if (next != inOutChunk.end)
+            {
+                next += *next == '\r' && next + 1 != inOutChunk.end && next[1] == '\n' ? 2 : 1;
+            }
+
+            const char* token = SkipSpace(curr, lineEnd);
+            curr = next;
+            const size_t length = lineEnd - token;
+            if (length < 2) continue;
+
+            if (token[0] == 'v' && IsSpace(token[1]))
+            {
+                token += 2;
+                for (int i = 0; i < 3; ++i) inOutChunk.positions.push_back(ParseReal(token, lineEnd));
+            }
+            else if (token[0] == 'v' && token[1] == 'n' && length > 2 && IsSpace(token[2]))
+            {
+                token += 3;
+                for (int i = 0; i < 3; ++i) inOutChunk.normals.push_back(ParseReal(token, lineEnd));
+            }
+            else if (token[0] == 'v' && token[1] == 't' && length > 2 && IsSpace(token[2]))
+            {
+                token += 3;
+                for (int i = 0; i < 2; ++i) inOutChunk.texcoords.push_back(ParseReal(token, lineEnd));
+            }
+            else if (token[0] == 'f' && IsSpace(token[1]))
+            {
+                token = SkipSpace(token + 2, lineEnd);
+                uint32_t cornerCount = 0;
+                while (token != lineEnd)
+                {
+                    RawCorner corner;
+                    if (!ParseCorner(token, lineEnd, inOutChunk, corner) || ++cornerCount > 4)
+                    {
+                        inOutChunk.bSupported = false;
+                        return;
+                    }
+                    inOutChunk.corners.push_back(corner);
+                    while (token != lineEnd && IsTokenEnd(*token)) ++token;
+                }
+
+                // Faces with fewer than three corners are dropped, like tinyobjloader does.
+                if (cornerCount < 3)
+                {
+                    inOutChunk.corners.resize(inOutChunk.corners.size() - cornerCount);
+                    continue;
+                }
+                inOutChunk.faceSizes.push_back(static_cast<uint8_t>(cornerCount));
+                inOutChunk.triangleCount += cornerCount - 2;
+            }
+        }
+    }
+
+    // Turn the chunk's faces into triangles at its corner offset. Needs the merged positions
+    // for the quad split.
+    bool EmitTriangles(const Chunk& inChunk, const ObjData& inData, ObjCorner* outCorners)
+    {
+        const int32_t counts[SlotCount] = {
+            static_cast<int32_t>(inData.positions.size() / 3), static_cast<int32_t>(inData.texcoords.size() / 2),
+            static_cast<int32_t>(inData.normals.size() / 3)
+        };
+        const int32_t offsets[SlotCount] = {
+            static_cast<int32_t>(inChunk.positionOffset / 3), static_cast<int32_t>(inChunk.texcoordOffset / 2),
+            static_cast<int32_t>(inChunk.normalOffset / 3)
+        };
+
+        ObjCorner face[4];
+        const RawCorner* raw = inChunk.corners.data();
+        ObjCorner* out = outCorners + inChunk.cornerOffset;
+        for (const uint8_t faceSize : inChunk.faceSizes)
+        {
+            for (uint32_t i = 0; i < faceSize; ++i, ++raw)
+            {
+                int32_t index[SlotCount];
+                for (uint32_t slot = 0; slot < SlotCount; ++slot)
+                {
+                    const bool bRelative = raw->relativeMask & (1u << slot);
+                    index[slot] = raw->index[slot] + (bRelative ? offsets[slot] : 0);
+                    // Relative indices before the first element, and anything past the end.
+                    if ((bRelative && index[slot] < 0) || index[slot] >= counts[slot]) return false;
+                }
+                face[i] = {index[SlotVertex], index[SlotNormal], index[SlotTexcoord]};
+            }
+
+            if (faceSize == 3)
+            {
+                *out++ = face[0];
+                *out++ = face[1];
+                *out++ = face[2];
+                continue;
+            }
+
+            // Split along the shorter diagonal; same expression as tinyobjloader.
+            const float* p = inData.positions.data();
+            const float* v0 = p + 3 * face[0].vertex;
+            const float* v1 = p + 3 * face[1].vertex;
+            const float* v2 = p + 3 * face[2].vertex;
+            const float* v3 = p + 3 * face[3].vertex;
+            const float e02x = v2[0] - v0[0];
+            const float e02y = v2[1] - v0[1];
+            const float e02z = v2[2] - v0[2];
+            const float e13x = v3[0] - v1[0];
+            const float e13y = v3[1] - v1[1];
+            const float e13z = v3[2] - v1[2];
+            const float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+            const float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+            if (sqr02 < sqr13)
+            {
+                *out++ = face[0];
+                *out++ = face[1];
+                *out++ = face[2];
+                *out++ = face[0];
+                *out++ = face[2];
+                *out++ = face[3];
+            }
+            else
+            {
+                *out++ = face[0];
+                *out++ = face[1];
+                *out++ = face[3];
+                *out++ = face[1];
+                *out++ = face[2];
+                *out++ = face[3];
+            }
+        }
+        return true;
+    }
+}
+
+bool ParseObj(const std::string& inPath, JobSystem& inJobs, ObjData& outData)
+{
+    PROFILE_SCOPE("ParseObj");
+
+    MappedFile file;
+    if (!file.Open(inPath)) return false;
+
+    const char* data = reinterpret_cast<const char*>(file.GetData());
+    const size_t size = file.GetSize();
+
+    // Cut after the first \n at or past each even split, so no line straddles two chunks.
+    const size_t chunkCount = std::clamp<size_t>(size / MinChunkBytes, 1,
+                                                 size_t{inJobs.GetThreadCount()} * ChunksPerThread);
+    std::vector<Chunk> chunks(chunkCount);
+    const char* begin = data;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        const char* end = data + size * (i + 1) / chunkCount;
+        if (end < begin) end = begin;
+        if (i + 1 < chunkCount)
+        {
+            const void* newline = std::memchr(end, '\n', data + size - end);
+            end = newline ? static_cast<const char*>(newline) + 1 : data + size;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+
+    inJobs.ParallelFor(static_cast<uint32_t>(chunkCount), [&](const uint32_t inChunk, uint32_t)
+    {
+        ParseChunk(chunks[inChunk]);
+    });
+
+    size_t positionCount = 0;
+    size_t normalCount = 0;
+    size_t texcoordCount = 0;
+    size_t cornerCount = 0;
+    for (Chunk& chunk : chunks)
+    {
+        if (!chunk.bSupported) return false;
+        chunk.positionOffset = positionCount;
+        chunk.normalOffset = normalCount;
+        chunk.texcoordOffset = texcoordCount;
+        chunk.cornerOffset = cornerCount;
+        positionCount += chunk.positions.size();
+        normalCount += chunk.normals.size();
+        texcoordCount += chunk.texcoords.size();
+        cornerCount += size_t{chunk.triangleCount} * 3;
+    }
+    if (positionCount / 3 > INT32_MAX || normalCount / 3 > INT32_MAX || texcoordCount / 2 > INT32_MAX) return false;
+
+    outData = {};
+    outData.positions.resize(positionCount);
+    outData.normals.resize(normalCount);
+    outData.texcoords.resize(texcoordCount);
+    outData.corners.resize(cornerCount);
+
+    // Attributes first: quads of any chunk may split on positions of any other.
+    inJobs.ParallelFor(static_cast<uint32_t>(chunkCount), [&](const uint32_t inChunk, uint32_t)
+    {
+        const Chunk& chunk = chunks[inChunk];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), outData.positions.begin() + chunk.positionOffset);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), outData.normals.begin() + chunk.normalOffset);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), outData.texcoords.begin() + chunk.texcoordOffset);
+    });
+
+    std::atomic<bool> bValid{true};
+    inJobs.ParallelFor(static_cast<uint32_t>(chunkCount), [&](const uint32_t inChunk, uint32_t)
+    {
+        if (!EmitTriangles(chunks[inChunk], outData, outData.corners.data()))
+        {
+            bValid.store(false, std::memory_order_relaxed);
+        }
+    });
+    return bValid.load();
+}
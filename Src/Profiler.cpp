@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "../Include/Profiler.h"
+
+namespace Profiler
+{
+    namespace Detail
+    {
+        std::atomic<bool> bEnabled{false};
+    }
+
+    namespace
+    {
+        const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+        uint64_t frameStartNs = 0;
+        double frameMs = 0.0;
+        std::vector<StageStats> stageStats;
+
+#if RENDERER_PROFILER
+        // Written only by its owning thread; head is published with release so readers
+        // between frames see complete events. The ring is allocated by the first Record, so
+        // threads that are only named cost no memory while profiling stays off.
+        struct ThreadBuffer
+        {
+            uint32_t id{0};
+            std::string name;
+            std::vector<Event> events;
+            std::atomic<uint64_t> head{0};
+            // Events before this one are already in stageStats (EndFrame only).
+            uint64_t aggregated{0};
+        };
+
+        // Buffers are never freed, so a thread's events survive the thread.
+        std::mutex registryMutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+        thread_local ThreadBuffer* threadBuffer = nullptr;
+
+        ThreadBuffer& GetThreadBuffer()
+        {
+            if (!threadBuffer)
+            {
+                auto buffer = std::make_unique<ThreadBuffer>();
+
+                std::lock_guard lock(registryMutex);
+                buffer->id = static_cast<uint32_t>(registry.size());
+                buffer->name = "Thread " + std::to_string(buffer->id);
+                threadBuffer = buffer.get();
+                registry.push_back(std::move(buffer));
+            }
+            return *threadBuffer;
+        }
+
+        // Call func for each event of buffer from oldest to newest.
+        template<typename Func>
+        void ForEachEvent(const ThreadBuffer& buffer, Func&& func)
+        {
+            const uint64_t head = buffer.head.load(std::memory_order_acquire);
+            const uint64_t count = std::min<uint64_t>(head, RingCapacity);
+            for (uint64_t i = head - count; i < head; ++i)
+            {
+                func(buffer.events[i % RingCapacity]);
+            }
+        }
+
+        void WriteJsonString(std::ofstream& file, const std::string_view inText)
+        {
+            file << '"';
+            for (const char c : inText)
+            {
+                if (c == '"' || c == '\\') file << '\\';
+                file << c;
+            }
+            file << '"';
+        }
+#endif
+    }
+
+    void SetEnabled(const bool bInEnabled)
+    {
+        Detail::bEnabled.store(bInEnabled, std::memory_order_relaxed);
+    }
+
+    uint64_t Now()
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+#if RENDERER_PROFILER
+    void Record(const char* inName, const uint64_t inStartNs, const uint64_t inEndNs)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        // Readers skip a ring while its head is 0, so it can still be allocated here.
+        if (buffer.events.empty()) buffer.events.resize(RingCapacity);
+        const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head % RingCapacity] = {inName, inStartNs, inEndNs};
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void SetThreadName(const std::string& inName)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        std::lock_guard lock(registryMutex);
+        buffer.name = inName;
+    }
+#else
+    void Record(const char*, uint64_t, uint64_t)
+    {
+    }
+
+    void SetThreadName(const std::string&)
+    {
+    }
+#endif
+
+    void EndFrame()
+    {
+        const uint64_t frameEndNs = Now();
+        frameMs = static_cast<double>(frameEndNs - frameStartNs) * 1e-6;
+#if RENDERER_PROFILER
+        // Stage stats are only shown while profiling, so there is nothing to aggregate.
+        if (!IsEnabled())
+        {
+            frameStartNs = frameEndNs;
+            return;
+        }
+
+        // Sum the events that ended during this frame, per stage, across all threads.
+        struct FrameStage
+        {
+            const char* name;
+            uint64_t firstStartNs;
+            uint64_t totalNs;
+            uint32_t calls;
+        };
+        std::vector<FrameStage> frame;
+        {
+            std::lock_guard lock(registryMutex);
+            for (const auto& buffer : registry)
+            {
+                // Only the events recorded since the last call. A thread records in end order,
+                // so the scan stops at the first event that belongs to the next frame.
+                const uint64_t head = buffer->head.load(std::memory_order_acquire);
+                uint64_t i = std::max(buffer->aggregated, head - std::min<uint64_t>(head, RingCapacity));
+                for (; i < head; ++i)
+                {
+                    const Event& event = buffer->events[i % RingCapacity];
+                    if (event.endNs > frameEndNs) break;
+                    if (event.endNs <= frameStartNs) continue;
+
+                    auto it = std::ranges::find_if(frame, [&](const FrameStage& stage)
+                    {
+                        return stage.name == event.name || std::strcmp(stage.name, event.name) == 0;
+                    });
+                    if (it == frame.end())
+                    {
+                        frame.push_back({event.name, event.startNs, 0, 0});
+                        it = frame.end() - 1;
+                    }
+                    it->firstStartNs = std::min(it->firstStartNs, event.startNs);
+                    it->totalNs += event.endNs - event.startNs;
+                    ++it->calls;
+                }
+                buffer->aggregated = i;
+            }
+        }
+        std::ranges::sort(frame, {}, &FrameStage::firstStartNs);
+
+        // Stages keep the order they first showed up in; missing ones decay towards 0.
+        for (StageStats& stats : stageStats)
+        {
+            stats.lastMs = 0.0;
+            stats.calls = 0;
+        }
+        for (const FrameStage& stage : frame)
+        {
+            auto it = std::ranges::find_if(stageStats, [&](const StageStats& stats)
+            {
+                return std::strcmp(stats.name, stage.name) == 0;
+            });
+            if (it == stageStats.end())
+            {
+                stageStats.push_back({stage.name, 0.0, static_cast<double>(stage.totalNs) * 1e-6, 0});
+                it = stageStats.end() - 1;
+            }
+            it->lastMs = static_cast<double>(stage.totalNs) * 1e-6;
+            it->calls = stage.calls;
+        }
+        for (StageStats& stats : stageStats)
+        {
+            stats.averageMs += (stats.lastMs - stats.averageMs) * 0.05;
+        }
+#endif
+
+        frameStartNs = frameEndNs;
+    }
+
+    const std::vector<StageStats>& GetStageStats()
+    {
+        return stageStats;
+    }
+
+    double GetFrameMs()
+    {
+        return frameMs;
+    }
+
+    bool WriteChromeTrace(const std::string& inPath)
+    {
+        std::ofstream file(inPath);
+        if (!file) return false;
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+#if RENDERER_PROFILER
+        bool bFirst = true;
+        const auto separator = [&]
+        {
+            if (!bFirst) file << ",\n";
+            bFirst = false;
+        };
+
+        std::lock_guard lock(registryMutex);
+        for (const auto& buffer : registry)
+        {
+            separator();
+            file << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->id << R"(,"args":{"name":)";
+            WriteJsonString(file, buffer->name);
+            file << "}}";
+
+            ForEachEvent(*buffer, [&](const Event& event)
+            {
+                separator();
+                file << R"({"name":)";
+                WriteJsonString(file, event.name);
+                // Trace timestamps are in microseconds.
+                file << R"(,"ph":"X","pid":1,"tid":)" << buffer->id
+                     << R"(,"ts":)" << event.startNs / 1000 << '.' << event.startNs % 1000 / 100
+                     << R"(,"dur":)" << (event.endNs - event.startNs) / 1000 << '.'
+                     << (event.endNs - event.startNs) % 1000 / 100 << '}';
+            });
+        }
+#endif
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+}
@@ -0,0 +1,1310 @@
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "../Include/Rasterizer.h"
+#include "../Include/JobSystem.h"
+#include "../Include/Profiler.h"
+#include "../Include/ShadowMap.h"
+#include "../Include/Simd.h"
+
+Math::Vector3 ComputeBarycentric2D(float x, float y, const Math::Vector3 *inV)
+{
+    float c1 = (x * (inV[1].y - inV[2].y) + (inV[2].x - inV[1].x) * y + inV[1].x * inV[2].y - inV[2].x * inV[1].y) /
+               (inV[0].x * (inV[1].y - inV[2].y) + (inV[2].x - inV[1].x) * inV[0].y + inV[1].x * inV[2].y - inV[2].x *
+                inV[1].y);
+    float c2 = (x * (inV[2].y - inV[0].y) + (inV[0].x - inV[2].x) * y + inV[2].x * inV[0].y - inV[0].x * inV[2].y) /
+               (inV[1].x * (inV[2].y - inV[0].y) + (inV[0].x - inV[2].x) * inV[1].y + inV[2].x * inV[0].y - inV[0].x *
+                inV[2].y);
+    return {c1, c2, 1.0f - c1 - c2};
+}
+
+// Screen-space bounding box of a triangle, before clamping.
+static TileRect ComputeBounds(const ScreenTriangle &tri)
+{
+    const Math::Vector3 &s0 = tri.s[0];
+    const Math::Vector3 &s1 = tri.s[1];
+    const Math::Vector3 &s2 = tri.s[2];
+
+    return {
+        static_cast<int>(std::floor(std::min({s0.x, s1.x, s2.x}))),
+        static_cast<int>(std::floor(std::min({s0.y, s1.y, s2.y}))),
+        static_cast<int>(std::ceil(std::max({s0.x, s1.x, s2.x}))),
+        static_cast<int>(std::ceil(std::max({s0.y, s1.y, s2.y})))
+    };
+}
+
+// Rounded additions a barycentric goes through on its way to a sample: the rows and spans
+// stepped across one chunk, plus its setup, the sample offset and the interpolation.
+static constexpr float DepthSlackSteps = TileRasterizer::TileSize + TileRasterizer::TileSize / Simd::Width + 4;
+
+// Standard 4x rotated-grid sample positions, relative to the pixel center.
+static constexpr float MsaaSampleX[MsaaSamples] = {-0.125f, 0.375f, -0.375f, 0.125f};
+static constexpr float MsaaSampleY[MsaaSamples] = {-0.375f, -0.125f, 0.125f, 0.375f};
+// Every sample lies within this distance of the pixel center along each axis.
+static constexpr float MsaaSampleExtent = 0.375f;
+
+// Depth as stored in the planes of a DepthFormat. The test compares stored keys, floats as they
+// are and unorm values as integers, so it never decodes and is exact at the format's precision.
+// Unorm maps the depth range [far - 1, far] (GetFarDepth) linearly onto [0, MaxValue].
+template<DepthFormat Format>
+class DepthCodec
+{
+public:
+    static constexpr bool bUnorm = Format != DepthFormat::Float32;
+    using Storage = std::conditional_t<Format == DepthFormat::Unorm16, uint16_t,
+                                       std::conditional_t<bUnorm, uint32_t, float>>;
+    using Key = std::conditional_t<bUnorm, Simd::Int, Simd::Float>;
+    static constexpr float MaxValue = Format == DepthFormat::Unorm16 ? 65535.0f : 16777215.0f;
+
+    explicit DepthCodec(const bool bReverseZ)
+        : base(GetFarDepth(bReverseZ) - 1.0f), baseLanes(Simd::Float::Broadcast(base))
+    {
+    }
+
+    Key Encode(const Simd::Float &depth) const
+    {
+        using Simd::Float;
+        if constexpr (bUnorm)
+        {
+            // Clamped: interpolation may overshoot the range by a rounding error.
+            const Float unit = Simd::Min(Simd::Max(depth - baseLanes, Float::Broadcast(0.0f)), Float::Broadcast(1.0f));
+            return Simd::Int::Truncate(unit * Float::Broadcast(MaxValue) + Float::Broadcast(0.5f));
+        }
+        else
+        {
+            return depth;
+        }
+    }
+
+    // Same rounding as above.
+    Storage Encode(const float depth) const
+    {
+        if constexpr (bUnorm)
+        {
+            return static_cast<Storage>(std::clamp(depth - base, 0.0f, 1.0f) * MaxValue + 0.5f);
+        }
+        else
+        {
+            return depth;
+        }
+    }
+
+    Simd::Float Decode(const Key &key) const
+    {
+        if constexpr (bUnorm) return Simd::ToFloat(key) * Simd::Float::Broadcast(1.0f / MaxValue) + baseLanes;
+        else return key;
+    }
+
+    float Decode(const Storage value) const
+    {
+        if constexpr (bUnorm) return static_cast<float>(value) * (1.0f / MaxValue) + base;
+        else return value;
+    }
+
+    static Key Load(const Storage *p)
+    {
+        if constexpr (Format == DepthFormat::Unorm16) return Simd::Int::Load16(p);
+        else return Key::Load(p);
+    }
+
+    static void Store(const Key &key, Storage *p)
+    {
+        if constexpr (Format == DepthFormat::Unorm16) key.Store16(p);
+        else key.Store(p);
+    }
+
+private:
+    float base;
+    Simd::Float baseLanes;
+};
+
+template<DepthFormat Format>
+static void ClearDepthAs(void *outDepth, const size_t inCount, const bool bReverseZ)
+{
+    using Codec = DepthCodec<Format>;
+    const Codec codec(bReverseZ);
+    std::fill_n(static_cast<typename Codec::Storage *>(outDepth), inCount, codec.Encode(GetFarDepth(bReverseZ)));
+}
+
+void ClearDepth(void *outDepth, const size_t inCount, const DepthFormat inFormat, const bool bReverseZ)
+{
+    switch (inFormat)
+    {
+    case DepthFormat::Float32: ClearDepthAs<DepthFormat::Float32>(outDepth, inCount, bReverseZ); break;
+    case DepthFormat::Unorm24: ClearDepthAs<DepthFormat::Unorm24>(outDepth, inCount, bReverseZ); break;
+    case DepthFormat::Unorm16: ClearDepthAs<DepthFormat::Unorm16>(outDepth, inCount, bReverseZ); break;
+    }
+}
+
+// Recompute the farthest depth of one hierarchical-Z block after it was written.
+template<int Samples, DepthFormat Format>
+static void RefreshHiZMax(const RenderTarget &target, int blockX, int blockY)
+{
+    using Storage = typename DepthCodec<Format>::Storage;
+    const DepthCodec<Format> codec(target.bReverseZ);
+    const int x0 = blockX * HiZBlockSize;
+    const int y0 = blockY * HiZBlockSize;
+    const int x1 = std::min(x0 + HiZBlockSize, static_cast<int>(target.width));
+    const int y1 = std::min(y0 + HiZBlockSize, static_cast<int>(target.height));
+
+    float farthest = -std::numeric_limits<float>::max();
+    for (int y = y0; y < y1 && Samples > 1; ++y)
+    {
+        // Whole spans: padding lanes past the width keep the clear depth, which only makes
+        // the bound more conservative.
+        for (int x = x0; x < x1; x += Simd::Width)
+        {
+            const Storage *span = static_cast<const Storage *>(target.sampleDepth) + GetSampleSpanOffset(target, x, y);
+            Simd::Float spanMax = codec.Decode(codec.Load(span));
+            for (int s = 1; s < Samples; ++s)
+            {
+                spanMax = Simd::Max(spanMax, codec.Decode(codec.Load(span + s * Simd::Width)));
+            }
+            farthest = std::max(farthest, Simd::ReduceMax(spanMax));
+        }
+    }
+    for (int y = y0; y < y1 && Samples == 1; ++y)
+    {
+        // The row of a block is contiguous in both layouts.
+        const Storage *row = static_cast<const Storage *>(target.depth) + GetRowOffset(target, y, target.width) +
+                             GetColumnOffset(target, x0);
+        int x = 0;
+        if (x1 - x0 == HiZBlockSize)
+        {
+            Simd::Float rowMax = codec.Decode(codec.Load(row));
+            for (x += Simd::Width; x < HiZBlockSize; x += Simd::Width)
+            {
+                rowMax = Simd::Max(rowMax, codec.Decode(codec.Load(row + x)));
+            }
+            farthest = std::max(farthest, Simd::ReduceMax(rowMax));
+        }
+        for (; x < x1 - x0; ++x)
+        {
+            farthest = std::max(farthest, codec.Decode(row[x]));
+        }
+    }
+    const uint32_t index = blockY * target.hiZWidth + blockX;
+    target.hiZMax[index] = farthest;
+    target.hiZState[index] &= ~HiZDirty;
+}
+
+// Coverage bits of the pixels of a block that lie on screen.
+static uint64_t HiZBlockMask(const RenderTarget &target, int blockX, int blockY)
+{
+    const int columns = std::min(HiZBlockSize, static_cast<int>(target.width) - blockX * HiZBlockSize);
+    const int rows = std::min(HiZBlockSize, static_cast<int>(target.height) - blockY * HiZBlockSize);
+    if (columns == HiZBlockSize && rows == HiZBlockSize) return ~0ull;
+    const uint64_t rowMask = (1ull << columns) - 1;
+    uint64_t mask = 0;
+    for (int r = 0; r < rows; ++r)
+    {
+        mask |= rowMask << (r * HiZBlockSize);
+    }
+    return mask;
+}
+
+// Broadcast the first Count varyings of one vertex.
+template<int Count>
+static Varyings<Count> LoadVaryings(const float *inVaryings)
+{
+    Varyings<Count> out;
+    for (int i = 0; i < Count; ++i)
+    {
+        out[i] = Simd::Float::Broadcast(inVaryings[i]);
+    }
+    return out;
+}
+
+// Perspective-correct varyings: var/w and 1/w are affine in screen space, so each varying is
+// their ratio. inOverW[i] holds vertex i's varyings times inInvW[i]; a and b are the x and y
+// gradients of the first two barycentrics. Texcoord derivatives follow from the quotient rule.
+template<int Count>
+static void InterpolatePerspective(const Simd::Float &w0, const Simd::Float &w1, const Simd::Float &w2,
+                                   const Varyings<Count> (&inOverW)[3], const Simd::Float (&inInvW)[3],
+                                   const Simd::Float &a0, const Simd::Float &b0, const Simd::Float &a1,
+                                   const Simd::Float &b1, Varyings<Count> &outVaryings,
+                                   TexcoordDerivatives &outDerivatives)
+{
+    static_assert(Count >= 2, "Varyings 0 and 1 are the texcoords.");
+    const Simd::Float invQ = Simd::Float::Broadcast(1.0f) / (w0 * inInvW[0] + w1 * inInvW[1] + w2 * inInvW[2]);
+    for (int k = 0; k < Count; ++k)
+    {
+        outVaryings[k] = (w0 * inOverW[0][k] + w1 * inOverW[1][k] + w2 * inOverW[2][k]) * invQ;
+    }
+
+    const auto dx = [&](const Simd::Float &v0, const Simd::Float &v1, const Simd::Float &v2)
+    { return a0 * (v0 - v2) + a1 * (v1 - v2); };
+    const auto dy = [&](const Simd::Float &v0, const Simd::Float &v1, const Simd::Float &v2)
+    { return b0 * (v0 - v2) + b1 * (v1 - v2); };
+    const Simd::Float dQdx = dx(inInvW[0], inInvW[1], inInvW[2]);
+    const Simd::Float dQdy = dy(inInvW[0], inInvW[1], inInvW[2]);
+    const Simd::Float dPdx[2] = {dx(inOverW[0][0], inOverW[1][0], inOverW[2][0]),
+                                 dx(inOverW[0][1], inOverW[1][1], inOverW[2][1])};
+    const Simd::Float dPdy[2] = {dy(inOverW[0][0], inOverW[1][0], inOverW[2][0]),
+                                 dy(inOverW[0][1], inOverW[1][1], inOverW[2][1])};
+    outDerivatives.dudx = (dPdx[0] - outVaryings[0] * dQdx) * invQ;
+    outDerivatives.dvdx = (dPdx[1] - outVaryings[1] * dQdx) * invQ;
+    outDerivatives.dudy = (dPdy[0] - outVaryings[0] * dQdy) * invQ;
+    outDerivatives.dvdy = (dPdy[1] - outVaryings[1] * dQdy) * invQ;
+}
+
+static ColorLanes UnpackColor(const uint32_t inColor)
+{
+    return {
+        Simd::Float::Broadcast(static_cast<float>(inColor & 0x000000FF)),
+        Simd::Float::Broadcast(static_cast<float>((inColor & 0x0000FF00) >> 8)),
+        Simd::Float::Broadcast(static_cast<float>((inColor & 0x00FF0000) >> 16))
+    };
+}
+
+// FS: fragment shader; only its varyings are interpolated.
+// bWriteId: visibility-buffer pass, stores depth and triangleId + 1 instead of shading.
+// Samples: 1 draws into the pixel planes, MsaaSamples into the sample planes.
+// Format: storage of the depth planes; the depth test runs on its keys (DepthCodec).
+template<typename FS, bool bWriteId, int Samples, DepthFormat Format>
+static void RasterizeTriangleImpl(const RenderTarget &target, const TileRect &rect, const ScreenTriangle &tri,
+                                  const SimdLighting &lighting, const uint32_t triangleId)
+{
+    using Simd::Float;
+    using Simd::Int;
+    using Simd::Mask;
+    using Storage = typename DepthCodec<Format>::Storage;
+    using DepthKey = typename DepthCodec<Format>::Key;
+    const DepthCodec<Format> codec(target.bReverseZ);
+    constexpr int W = Simd::Width;
+    static_assert(HiZBlockSize % W == 0 && TileRasterizer::TileSize % HiZBlockSize == 0);
+    static_assert(Samples == 1 || (Samples == MsaaSamples && !bWriteId));
+    constexpr bool bMultisample = Samples > 1;
+    constexpr int Varying = bWriteId ? 0 : FS::VaryingCount;
+    // Whether the color plane (or the ID plane) is written at all.
+    constexpr bool bWritesColor = bWriteId || FS::bWritesColor;
+    // Flat shading picks its color once per triangle.
+    constexpr bool bInterpolate = !bWriteId && !FS::bFlat && Varying > 0;
+
+    // Bounding box in screen space.
+    // 计算包围盒 (Bounding Box) 并限制在屏幕范围内 (Clamping)
+    // 这一步能显著提升性能，防止在屏幕外无效循环
+    const TileRect bounds = ComputeBounds(tri);
+    const int minX = std::max(rect.minX, bounds.minX);
+    const int maxX = std::min(rect.maxX, bounds.maxX);
+    const int minY = std::max(rect.minY, bounds.minY);
+    const int maxY = std::min(rect.maxY, bounds.maxY);
+    if (minX > maxX || minY > maxY) return;
+
+    const Math::Vector3 &s0 = tri.s[0];
+    const Math::Vector3 &s1 = tri.s[1];
+    const Math::Vector3 &s2 = tri.s[2];
+    // Depth grows with distance either way (RenderTarget::bReverseZ).
+    const float zSign = target.bReverseZ ? -1.0f : 1.0f;
+    const float depth0 = s0.z * zSign, depth1 = s1.z * zSign, depth2 = s2.z * zSign;
+
+    // Edge equations E_i(x, y) = a_i * x + b_i * y + c_i for the edges opposite v0 and v1,
+    // pre-divided by the signed area so they evaluate straight to barycentrics.
+    const float area = (s0.x * (s1.y - s2.y) + (s2.x - s1.x) * s0.y + s1.x * s2.y - s2.x * s1.y);
+    if (!(std::abs(area) > 0.0f)) return; // Degenerate or non-finite.
+    const float invArea = 1.0f / area;
+
+    const float a0 = (s1.y - s2.y) * invArea;
+    const float b0 = (s2.x - s1.x) * invArea;
+    const float c0 = (s1.x * s2.y - s2.x * s1.y) * invArea;
+    const float a1 = (s2.y - s0.y) * invArea;
+    const float b1 = (s0.x - s2.x) * invArea;
+    const float c1 = (s2.x * s0.y - s0.x * s2.y) * invArea;
+    // Third barycentric is a plane too.
+    const float a2 = -a0 - a1, b2 = -b0 - b1, c2 = 1.0f - c0 - c1;
+    // Depth gradient, anchored at v0 to keep it well conditioned near z = 1.
+    const float az = a1 * (depth1 - depth0) + a2 * (depth2 - depth0);
+    const float bz = b1 * (depth1 - depth0) + b2 * (depth2 - depth0);
+    const float cz = depth0 - az * s0.x - bz * s0.y;
+
+    // Bound on the gap between the depth bounds below and the depth interpolated at any sample
+    // of the bounds. Each rounded step of a barycentric is off by at most FLT_EPSILON times its
+    // partial sums, bounded by |a| x + |b| y + |c|; since w2 = 1 - w0 - w1, the depth
+    // w0 z0 + w1 z1 + w2 z2 sees those errors scaled by |z0 - z2| and |z1 - z2|. The products and
+    // sums of the interpolation, and the setup and evaluation of the depth plane, add a few
+    // ulps of the depths and of |az| x + |bz| y + |cz|.
+    const float coordMax = static_cast<float>(std::max(maxX, maxY) + 1);
+    const float baryMag0 = (std::abs(a0) + std::abs(b0)) * coordMax + std::abs(c0);
+    const float baryMag1 = (std::abs(a1) + std::abs(b1)) * coordMax + std::abs(c1);
+    const float depthMag = std::max({std::abs(depth0), std::abs(depth1), std::abs(depth2)});
+    const float planeMag = (std::abs(az) + std::abs(bz)) * coordMax + std::abs(cz);
+    const float depthSlack = std::numeric_limits<float>::epsilon() *
+                             (DepthSlackSteps * (baryMag0 * std::abs(depth0 - depth2) + baryMag1 * std::abs(depth1 - depth2)) +
+                              8.0f * (depthMag + planeMag));
+
+    // Whole-triangle rejection: nearest vertex behind every block it overlaps.
+    const float triMinZ = std::min({depth0, depth1, depth2}) - depthSlack;
+    const float triMaxZ = std::max({depth0, depth1, depth2}) + depthSlack;
+    const int blockMinX = minX / HiZBlockSize;
+    const int blockMaxX = maxX / HiZBlockSize;
+    const int blockMinY = minY / HiZBlockSize;
+    const int blockMaxY = maxY / HiZBlockSize;
+    {
+        float farthest = -std::numeric_limits<float>::max();
+        for (int by = blockMinY; by <= blockMaxY; ++by)
+        {
+            for (int bx = blockMinX; bx <= blockMaxX; ++bx)
+            {
+                farthest = std::max(farthest, target.hiZMax[by * target.hiZWidth + bx]);
+            }
+        }
+        if (triMinZ >= farthest) return;
+    }
+
+    // Largest value of a plane over the pixel centers (or samples) of [x0, x1] x [y0, y1].
+    constexpr float sampleMin = 0.5f - (bMultisample ? MsaaSampleExtent : 0.0f);
+    constexpr float sampleMax = 0.5f + (bMultisample ? MsaaSampleExtent : 0.0f);
+    const auto planeMax = [](float a, float b, float c, int x0, int x1, int y0, int y1)
+    {
+        return (a > 0 ? a * (x1 + sampleMax) : a * (x0 + sampleMin)) +
+               (b > 0 ? b * (y1 + sampleMax) : b * (y0 + sampleMin)) + c;
+    };
+
+    const Float one = Float::Broadcast(1.0f);
+    const Float zero = Float::Broadcast(0.0f);
+
+    const Float z0 = Float::Broadcast(depth0), z1 = Float::Broadcast(depth1), z2 = Float::Broadcast(depth2);
+    const Varyings<Varying> var0 = LoadVaryings<Varying>(tri.varyings[0]);
+    const Varyings<Varying> var1 = LoadVaryings<Varying>(tri.varyings[1]);
+    const Varyings<Varying> var2 = LoadVaryings<Varying>(tri.varyings[2]);
+    const ColorLanes base = UnpackColor(tri.baseColor);
+
+    // Value stored for every passing pixel when nothing is interpolated.
+    Int constantColor = Int::Broadcast(triangleId + 1);
+    if constexpr (!bWriteId && !bInterpolate && FS::bWritesColor)
+    {
+        constantColor = FS::Shade(var0, base, lighting);
+    }
+
+    // Textured shaders interpolate var/w and 1/w instead.
+    Varyings<Varying> varOverW[3];
+    Float invW[3];
+    if constexpr (bInterpolate && FS::bTextured)
+    {
+        const Varyings<Varying> *vars[3] = {&var0, &var1, &var2};
+        for (int v = 0; v < 3; ++v)
+        {
+            invW[v] = Float::Broadcast(tri.invW[v]);
+            for (int k = 0; k < Varying; ++k) varOverW[v][k] = (*vars[v])[k] * invW[v];
+        }
+    }
+    const Float planeA0 = Float::Broadcast(a0), planeB0 = Float::Broadcast(b0);
+    const Float planeA1 = Float::Broadcast(a1), planeB1 = Float::Broadcast(b1);
+
+    const Float laneX = Float::Ramp();
+
+    // Shadows vary per pixel, so even flat triangles are shaded per span when they are on.
+    const bool bShadowed = !bWriteId && FS::bUsesShadow && lighting.shadowMap != nullptr;
+    SimdLighting pixelLighting = lighting;
+
+    // Fragment shader of the span at (x, y) with barycentrics (w0, w1, w2) and depth; coverage
+    // marks the lanes whose color is kept.
+    const auto shade = [&](const Float &w0, const Float &w1, const Float &w2, const Float &depth, const Mask &coverage,
+                           int x, int y)
+    {
+        if (bShadowed)
+        {
+            pixelLighting.visibility = lighting.shadowMap->GetVisibility(
+                Float::Broadcast(static_cast<float>(x) + 0.5f) + laneX, Float::Broadcast(static_cast<float>(y) + 0.5f),
+                depth);
+        }
+
+        Varyings<Varying> varyings;
+        if constexpr (bWriteId || !FS::bWritesColor)
+        {
+            return Int::Broadcast(0);
+        }
+        else if constexpr (bInterpolate && FS::bTextured)
+        {
+            TexcoordDerivatives derivatives;
+            InterpolatePerspective<Varying>(w0, w1, w2, varOverW, invW, planeA0, planeB0, planeA1, planeB1, varyings,
+                                            derivatives);
+            return FS::Shade(varyings, derivatives, tri.texture, coverage, base, pixelLighting);
+        }
+        else if constexpr (bInterpolate)
+        {
+            for (int k = 0; k < Varying; ++k)
+            {
+                varyings[k] = w0 * var0[k] + w1 * var1[k] + w2 * var2[k];
+            }
+            return FS::Shade(varyings, base, pixelLighting);
+        }
+        else
+        {
+            return FS::Shade(var0, base, pixelLighting);
+        }
+    };
+
+    const Float stepX0 = Float::Broadcast(a0 * W);
+    const Float stepX1 = Float::Broadcast(a1 * W);
+
+    // Edge and depth planes at each sample, as offsets from the pixel center.
+    Float sampleW0[Samples], sampleW1[Samples], sampleZ[Samples];
+    for (int s = 0; s < Samples && bMultisample; ++s)
+    {
+        sampleW0[s] = Float::Broadcast(a0 * MsaaSampleX[s] + b0 * MsaaSampleY[s]);
+        sampleW1[s] = Float::Broadcast(a1 * MsaaSampleX[s] + b1 * MsaaSampleY[s]);
+        sampleZ[s] = Float::Broadcast(az * MsaaSampleX[s] + bz * MsaaSampleY[s]);
+    }
+
+    // Hierarchical-Z classification, one tile-sized chunk of blocks at a time so the
+    // per-block state stays on the stack. Spans are still walked row by row.
+    constexpr int ChunkBlocks = TileRasterizer::TileSize / HiZBlockSize;
+    static_assert(ChunkBlocks <= 8, "Chunk rows are stored as 8-bit block masks.");
+
+    for (int chunkY = blockMinY; chunkY <= blockMaxY; chunkY += ChunkBlocks)
+    {
+        for (int chunkX = blockMinX; chunkX <= blockMaxX; chunkX += ChunkBlocks)
+        {
+            const int chunkMaxX = std::min(blockMaxX, chunkX + ChunkBlocks - 1);
+            const int chunkMaxY = std::min(blockMaxY, chunkY + ChunkBlocks - 1);
+
+            // Per block row: bit set if the block may be drawn / passes the depth test outright.
+            uint8_t activeRows[ChunkBlocks] = {};
+            uint8_t acceptRows[ChunkBlocks] = {};
+            // Lower bound of the depth the triangle can write into the block.
+            float nearestWritten[ChunkBlocks * ChunkBlocks];
+            uint64_t writtenMask[ChunkBlocks * ChunkBlocks][Samples];
+            bool bAnyActive = false;
+
+            for (int by = chunkY; by <= chunkMaxY; ++by)
+            {
+                for (int bx = chunkX; bx <= chunkMaxX; ++bx)
+                {
+                    // Part of the block inside the triangle's clamped bounds.
+                    const int x0 = std::max(minX, bx * HiZBlockSize);
+                    const int x1 = std::min(maxX, bx * HiZBlockSize + HiZBlockSize - 1);
+                    const int y0 = std::max(minY, by * HiZBlockSize);
+                    const int y1 = std::min(maxY, by * HiZBlockSize + HiZBlockSize - 1);
+
+                    // Block entirely outside one of the edges.
+                    if (planeMax(a0, b0, c0, x0, x1, y0, y1) < 0.0f ||
+                        planeMax(a1, b1, c1, x0, x1, y0, y1) < 0.0f ||
+                        planeMax(a2, b2, c2, x0, x1, y0, y1) < 0.0f)
+                    {
+                        continue;
+                    }
+
+                    // Block entirely behind what is already stored. A stale hiZMax is only
+                    // refreshed when the refreshed value could reject the block.
+                    const int hiZIndex = by * static_cast<int>(target.hiZWidth) + bx;
+                    const float blockMinZ = std::max(triMinZ, -planeMax(-az, -bz, -cz, x0, x1, y0, y1) - depthSlack);
+                    if (blockMinZ >= target.hiZMax[hiZIndex]) continue;
+                    if ((target.hiZState[hiZIndex] & HiZDirty) && blockMinZ >= target.hiZMin[hiZIndex])
+                    {
+                        RefreshHiZMax<Samples, Format>(target, bx, by);
+                        if (blockMinZ >= target.hiZMax[hiZIndex]) continue;
+                    }
+
+                    const int local = (by - chunkY) * ChunkBlocks + (bx - chunkX);
+                    activeRows[by - chunkY] |= 1u << (bx - chunkX);
+                    nearestWritten[local] = blockMinZ;
+                    std::fill_n(writtenMask[local], Samples, 0);
+                    bAnyActive = true;
+
+                    // Block entirely in front of what is stored: every covered pixel passes.
+                    const float blockMaxZ = std::min(triMaxZ, planeMax(az, bz, cz, x0, x1, y0, y1) + depthSlack);
+                    if (blockMaxZ < target.hiZMin[hiZIndex])
+                    {
+                        acceptRows[by - chunkY] |= 1u << (bx - chunkX);
+                    }
+                }
+            }
+            if (!bAnyActive) continue;
+
+            // Pixels of the chunk inside the triangle's clamped bounds.
+            const int chunkMinPX = std::max(minX, chunkX * HiZBlockSize);
+            const int chunkMaxPX = std::min(maxX, chunkMaxX * HiZBlockSize + HiZBlockSize - 1);
+            const int chunkMinPY = std::max(minY, chunkY * HiZBlockSize);
+            const int chunkMaxPY = std::min(maxY, chunkMaxY * HiZBlockSize + HiZBlockSize - 1);
+
+            // Spans start on W-aligned columns, so each one lies inside a single block.
+            const int startX = chunkMinPX & ~(W - 1);
+            const Float firstX = Float::Broadcast(static_cast<float>(startX) + 0.5f) + laneX;
+            const Float rowW0 = Float::Broadcast(a0) * firstX;
+            const Float rowW1 = Float::Broadcast(a1) * firstX;
+            float rowC0 = b0 * (static_cast<float>(chunkMinPY) + 0.5f) + c0;
+            float rowC1 = b1 * (static_cast<float>(chunkMinPY) + 0.5f) + c1;
+
+            for (int y = chunkMinPY; y <= chunkMaxPY; ++y, rowC0 += b0, rowC1 += b1)
+            {
+                const int localY = y / HiZBlockSize - chunkY;
+                const uint32_t active = activeRows[localY];
+                if (active == 0) continue;
+                const uint32_t accept = acceptRows[localY];
+
+                Float w0 = rowW0 + Float::Broadcast(rowC0);
+                Float w1 = rowW1 + Float::Broadcast(rowC1);
+                // Color plane, or triangle IDs for the visibility pass.
+                uint32_t *colorRow = nullptr;
+                if constexpr (bWriteId)
+                {
+                    colorRow = target.visibility + GetRowOffset(target, y, target.width);
+                }
+                else if constexpr (bWritesColor)
+                {
+                    colorRow = target.color + GetRowOffset(target, y, target.colorPitch);
+                }
+                Storage *depthRow = static_cast<Storage *>(target.depth) + GetRowOffset(target, y, target.width);
+
+                for (int x = startX; x <= chunkMaxPX; x += W, w0 += stepX0, w1 += stepX1)
+                {
+                    const int localX = x / HiZBlockSize - chunkX;
+                    if (!(active >> localX & 1u)) continue;
+
+                    const Float w2 = one - w0 - w1;
+
+                    // Lanes of the span inside the chunk.
+                    Mask inside = Mask::FirstN(W);
+                    if (x < chunkMinPX || x + W - 1 > chunkMaxPX)
+                    {
+                        const Float pixelX = Float::Broadcast(static_cast<float>(x)) + laneX;
+                        inside = (pixelX >= Float::Broadcast(static_cast<float>(chunkMinPX))) &
+                                 (pixelX < Float::Broadcast(static_cast<float>(chunkMaxPX + 1)));
+                    }
+
+                    if constexpr (bMultisample)
+                    {
+                        // Sample spans never cross a tile, so they are written in place.
+                        Mask covered[Samples];
+                        Mask anyCovered = Mask::FirstN(0);
+                        for (int s = 0; s < Samples; ++s)
+                        {
+                            const Float sw0 = w0 + sampleW0[s];
+                            const Float sw1 = w1 + sampleW1[s];
+                            covered[s] = inside & (sw0 >= zero) & (sw1 >= zero) & (one - sw0 - sw1 >= zero);
+                            anyCovered = anyCovered | covered[s];
+                        }
+                        if (!anyCovered.Any()) continue;
+
+                        const size_t spanOffset = GetSampleSpanOffset(target, x, y);
+                        Storage *depthSpan = static_cast<Storage *>(target.sampleDepth) + spanOffset;
+                        const Float depth = w0 * z0 + w1 * z1 + w2 * z2;
+                        const bool bAccept = accept >> localX & 1u;
+                        uint64_t *written = writtenMask[localY * ChunkBlocks + localX];
+                        const int bitOffset = y % HiZBlockSize * HiZBlockSize + x % HiZBlockSize;
+                        Mask pass[Samples];
+                        Mask anyPass = Mask::FirstN(0);
+                        Mask allPass = Mask::FirstN(W);
+                        for (int s = 0; s < Samples; ++s)
+                        {
+                            const DepthKey sampleDepth = codec.Encode(depth + sampleZ[s]);
+                            const DepthKey oldDepth = codec.Load(depthSpan + s * W);
+                            pass[s] = bAccept ? covered[s] : covered[s] & (sampleDepth < oldDepth);
+                            if (pass[s].Any())
+                            {
+                                codec.Store(Select(pass[s], sampleDepth, oldDepth), depthSpan + s * W);
+                                written[s] |= static_cast<uint64_t>(pass[s].Bits()) << bitOffset;
+                            }
+                            anyPass = anyPass | pass[s];
+                            allPass = allPass & pass[s];
+                        }
+                        if (!anyPass.Any()) continue;
+
+                        if constexpr (bWritesColor)
+                        {
+                            // Shaded once per pixel, at its center.
+                            Int color = constantColor;
+                            if (bInterpolate || bShadowed)
+                            {
+                                color = shade(w0, w1, w2, depth, anyPass, x, y);
+                            }
+
+                            uint32_t *colorSpan = target.sampleColor + spanOffset;
+                            uint32_t *uniformPtr = target.sampleUniform + static_cast<size_t>(y) * target.samplePitch + x;
+                            const Int oldUniform = Int::Load(uniformPtr);
+                            const Int first = Int::Load(colorSpan);
+                            const Int uniformSet = Int::Broadcast(~0u);
+                            Select(pass[0], color, first).Store(colorSpan);
+                            if ((anyPass.Bits() & ~allPass.Bits()) == 0)
+                            {
+                                // Every pixel touched is fully covered: its first sample stands for all.
+                                Select(allPass, uniformSet, oldUniform).Store(uniformPtr);
+                            }
+                            else
+                            {
+                                // An edge splits a pixel: spell out flagged pixels before writing single samples.
+                                const Mask uniform = oldUniform != Int::Broadcast(0);
+                                for (int s = 1; s < Samples; ++s)
+                                {
+                                    uint32_t *samplePtr = colorSpan + s * W;
+                                    Select(pass[s], color, Select(uniform, first, Int::Load(samplePtr))).Store(samplePtr);
+                                }
+                                Select(allPass, uniformSet, Select(anyPass, Int::Broadcast(0), oldUniform)).Store(uniformPtr);
+                            }
+                        }
+                        continue;
+                    }
+
+                    // Coverage: inclusive on all three edges, third barycentric from the other two.
+                    const Mask covered = inside & (w0 >= zero) & (w1 >= zero) & (w2 >= zero);
+                    if (!covered.Any()) continue;
+
+                    // Spans reaching outside our rect go through a scratch copy so nothing
+                    // owned by another tile (or past the row end) is touched.
+                    const bool bDirect = x >= rect.minX && x + W - 1 <= rect.maxX;
+                    alignas(32) Storage depthScratch[W];
+                    alignas(32) uint32_t colorScratch[W];
+                    const size_t column = GetColumnOffset(target, x);
+                    Storage *depthPtr = depthRow + column;
+                    uint32_t *colorPtr = bWritesColor ? colorRow + column : nullptr;
+                    const int laneBegin = std::max(0, rect.minX - x);
+                    const int laneEnd = std::min(W, rect.maxX + 1 - x);
+                    if (!bDirect)
+                    {
+                        for (int i = laneBegin; i < laneEnd; ++i)
+                        {
+                            depthScratch[i] = depthRow[column + i];
+                            if constexpr (bWritesColor) colorScratch[i] = colorRow[column + i];
+                        }
+                        depthPtr = depthScratch;
+                        colorPtr = colorScratch;
+                    }
+
+                    // 1. 深度插值与测试
+                    const Float depth = w0 * z0 + w1 * z1 + w2 * z2;
+                    const DepthKey newDepth = codec.Encode(depth);
+                    const DepthKey oldDepth = codec.Load(depthPtr);
+                    const Mask pass = (accept >> localX & 1u) ? covered : covered & (newDepth < oldDepth);
+                    if (pass.Any())
+                    {
+                        codec.Store(Select(pass, newDepth, oldDepth), depthPtr);
+                        writtenMask[localY * ChunkBlocks + localX][0] |= static_cast<uint64_t>(pass.Bits())
+                                                                       << (y % HiZBlockSize * HiZBlockSize + x % HiZBlockSize);
+
+                        if constexpr (bInterpolate)
+                        {
+                            // 2. 属性插值 (Phong 时为法线)
+                            const Int color = shade(w0, w1, w2, depth, pass, x, y);
+
+                            Select(pass, color, Int::Load(colorPtr)).Store(colorPtr);
+                        }
+                        else if constexpr (bWritesColor)
+                        {
+                            const Int color = bShadowed ? shade(w0, w1, w2, depth, pass, x, y) : constantColor;
+                            Select(pass, color, Int::Load(colorPtr)).Store(colorPtr);
+                        }
+                    }
+
+                    if (!bDirect)
+                    {
+                        for (int i = laneBegin; i < laneEnd; ++i)
+                        {
+                            depthRow[column + i] = depthScratch[i];
+                            if constexpr (bWritesColor) colorRow[column + i] = colorScratch[i];
+                        }
+                    }
+                }
+            }
+
+            // Fold what was written back into the hierarchy.
+            for (int by = chunkY; by <= chunkMaxY; ++by)
+            {
+                for (int bx = chunkX; bx <= chunkMaxX; ++bx)
+                {
+                    const int local = (by - chunkY) * ChunkBlocks + (bx - chunkX);
+                    if (!(activeRows[by - chunkY] >> (bx - chunkX) & 1u)) continue;
+                    uint64_t written = 0;
+                    for (const uint64_t sampleMask : writtenMask[local]) written |= sampleMask;
+                    if (written == 0) continue;
+
+                    const int hiZIndex = by * static_cast<int>(target.hiZWidth) + bx;
+                    target.hiZMin[hiZIndex] = std::min(target.hiZMin[hiZIndex], nearestWritten[local]);
+
+                    // Until every pixel (sample) was written the farthest depth is still the clear value.
+                    const uint64_t blockMask = HiZBlockMask(target, bx, by);
+                    bool bCovered = true;
+                    for (int s = 0; s < Samples; ++s)
+                    {
+                        uint64_t &coverage = target.hiZCoverage[static_cast<size_t>(hiZIndex) * Samples + s];
+                        coverage |= writtenMask[local][s];
+                        bCovered = bCovered && coverage == blockMask;
+                    }
+                    if (bCovered)
+                    {
+                        target.hiZState[hiZIndex] |= HiZDirty;
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename FS, DepthFormat Format>
+void RasterizeTriangle(const RenderTarget &target, const TileRect &rect, const ScreenTriangle &tri,
+                       const SimdLighting &lighting)
+{
+    RasterizeTriangleImpl<FS, false, 1, Format>(target, rect, tri, lighting, 0);
+}
+
+template<typename FS, DepthFormat Format>
+void RasterizeTriangleMultisample(const RenderTarget &target, const TileRect &rect, const ScreenTriangle &tri,
+                                  const SimdLighting &lighting)
+{
+    RasterizeTriangleImpl<FS, false, MsaaSamples, Format>(target, rect, tri, lighting, 0);
+}
+
+template<DepthFormat Format>
+void RasterizeTriangleId(const RenderTarget &target, const TileRect &rect, const ScreenTriangle &tri,
+                         const uint32_t triangleId)
+{
+    static const SimdLighting unlit(Lighting{});
+    RasterizeTriangleImpl<DepthOnlyFS, true, 1, Format>(target, rect, tri, unlit, triangleId);
+}
+
+TriangleSetup ComputeTriangleSetup(const ScreenTriangle &tri)
+{
+    const Math::Vector3 &s0 = tri.s[0];
+    const Math::Vector3 &s1 = tri.s[1];
+    const Math::Vector3 &s2 = tri.s[2];
+
+    // Same planes as the raster pass.
+    const float area = (s0.x * (s1.y - s2.y) + (s2.x - s1.x) * s0.y + s1.x * s2.y - s2.x * s1.y);
+    const float invArea = 1.0f / area;
+    return {
+        (s1.y - s2.y) * invArea, (s2.x - s1.x) * invArea, (s1.x * s2.y - s2.x * s1.y) * invArea,
+        (s2.y - s0.y) * invArea, (s0.x - s2.x) * invArea, (s2.x * s0.y - s0.x * s2.y) * invArea
+    };
+}
+
+template<typename FS, DepthFormat Format>
+void ShadeVisibility(const RenderTarget &target, const TileRect &rect, const ScreenTriangle *triangles,
+                     const TriangleSetup *setups, const SimdLighting &lighting)
+{
+    using Simd::Float;
+    using Simd::Int;
+    using Simd::Mask;
+    constexpr int W = Simd::Width;
+    constexpr int Varying = FS::VaryingCount;
+    // Flat shading reads the first vertex only and needs no barycentrics.
+    constexpr int ShadedVertices = FS::bFlat ? 1 : 3;
+
+    if constexpr (!FS::bWritesColor)
+    {
+        // Depth is already final; just reset the IDs, one block row at a time (contiguous in
+        // either layout).
+        for (int y = rect.minY; y <= rect.maxY; ++y)
+        {
+            uint32_t *idRow = target.visibility + GetRowOffset(target, y, target.width);
+            for (int x = rect.minX; x <= rect.maxX; x += HiZBlockSize)
+            {
+                std::fill_n(idRow + GetColumnOffset(target, x), std::min(HiZBlockSize, rect.maxX + 1 - x), 0u);
+            }
+        }
+        return;
+    }
+
+    const Float laneX = Float::Ramp();
+
+    for (int y = rect.minY; y <= rect.maxY; ++y)
+    {
+        uint32_t *idRow = target.visibility + GetRowOffset(target, y, target.width);
+        uint32_t *colorRow = target.color + GetRowOffset(target, y, target.colorPitch);
+        const Float pixelY = Float::Broadcast(static_cast<float>(y) + 0.5f);
+
+        for (int x = rect.minX; x <= rect.maxX; x += W)
+        {
+            // The last span of a row may be short; it goes through scratch copies.
+            const int laneCount = std::min(W, rect.maxX + 1 - x);
+            alignas(32) uint32_t idScratch[W] = {};
+            alignas(32) uint32_t colorScratch[W] = {};
+            const size_t column = GetColumnOffset(target, x);
+            uint32_t *idPtr = idRow + column;
+            uint32_t *colorPtr = colorRow + column;
+            if (laneCount < W)
+            {
+                std::copy_n(idPtr, laneCount, idScratch);
+                std::copy_n(colorPtr, laneCount, colorScratch);
+                idPtr = idScratch;
+                colorPtr = colorScratch;
+            }
+
+            const Int ids = Int::Load(idPtr);
+            const Mask visible = ids != Int::Broadcast(0);
+            if (!visible.Any()) continue;
+
+            // Gather the per-lane triangle attributes.
+            alignas(32) float planes[6][W];
+            alignas(32) float vertexVaryings[ShadedVertices][Varying > 0 ? Varying : 1][W];
+            alignas(32) float base[3][W];
+            alignas(32) float invW[3][W];
+            const Texture *textures[W];
+            for (int l = 0; l < W; ++l)
+            {
+                const uint32_t id = idPtr[l];
+                if (id == 0)
+                {
+                    for (auto &plane : planes) plane[l] = 0.0f;
+                    for (auto &vertex : invW) vertex[l] = 1.0f;
+                    textures[l] = nullptr;
+                    for (auto &vertex : vertexVaryings)
+                    {
+                        for (auto &varying : vertex) varying[l] = 0.0f;
+                    }
+                    for (auto &channel : base) channel[l] = 0.0f;
+                    continue;
+                }
+
+                const TriangleSetup &setup = setups[id - 1];
+                const ScreenTriangle &tri = triangles[id - 1];
+                planes[0][l] = setup.a0; planes[1][l] = setup.b0; planes[2][l] = setup.c0;
+                planes[3][l] = setup.a1; planes[4][l] = setup.b1; planes[5][l] = setup.c1;
+                for (int v = 0; v < ShadedVertices; ++v)
+                {
+                    for (int k = 0; k < Varying; ++k)
+                    {
+                        vertexVaryings[v][k][l] = tri.varyings[v][k];
+                    }
+                }
+                base[0][l] = static_cast<float>(tri.baseColor & 0x000000FF);
+                base[1][l] = static_cast<float>((tri.baseColor & 0x0000FF00) >> 8);
+                base[2][l] = static_cast<float>((tri.baseColor & 0x00FF0000) >> 16);
+                for (int v = 0; v < 3; ++v) invW[v][l] = tri.invW[v];
+                textures[l] = tri.texture;
+            }
+
+            // Light visibility from the final depth.
+            SimdLighting pixelLighting = lighting;
+            if (FS::bUsesShadow && lighting.shadowMap)
+            {
+                using Codec = DepthCodec<Format>;
+                const Codec codec(target.bReverseZ);
+                alignas(32) typename Codec::Storage depth[W] = {};
+                std::copy_n(static_cast<const typename Codec::Storage *>(target.depth) +
+                            GetRowOffset(target, y, target.width) + column, laneCount, depth);
+                pixelLighting.visibility = lighting.shadowMap->GetVisibility(
+                    Float::Broadcast(static_cast<float>(x) + 0.5f) + laneX, pixelY, codec.Decode(codec.Load(depth)));
+            }
+
+            // Barycentrics at the pixel centers, then the same shading as the forward path.
+            const ColorLanes baseLanes{Float::Load(base[0]), Float::Load(base[1]), Float::Load(base[2])};
+            Varyings<Varying> varyings;
+            Int color;
+            if constexpr (FS::bTextured)
+            {
+                const Float pixelX = Float::Broadcast(static_cast<float>(x) + 0.5f) + laneX;
+                const Float a0 = Float::Load(planes[0]), b0 = Float::Load(planes[1]);
+                const Float a1 = Float::Load(planes[3]), b1 = Float::Load(planes[4]);
+                const Float w0 = a0 * pixelX + b0 * pixelY + Float::Load(planes[2]);
+                const Float w1 = a1 * pixelX + b1 * pixelY + Float::Load(planes[5]);
+                const Float w2 = Float::Broadcast(1.0f) - w0 - w1;
+                Float laneInvW[3];
+                Varyings<Varying> overW[3];
+                for (int v = 0; v < 3; ++v)
+                {
+                    laneInvW[v] = Float::Load(invW[v]);
+                    for (int k = 0; k < Varying; ++k) overW[v][k] = Float::Load(vertexVaryings[v][k]) * laneInvW[v];
+                }
+                TexcoordDerivatives derivatives;
+                InterpolatePerspective<Varying>(w0, w1, w2, overW, laneInvW, a0, b0, a1, b1, varyings, derivatives);
+
+                // One shading pass per distinct texture among the visible lanes.
+                alignas(32) uint32_t slots[W];
+                const Texture *slotTextures[W];
+                int slotCount = 0;
+                for (int l = 0; l < W; ++l)
+                {
+                    int slot = 0;
+                    if (idPtr[l] == 0)
+                    {
+                        slots[l] = 0;
+                        continue;
+                    }
+                    while (slot < slotCount && slotTextures[slot] != textures[l]) ++slot;
+                    if (slot == slotCount) slotTextures[slotCount++] = textures[l];
+                    slots[l] = static_cast<uint32_t>(slot);
+                }
+                const Int laneSlots = Int::Load(slots);
+                color = Int::Broadcast(0);
+                for (int slot = 0; slot < slotCount; ++slot)
+                {
+                    const Mask slotLanes = visible & (laneSlots == Int::Broadcast(static_cast<uint32_t>(slot)));
+                    const Int shaded = FS::Shade(varyings, derivatives, slotTextures[slot], slotLanes, baseLanes,
+                                                 pixelLighting);
+                    color = slotCount == 1 ? shaded : Select(slotLanes, shaded, color);
+                }
+            }
+            else if constexpr (FS::bFlat)
+            {
+                for (int k = 0; k < Varying; ++k)
+                {
+                    varyings[k] = Float::Load(vertexVaryings[0][k]);
+                }
+            }
+            else
+            {
+                const Float pixelX = Float::Broadcast(static_cast<float>(x) + 0.5f) + laneX;
+                const Float w0 = Float::Load(planes[0]) * pixelX + Float::Load(planes[1]) * pixelY + Float::Load(planes[2]);
+                const Float w1 = Float::Load(planes[3]) * pixelX + Float::Load(planes[4]) * pixelY + Float::Load(planes[5]);
+                const Float w2 = Float::Broadcast(1.0f) - w0 - w1;
+                for (int k = 0; k < Varying; ++k)
+                {
+                    varyings[k] = w0 * Float::Load(vertexVaryings[0][k]) + w1 * Float::Load(vertexVaryings[1][k]) +
+                                  w2 * Float::Load(vertexVaryings[2][k]);
+                }
+            }
+            if constexpr (!FS::bTextured) color = FS::Shade(varyings, baseLanes, pixelLighting);
+
+            Select(visible, color, Int::Load(colorPtr)).Store(colorPtr);
+            // Shaded once; the next flush starts from an empty buffer.
+            Int::Broadcast(0).Store(idPtr);
+
+            if (laneCount < W)
+            {
+                std::copy_n(idScratch, laneCount, idRow + column);
+                std::copy_n(colorScratch, laneCount, colorRow + column);
+            }
+        }
+    }
+}
+
+void ResolveSamples(const RenderTarget &target, JobSystem &jobs)
+{
+    using Simd::Int;
+    using Simd::Mask;
+    constexpr int W = Simd::Width;
+    static_assert(MsaaSamples == 4, "The resolve divides by shifting.");
+
+    jobs.ParallelFor(target.height, [&](const uint32_t y, uint32_t)
+    {
+        // Two channels per 32-bit lane at a time; four samples of 255 plus rounding fit in 16 bits.
+        const Int channelMask = Int::Broadcast(0x00FF00FF);
+        const Int round = Int::Broadcast(0x00020002);
+        const Int zero = Int::Broadcast(0);
+        const uint32_t *uniformRow = target.sampleUniform + static_cast<size_t>(y) * target.samplePitch;
+        uint32_t *colorRow = target.color + GetRowOffset(target, static_cast<int>(y), target.colorPitch);
+
+        for (uint32_t x = 0; x < target.width; x += W)
+        {
+            const uint32_t *span = target.sampleColor + GetSampleSpanOffset(target, static_cast<int>(x),
+                                                                            static_cast<int>(y));
+            const Int first = Int::Load(span);
+            const Mask uniform = Int::Load(uniformRow + x) != zero;
+            Int resolved = first;
+            if (!uniform.All())
+            {
+                Int low = round;
+                Int high = round;
+                for (int s = 0; s < MsaaSamples; ++s)
+                {
+                    const Int sample = Int::Load(span + s * W);
+                    low = low + (sample & channelMask);
+                    high = high + (sample.ShiftRight<8>() & channelMask);
+                }
+                const Int average = (low.ShiftRight<2>() & channelMask) |
+                                    (high.ShiftRight<2>() & channelMask).ShiftLeft<8>();
+                resolved = Select(uniform, first, average);
+            }
+
+            // A linear color plane has no padding lanes; the last span of a row may be short.
+            uint32_t *colorPtr = colorRow + GetColumnOffset(target, static_cast<int>(x));
+            if (x + W <= target.width || target.tilesX != 0)
+            {
+                resolved.Store(colorPtr);
+            }
+            else
+            {
+                alignas(32) uint32_t lanes[W];
+                resolved.Store(lanes);
+                std::copy_n(lanes, target.width - x, colorPtr);
+            }
+        }
+    });
+}
+
+void RasterizeDepthOnly(const RenderTarget &target, const TileRect &rect, const ScreenTriangle &tri,
+                        const SimdLighting &)
+{
+    using Simd::Float;
+    using Simd::Mask;
+    constexpr int W = Simd::Width;
+
+    const TileRect bounds = ComputeBounds(tri);
+    const int minX = std::max(rect.minX, bounds.minX);
+    const int maxX = std::min(rect.maxX, bounds.maxX);
+    const int minY = std::max(rect.minY, bounds.minY);
+    const int maxY = std::min(rect.maxY, bounds.maxY);
+    if (minX > maxX || minY > maxY) return;
+
+    const Math::Vector3 &s0 = tri.s[0];
+    const Math::Vector3 &s1 = tri.s[1];
+    const Math::Vector3 &s2 = tri.s[2];
+    const float area = (s0.x * (s1.y - s2.y) + (s2.x - s1.x) * s0.y + s1.x * s2.y - s2.x * s1.y);
+    if (!(std::abs(area) > 0.0f)) return;
+    const float invArea = 1.0f / area;
+
+    // Same planes as RasterizeTriangleImpl.
+    const float a0 = (s1.y - s2.y) * invArea;
+    const float b0 = (s2.x - s1.x) * invArea;
+    const float c0 = (s1.x * s2.y - s2.x * s1.y) * invArea;
+    const float a1 = (s2.y - s0.y) * invArea;
+    const float b1 = (s0.x - s2.x) * invArea;
+    const float c1 = (s2.x * s0.y - s0.x * s2.y) * invArea;
+    const float a2 = -a0 - a1, b2 = -b0 - b1;
+    const float az = a1 * (s1.z - s0.z) + a2 * (s2.z - s0.z);
+    const float bz = b1 * (s1.z - s0.z) + b2 * (s2.z - s0.z);
+    const float cz = s0.z - az * s0.x - bz * s0.y;
+
+    const Float zero = Float::Broadcast(0.0f);
+    const Float one = Float::Broadcast(1.0f);
+    const Float laneX = Float::Ramp();
+    const Float planeA0 = Float::Broadcast(a0), planeA1 = Float::Broadcast(a1), planeAz = Float::Broadcast(az);
+    const Float stepX = Float::Broadcast(static_cast<float>(W));
+    const Float rectMin = Float::Broadcast(static_cast<float>(minX));
+    const Float rectEnd = Float::Broadcast(static_cast<float>(maxX + 1));
+    // rect.minX is a multiple of the tile size, so spans never start left of the rect.
+    const int startX = minX & ~(W - 1);
+
+    const float a[3] = {a0, a1, a2};
+    for (int y = minY; y <= maxY; ++y)
+    {
+        const float pixelY = static_cast<float>(y) + 0.5f;
+        const float rowC[3] = {b0 * pixelY + c0, b1 * pixelY + c1, b2 * pixelY + 1.0f - c0 - c1};
+
+        // Pixel centers inside all three edges form one interval of the row; only the spans
+        // overlapping it are tested (the mask below stays exact).
+        float spanMin = static_cast<float>(minX), spanMax = static_cast<float>(maxX) + 1.0f;
+        for (int e = 0; e < 3; ++e)
+        {
+            if (a[e] > 0.0f) spanMin = std::max(spanMin, -rowC[e] / a[e] - 1.0f);
+            else if (a[e] < 0.0f) spanMax = std::min(spanMax, -rowC[e] / a[e] + 1.0f);
+            else if (rowC[e] < 0.0f) spanMax = -1.0f;
+        }
+        if (spanMin > spanMax) continue;
+        const int rowStartX = std::max(startX, static_cast<int>(spanMin) & ~(W - 1));
+        const int rowEndX = std::min(maxX, static_cast<int>(spanMax));
+
+        const Float rowC0 = Float::Broadcast(rowC[0]);
+        const Float rowC1 = Float::Broadcast(rowC[1]);
+        const Float rowCz = Float::Broadcast(bz * pixelY + cz);
+        float *depthRow = static_cast<float *>(target.depth) + GetRowOffset(target, y, target.width);
+
+        Float pixelX = Float::Broadcast(static_cast<float>(rowStartX) + 0.5f) + laneX;
+        for (int x = rowStartX; x <= rowEndX; x += W, pixelX += stepX)
+        {
+            const Float w0 = planeA0 * pixelX + rowC0;
+            const Float w1 = planeA1 * pixelX + rowC1;
+            Mask covered = (w0 >= zero) & (w1 >= zero) & (one - w0 - w1 >= zero);
+            if (x < minX || x + W - 1 > maxX)
+            {
+                covered = covered & (pixelX >= rectMin) & (rectEnd > pixelX);
+            }
+            if (!covered.Any()) continue;
+
+            const Float depth = planeAz * pixelX + rowCz;
+            float *depthPtr = depthRow + GetColumnOffset(target, x);
+            if (x + W - 1 <= rect.maxX)
+            {
+                const Float oldDepth = Float::Load(depthPtr);
+                Select(covered & (depth < oldDepth), depth, oldDepth).Store(depthPtr);
+                continue;
+            }
+
+            // The span reaches past the rect (another tile or the row end): only touch our lanes.
+            alignas(32) float lanes[W] = {};
+            const int laneEnd = rect.maxX + 1 - x;
+            std::copy_n(depthPtr, laneEnd, lanes);
+            const Float oldDepth = Float::Load(lanes);
+            Select(covered & (depth < oldDepth), depth, oldDepth).Store(lanes);
+            std::copy_n(lanes, laneEnd, depthPtr);
+        }
+    }
+}
+
+void DetileColor(const RenderTarget &target, uint32_t *outColor, const uint32_t outPitch, JobSystem &jobs)
+{
+    using Simd::Int;
+    constexpr int W = Simd::Width;
+    static_assert(HiZBlockSize % W == 0);
+
+    jobs.ParallelFor(target.height, [&](const uint32_t y, uint32_t)
+    {
+        const uint32_t *tiledRow = target.color + GetRowOffset(target, static_cast<int>(y), target.colorPitch);
+        uint32_t *linearRow = outColor + static_cast<size_t>(y) * outPitch;
+        uint32_t x = 0;
+        // Each tile contributes HiZBlockSize contiguous pixels to the row.
+        for (; x + HiZBlockSize <= target.width; x += HiZBlockSize)
+        {
+            const uint32_t *src = tiledRow + GetColumnOffset(target, static_cast<int>(x));
+            for (int i = 0; i < HiZBlockSize; i += W)
+            {
+                Int::Load(src + i).Store(linearRow + x + i);
+            }
+        }
+        if (x < target.width)
+        {
+            std::copy_n(tiledRow + GetColumnOffset(target, static_cast<int>(x)), target.width - x, linearRow + x);
+        }
+    });
+}
+
+// One instantiation per fragment shader of Shaders.h and depth format.
+#define INSTANTIATE_FRAGMENT_SHADER_FORMAT(FS, Format) \
+    template void RasterizeTriangle<FS, Format>(const RenderTarget &, const TileRect &, const ScreenTriangle &, \
+                                                const SimdLighting &); \
+    template void RasterizeTriangleMultisample<FS, Format>(const RenderTarget &, const TileRect &, \
+                                                           const ScreenTriangle &, const SimdLighting &); \
+    template void ShadeVisibility<FS, Format>(const RenderTarget &, const TileRect &, const ScreenTriangle *, \
+                                              const TriangleSetup *, const SimdLighting &);
+#define INSTANTIATE_FRAGMENT_SHADER(FS) \
+    INSTANTIATE_FRAGMENT_SHADER_FORMAT(FS, DepthFormat::Float32) \
+    INSTANTIATE_FRAGMENT_SHADER_FORMAT(FS, DepthFormat::Unorm24) \
+    INSTANTIATE_FRAGMENT_SHADER_FORMAT(FS, DepthFormat::Unorm16)
+
+INSTANTIATE_FRAGMENT_SHADER(DepthOnlyFS)
+INSTANTIATE_FRAGMENT_SHADER(FlatFS)
+INSTANTIATE_FRAGMENT_SHADER(GouraudFS)
+INSTANTIATE_FRAGMENT_SHADER(PhongFS)
+INSTANTIATE_FRAGMENT_SHADER(TexturedFS)
+
+#undef INSTANTIATE_FRAGMENT_SHADER
+#undef INSTANTIATE_FRAGMENT_SHADER_FORMAT
+
+template void RasterizeTriangleId<DepthFormat::Float32>(const RenderTarget &, const TileRect &,
+                                                        const ScreenTriangle &, uint32_t);
+template void RasterizeTriangleId<DepthFormat::Unorm24>(const RenderTarget &, const TileRect &,
+                                                        const ScreenTriangle &, uint32_t);
+template void RasterizeTriangleId<DepthFormat::Unorm16>(const RenderTarget &, const TileRect &,
+                                                        const ScreenTriangle &, uint32_t);
+
+void TileRasterizer::Resize(const uint32_t inWidth, const uint32_t inHeight)
+{
+    width = inWidth;
+    height = inHeight;
+    tilesX = (width + TileSize - 1) / TileSize;
+    tilesY = (height + TileSize - 1) / TileSize;
+}
+
+void TileRasterizer::BeginFrame(FrameArena &inArena)
+{
+    arena = &inArena;
+    triangleCount = 0;
+    triangleCapacity = peakTriangles;
+    triangles = triangleCapacity > 0 ? inArena.Get().Allocate<ScreenTriangle>(triangleCapacity) : nullptr;
+}
+
+void TileRasterizer::GrowTriangles()
+{
+    const size_t capacity = std::max<size_t>(2 * triangleCapacity, 1024);
+    ScreenTriangle *grown = arena->Get().Allocate<ScreenTriangle>(capacity);
+    std::copy_n(triangles, triangleCount, grown);
+    triangles = grown;
+    triangleCapacity = capacity;
+}
+
+size_t TileRasterizer::GetFlushBytesPerThread() const
+{
+    return static_cast<size_t>(tilesX) * tilesY * (sizeof(Bin) + sizeof(BinChunk));
+}
+
+TileRect TileRasterizer::GetTileRect(const uint32_t tileIndex) const
+{
+    const int tx = static_cast<int>(tileIndex % tilesX);
+    const int ty = static_cast<int>(tileIndex / tilesX);
+
+    TileRect rect;
+    rect.minX = tx * TileSize;
+    rect.minY = ty * TileSize;
+    rect.maxX = std::min(rect.minX + TileSize, static_cast<int>(width)) - 1;
+    rect.maxY = std::min(rect.minY + TileSize, static_cast<int>(height)) - 1;
+    return rect;
+}
+
+void TileRasterizer::Flush(const RenderTarget &target, JobSystem &jobs, const RasterPipeline &pipeline)
+{
+    if (triangleCount == 0 || tilesX == 0 || tilesY == 0) return;
+    PROFILE_SCOPE("Rasterize");
+    peakTriangles = std::max(peakTriangles, triangleCount);
+
+    const uint32_t sliceCount = jobs.GetThreadCount();
+    const uint32_t tileCount = tilesX * tilesY;
+
+    // Binning: each slice walks a contiguous range of triangles, so concatenating
+    // the slices per tile keeps submission order.
+    const auto count = static_cast<uint32_t>(triangleCount);
+    const bool bVisibility = target.visibility != nullptr;
+    const bool bMultisample = target.sampleDepth != nullptr;
+    TriangleSetup *setups = bVisibility ? arena->Get().Allocate<TriangleSetup>(count) : nullptr;
+    // bins[slice][tile]: each slice's table and chunks come from the arena of the thread running it.
+    Bin **bins = arena->Get().Allocate<Bin *>(sliceCount);
+    jobs.ParallelFor(sliceCount, [&](const uint32_t slice, const uint32_t threadIndex)
+    {
+        PROFILE_SCOPE("Bin");
+        LinearArena &local = arena->Get(threadIndex);
+        Bin *sliceBins = local.Allocate<Bin>(tileCount);
+        std::fill_n(sliceBins, tileCount, Bin{nullptr, nullptr});
+        bins[slice] = sliceBins;
+
+        const uint32_t begin = static_cast<uint64_t>(count) * slice / sliceCount;
+        const uint32_t end = static_cast<uint64_t>(count) * (slice + 1) / sliceCount;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const TileRect bounds = ComputeBounds(triangles[i]);
+            const int minX = std::max(0, bounds.minX);
+            const int maxX = std::min(static_cast<int>(width) - 1, bounds.maxX);
+            const int minY = std::max(0, bounds.minY);
+            const int maxY = std::min(static_cast<int>(height) - 1, bounds.maxY);
+            if (minX > maxX || minY > maxY) continue;
+            if (bVisibility) setups[i] = ComputeTriangleSetup(triangles[i]);
+
+            for (int ty = minY / TileSize; ty <= maxY / TileSize; ++ty)
+            {
+                for (int tx = minX / TileSize; tx <= maxX / TileSize; ++tx)
+                {
+                    Bin &bin = sliceBins[ty * tilesX + tx];
+                    if (bin.last == nullptr || bin.last->count == BinChunkSize)
+                    {
+                        BinChunk *chunk = local.Allocate<BinChunk>(1);
+                        chunk->count = 0;
+                        chunk->next = nullptr;
+                        (bin.last ? bin.last->next : bin.first) = chunk;
+                        bin.last = chunk;
+                    }
+                    bin.last->indices[bin.last->count++] = i;
+                }
+            }
+        }
+    });
+
+    // Raster: one tile per job, no two threads ever touch the same pixel.
+    jobs.ParallelFor(tileCount, [&](const uint32_t tile, uint32_t)
+    {
+        const TileRect rect = GetTileRect(tile);
+        const SimdLighting lighting(pipeline.lighting);
+        {
+            PROFILE_SCOPE("Raster Tile");
+            for (uint32_t slice = 0; slice < sliceCount; ++slice)
+            {
+                for (const BinChunk *chunk = bins[slice][tile].first; chunk; chunk = chunk->next)
+                {
+                    for (uint32_t k = 0; k < chunk->count; ++k)
+                    {
+                        const uint32_t i = chunk->indices[k];
+                        if (bVisibility)
+                        {
+                            pipeline.rasterizeId(target, rect, triangles[i], i);
+                        }
+                        else if (bMultisample)
+                        {
+                            pipeline.rasterizeMultisample(target, rect, triangles[i], lighting);
+                        }
+                        else
+                        {
+                            pipeline.rasterize(target, rect, triangles[i], lighting);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (bVisibility)
+        {
+            PROFILE_SCOPE("Shade Tile");
+            pipeline.shadeVisibility(target, rect, triangles, setups, lighting);
+        }
+    });
+
+    triangleCount = 0;
+}
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+
+#include "../Include/Scene.h"
+#include "../Include/MeshletBuilder.h"
+
+static Bounds MergeBounds(const Bounds& inA, const Bounds& inB)
+{
+    return {
+        {std::min(inA.min.x, inB.min.x), std::min(inA.min.y, inB.min.y), std::min(inA.min.z, inB.min.z)},
+        {std::max(inA.max.x, inB.max.x), std::max(inA.max.y, inB.max.y), std::max(inA.max.z, inB.max.z)}
+    };
+}
+
+Frustum Frustum::FromViewProjection(const Math::Matrix44& inViewProj)
+{
+    // Row r of the column-major matrix.
+    const auto row = [&](const int r) -> Math::Vector4
+    {
+        return {inViewProj.data[r], inViewProj.data[4 + r], inViewProj.data[8 + r], inViewProj.data[12 + r]};
+    };
+    const auto add = [](const Math::Vector4& a, const Math::Vector4& b) -> Math::Vector4
+    {
+        return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+    };
+    const auto sub = [](const Math::Vector4& a, const Math::Vector4& b) -> Math::Vector4
+    {
+        return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+    };
+
+    const Math::Vector4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+    // -w <= x <= w, -w <= y <= w, 0 <= z <= w.
+    Frustum frustum;
+    frustum.planes[0] = add(r3, r0);
+    frustum.planes[1] = sub(r3, r0);
+    frustum.planes[2] = add(r3, r1);
+    frustum.planes[3] = sub(r3, r1);
+    frustum.planes[4] = r2;
+    frustum.planes[5] = sub(r3, r2);
+    for (Math::Vector4& plane : frustum.planes)
+    {
+        const float invLength = 1.0f / std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = {plane.x * invLength, plane.y * invLength, plane.z * invLength, plane.w * invLength};
+    }
+    return frustum;
+}
+
+Math::Vector3 GetViewPosition(const Math::Matrix44& inView)
+{
+    // view * eye = origin: eye = -R^T t.
+    const auto& v = inView.data;
+    return {
+        -(v[0] * v[12] + v[1] * v[13] + v[2] * v[14]),
+        -(v[4] * v[12] + v[5] * v[13] + v[6] * v[14]),
+        -(v[8] * v[12] + v[9] * v[13] + v[10] * v[14])
+    };
+}
+
+FrustumTest TestBounds(const Frustum& inFrustum, const Bounds& inBounds)
+{
+    const Math::Vector3 center = (inBounds.min + inBounds.max) * 0.5f;
+    const Math::Vector3 extent = (inBounds.max - inBounds.min) * 0.5f;
+
+    FrustumTest result = FrustumTest::Inside;
+    for (const Math::Vector4& plane : inFrustum.planes)
+    {
+        // Signed distance of the center and the box's projected radius.
+        const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        const float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+        if (distance + radius < 0.0f) return FrustumTest::Outside;
+        if (distance - radius < 0.0f) result = FrustumTest::Intersects;
+    }
+    return result;
+}
+
+bool IsSphereOutside(const Frustum& inFrustum, const Math::Vector3& inCenter, const float inRadius)
+{
+    for (const Math::Vector4& plane : inFrustum.planes)
+    {
+        if (plane.x * inCenter.x + plane.y * inCenter.y + plane.z * inCenter.z + plane.w < -inRadius) return true;
+    }
+    return false;
+}
+
+Bounds TransformBounds(const Bounds& inBounds, const Math::Matrix44& inMatrix)
+{
+    const Math::Vector3 center = (inBounds.min + inBounds.max) * 0.5f;
+    const Math::Vector3 extent = (inBounds.max - inBounds.min) * 0.5f;
+    const auto& m = inMatrix.data;
+
+    // Center goes through the full transform, the extent through |M| (Arvo).
+    const Math::Vector4 transformed = Math::Matrix44::TransformPoint(inMatrix, center);
+    const Math::Vector3 newCenter{transformed.x, transformed.y, transformed.z};
+    const Math::Vector3 newExtent{
+        std::abs(m[0]) * extent.x + std::abs(m[4]) * extent.y + std::abs(m[8]) * extent.z,
+        std::abs(m[1]) * extent.x + std::abs(m[5]) * extent.y + std::abs(m[9]) * extent.z,
+        std::abs(m[2]) * extent.x + std::abs(m[6]) * extent.y + std::abs(m[10]) * extent.z
+    };
+    return {newCenter - newExtent, newCenter + newExtent};
+}
+
+void CullMeshlets(const MeshletBuffers& inClusters, const Math::Matrix44& inModel, const Frustum& inFrustum,
+                  const Math::Vector3& inEye, const bool bInConeCull, std::vector<uint32_t>& outVisible,
+                  MeshletStats& outStats)
+{
+    const auto& m = inModel.data;
+    const float scale = std::sqrt(std::max({
+        m[0] * m[0] + m[1] * m[1] + m[2] * m[2],
+        m[4] * m[4] + m[5] * m[5] + m[6] * m[6],
+        m[8] * m[8] + m[9] * m[9] + m[10] * m[10]
+    }));
+
+    for (uint32_t i = 0; i < inClusters.meshlets.size(); ++i)
+    {
+        const Meshlet& meshlet = inClusters.meshlets[i];
+        const Math::Vector4 transformed = Math::Matrix44::TransformPoint(inModel, meshlet.center);
+        const Math::Vector3 center{transformed.x, transformed.y, transformed.z};
+        const float radius = meshlet.radius * scale;
+        if (IsSphereOutside(inFrustum, center, radius))
+        {
+            ++outStats.frustumCulled;
+            continue;
+        }
+
+        if (bInConeCull && meshlet.coneCutoff < 1.0f)
+        {
+            // Scale divides out: |axis| = scale for a uniformly scaled rotation.
+            const Math::Vector3 axis = Math::Matrix44::TransformVector(inModel, meshlet.coneAxis);
+            const Math::Vector3 toCenter = center - inEye;
+            if (Math::Vector3::Dot(toCenter, axis) >= (meshlet.coneCutoff * toCenter.Length() + radius) * scale)
+            {
+                ++outStats.backFaceCulled;
+                continue;
+            }
+        }
+
+        outVisible.push_back(i);
+        ++outStats.meshletsVisible;
+    }
+}
+
+MeshHandle Scene::AddMesh(Mesh inMesh)
+{
+    if (inMesh.clusters.meshlets.empty() && !inMesh.indices.empty())
+    {
+        BuildMeshlets(inMesh);
+    }
+    meshes.push_back(std::move(inMesh));
+    return static_cast<MeshHandle>(meshes.size() - 1);
+}
+
+uint32_t Scene::AddInstance(const MeshHandle inMesh, const Math::Matrix44& inModel, const uint32_t inBaseColor,
+                            const Texture* inTexture)
+{
+    Instance instance;
+    instance.mesh = inMesh;
+    instance.model = inModel;
+    instance.baseColor = inBaseColor;
+    instance.texture = inTexture;
+    instance.worldBounds = TransformBounds(meshes[inMesh].bounds, inModel);
+    instances.push_back(instance);
+    bBvhNeedsBuild = true;
+    ++revision;
+    return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void Scene::SetTransform(const uint32_t inInstance, const Math::Matrix44& inModel)
+{
+    Instance& instance = instances[inInstance];
+    if (instance.model.data == inModel.data) return;
+    instance.model = inModel;
+    instance.worldBounds = TransformBounds(meshes[instance.mesh].bounds, inModel);
+    bBvhNeedsRefit = true;
+    ++revision;
+}
+
+void Scene::Clear()
+{
+    meshes.clear();
+    instances.clear();
+    nodes.clear();
+    bvhInstances.clear();
+    bBvhNeedsBuild = false;
+    bBvhNeedsRefit = false;
+    ++revision;
+}
+
+Bounds Scene::GetBounds() const
+{
+    if (instances.empty()) return {};
+    Bounds bounds = instances[0].worldBounds;
+    for (const Instance& instance : instances)
+    {
+        bounds = MergeBounds(bounds, instance.worldBounds);
+    }
+    return bounds;
+}
+
+void Scene::UpdateBvh()
+{
+    if (bBvhNeedsBuild)
+    {
+        BuildBvh();
+    }
+    else if (bBvhNeedsRefit)
+    {
+        RefitBvh();
+    }
+    bBvhNeedsBuild = false;
+    bBvhNeedsRefit = false;
+}
+
+void Scene::BuildBvh()
+{
+    nodes.clear();
+    bvhInstances.resize(instances.size());
+    for (uint32_t i = 0; i < bvhInstances.size(); ++i)
+    {
+        bvhInstances[i] = i;
+    }
+    if (instances.empty()) return;
+
+    nodes.reserve(2 * instances.size());
+    nodes.emplace_back();
+    BuildNode(0, 0, static_cast<uint32_t>(instances.size()));
+}
+
+void Scene::BuildNode(const uint32_t inNode, const uint32_t inBegin, const uint32_t inEnd)
+{
+    // nodes may reallocate below; address the node by index.
+    nodes[inNode].first = inBegin;
+    nodes[inNode].instanceCount = inEnd - inBegin;
+
+    Bounds bounds = instances[bvhInstances[inBegin]].worldBounds;
+    Bounds centroids{bounds.min + bounds.max, bounds.min + bounds.max};
+    for (uint32_t i = inBegin + 1; i < inEnd; ++i)
+    {
+        const Bounds& instanceBounds = instances[bvhInstances[i]].worldBounds;
+        bounds = MergeBounds(bounds, instanceBounds);
+        const Math::Vector3 centroid = instanceBounds.min + instanceBounds.max;
+        centroids = MergeBounds(centroids, {centroid, centroid});
+    }
+    nodes[inNode].bounds = bounds;
+    if (inEnd - inBegin <= MaxLeafInstances) return;
+
+    // Median split along the longest axis of the centroids (stored doubled, which does not
+    // change the order).
+    const Math::Vector3 size = centroids.max - centroids.min;
+    const int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+    const auto key = [&](const uint32_t instance)
+    {
+        const Bounds& b = instances[instance].worldBounds;
+        return axis == 0 ? b.min.x + b.max.x : (axis == 1 ? b.min.y + b.max.y : b.min.z + b.max.z);
+    };
+    const uint32_t middle = inBegin + (inEnd - inBegin) / 2;
+    std::nth_element(bvhInstances.begin() + inBegin, bvhInstances.begin() + middle, bvhInstances.begin() + inEnd,
+                     [&](const uint32_t a, const uint32_t b) { return key(a) < key(b); });
+
+    // Siblings are adjacent, children always come after their parent.
+    const auto left = static_cast<uint32_t>(nodes.size());
+    nodes[inNode].child = left;
+    nodes.emplace_back();
+    nodes.emplace_back();
+    BuildNode(left, inBegin, middle);
+    BuildNode(left + 1, middle, inEnd);
+}
+
+void Scene::RefitBvh()
+{
+    // Children come after their parent, so a reverse walk visits them first.
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it)
+    {
+        BvhNode& node = *it;
+        if (node.child != 0)
+        {
+            node.bounds = MergeBounds(nodes[node.child].bounds, nodes[node.child + 1].bounds);
+            continue;
+        }
+        node.bounds = instances[bvhInstances[node.first]].worldBounds;
+        for (uint32_t i = node.first + 1; i < node.first + node.instanceCount; ++i)
+        {
+            node.bounds = MergeBounds(node.bounds, instances[bvhInstances[i]].worldBounds);
+        }
+    }
+}
+
+void Scene::Cull(const Frustum& inFrustum, std::vector<uint32_t>& outVisible, SceneStats& outStats)
+{
+    UpdateBvh();
+    if (nodes.empty()) return;
+
+    const size_t firstVisible = outVisible.size();
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const BvhNode& node = nodes[stack[--stackSize]];
+        ++outStats.nodesTested;
+
+        const FrustumTest test = TestBounds(inFrustum, node.bounds);
+        if (test == FrustumTest::Outside) continue;
+
+        if (node.child == 0 || test == FrustumTest::Inside)
+        {
+            // Leaf, or a subtree entirely inside: take its whole instance range.
+            outVisible.insert(outVisible.end(), bvhInstances.begin() + node.first,
+                              bvhInstances.begin() + node.first + node.instanceCount);
+            continue;
+        }
+        stack[stackSize++] = node.child + 1;
+        stack[stackSize++] = node.child;
+    }
+
+    // Group by mesh, keeping instance order within a mesh.
+    std::sort(outVisible.begin() + static_cast<std::ptrdiff_t>(firstVisible), outVisible.end(),
+              [&](const uint32_t a, const uint32_t b)
+              {
+                  return instances[a].mesh != instances[b].mesh ? instances[a].mesh < instances[b].mesh : a < b;
+              });
+
+    const size_t visibleCount = outVisible.size() - firstVisible;
+    outStats.instancesVisible += visibleCount;
+    outStats.instancesCulled += instances.size() - visibleCount;
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "../Include/ShadowMap.h"
+
+void ShadowMap::Resize(const uint32_t inSize)
+{
+    size = inSize;
+    depth.assign(static_cast<size_t>(size) * size, 1.0f);
+    if (size == 0) depth.shrink_to_fit();
+    bDrawn = false;
+}
+
+void ShadowMap::SetViewer(const Math::Matrix44& inViewProj, const uint32_t inWidth, const uint32_t inHeight,
+                          const bool bReverseZ)
+{
+    // Screen pixels back to NDC (inverse of ViewportTransform).
+    Math::Matrix44 screenToNdc = Math::Matrix44::Identity();
+    screenToNdc.data[0] = 2.0f / static_cast<float>(inWidth);
+    screenToNdc.data[5] = -2.0f / static_cast<float>(inHeight);
+    screenToNdc.data[10] = bReverseZ ? -1.0f : 1.0f;
+    screenToNdc.data[12] = -1.0f;
+    screenToNdc.data[13] = 1.0f;
+
+    // Light NDC to texels, y down like the depth pass.
+    const auto texels = static_cast<float>(size);
+    Math::Matrix44 ndcToTexel = Math::Matrix44::Identity();
+    ndcToTexel.data[0] = 0.5f * texels;
+    ndcToTexel.data[5] = -0.5f * texels;
+    ndcToTexel.data[12] = 0.5f * texels;
+    ndcToTexel.data[13] = 0.5f * texels;
+
+    const Math::Matrix44 ndcToWorld = Math::Matrix44::Inverse(inViewProj);
+    screenToShadow = Math::Matrix44::Multiply(
+        ndcToTexel, Math::Matrix44::Multiply(lightViewProj, Math::Matrix44::Multiply(ndcToWorld, screenToNdc)));
+}
+
+bool ShadowMap::NeedsUpdate(const ShadowUpdate inUpdate, const uint64_t inSceneRevision) const
+{
+    if (size == 0) return false;
+    if (inUpdate == ShadowUpdate::EveryFrame || !bDrawn) return true;
+    return inSceneRevision != drawnRevision || lightViewProj.data != drawnLightViewProj.data;
+}
+
+void ShadowMap::BeginUpdate(const uint64_t inSceneRevision)
+{
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    drawnLightViewProj = lightViewProj;
+    drawnRevision = inSceneRevision;
+    bDrawn = true;
+    ++updateCount;
+}
+
+RenderTarget ShadowMap::GetRenderTarget()
+{
+    RenderTarget target;
+    target.depth = depth.data();
+    target.width = size;
+    target.height = size;
+    return target;
+}
+
+Simd::Float ShadowMap::GetVisibility(const Simd::Float& inX, const Simd::Float& inY, const Simd::Float& inDepth) const
+{
+    using Simd::Float;
+    constexpr int W = Simd::Width;
+    const Float one = Float::Broadcast(1.0f);
+    if (size == 0) return one;
+
+    const auto& m = screenToShadow.data;
+    const auto column = [&](const int c)
+    {
+        return inX * Float::Broadcast(m[c]) + inY * Float::Broadcast(m[4 + c]) + inDepth * Float::Broadcast(m[8 + c]) +
+               Float::Broadcast(m[12 + c]);
+    };
+    const Float invW = one / column(3);
+    alignas(32) float u[W], v[W];
+    (column(0) * invW).Store(u);
+    (column(1) * invW).Store(v);
+    const Float receiver = column(2) * invW;
+
+    // Texel of the center tap per lane; lanes off the map are never shadowed.
+    const int last = static_cast<int>(size) - 1;
+    int texelX[W], texelY[W];
+    bool bOutside[W];
+    for (int lane = 0; lane < W; ++lane)
+    {
+        bOutside[lane] = !(u[lane] >= 0.0f && u[lane] < static_cast<float>(size) && v[lane] >= 0.0f &&
+                           v[lane] < static_cast<float>(size));
+        texelX[lane] = bOutside[lane] ? 0 : static_cast<int>(u[lane]);
+        texelY[lane] = bOutside[lane] ? 0 : static_cast<int>(v[lane]);
+    }
+
+    // Per tap: fetch lane by lane (no gather), compare all lanes at once. Outer taps land
+    // further along a sloped receiver, so their bias grows with the distance.
+    Float lit = Float::Broadcast(0.0f);
+    alignas(32) float occluder[W];
+    for (int dy = -pcfRadius; dy <= pcfRadius; ++dy)
+    {
+        for (int dx = -pcfRadius; dx <= pcfRadius; ++dx)
+        {
+            for (int lane = 0; lane < W; ++lane)
+            {
+                const int x = std::clamp(texelX[lane] + dx, 0, last);
+                const int y = std::clamp(texelY[lane] + dy, 0, last);
+                occluder[lane] = bOutside[lane] ? 2.0f : depth[static_cast<size_t>(y) * size + x];
+            }
+            const Float bias = Float::Broadcast(depthBias * static_cast<float>(1 + std::max(std::abs(dx), std::abs(dy))));
+            lit += Simd::Select(Float::Load(occluder) >= receiver - bias, one, Float::Broadcast(0.0f));
+        }
+    }
+    const int side = 2 * pcfRadius + 1;
+    return lit * Float::Broadcast(1.0f / static_cast<float>(side * side));
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../Include/Texture.h"
+
+namespace
+{
+    constexpr uint32_t TileTexels = Texture::TileSize * Texture::TileSize;
+
+    // Morton index of (x, y) inside a 4x4 tile.
+    uint32_t GetTileMorton(const uint32_t inX, const uint32_t inY)
+    {
+        return (inX & 1) | ((inY & 1) << 1) | ((inX & 2) << 1) | ((inY & 2) << 2);
+    }
+
+    // 2x2 box filter, per channel. Odd edges repeat their last texel.
+    std::vector<uint32_t> Downsample(const std::vector<uint32_t>& inPixels, const uint32_t inWidth, const uint32_t inHeight,
+                                     const uint32_t inDstWidth, const uint32_t inDstHeight)
+    {
+        std::vector<uint32_t> result(static_cast<size_t>(inDstWidth) * inDstHeight);
+        for (uint32_t y = 0; y < inDstHeight; ++y)
+        {
+            const uint32_t y0 = std::min(y * 2, inHeight - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, inHeight - 1);
+            for (uint32_t x = 0; x < inDstWidth; ++x)
+            {
+                const uint32_t x0 = std::min(x * 2, inWidth - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, inWidth - 1);
+                const uint32_t taps[4] = {inPixels[y0 * inWidth + x0], inPixels[y0 * inWidth + x1],
+                                          inPixels[y1 * inWidth + x0], inPixels[y1 * inWidth + x1]};
+                uint32_t packed = 0;
+                for (uint32_t shift = 0; shift < 32; shift += 8)
+                {
+                    uint32_t sum = 2;
+                    for (const uint32_t tap : taps) sum += (tap >> shift) & 0xFF;
+                    packed |= (sum >> 2) << shift;
+                }
+                result[static_cast<size_t>(y) * inDstWidth + x] = packed;
+            }
+        }
+        return result;
+    }
+
+    Simd::Float Floor(const Simd::Float& inValue)
+    {
+        const Simd::Float truncated = Simd::ToFloat(Simd::Int::Truncate(inValue));
+        return Simd::Select(truncated > inValue, truncated - Simd::Float::Broadcast(1.0f), truncated);
+    }
+
+    // Bilinear blend of the four taps of one level, channels in [0, 255].
+    void Bilinear(const uint32_t* inTaps, const uint32_t inStride, const Simd::Float& inFx, const Simd::Float& inFy,
+                  Simd::Float (&outColor)[3])
+    {
+        const Simd::Int t00 = Simd::Int::Load(inTaps);
+        const Simd::Int t10 = Simd::Int::Load(inTaps + inStride);
+        const Simd::Int t01 = Simd::Int::Load(inTaps + inStride * 2);
+        const Simd::Int t11 = Simd::Int::Load(inTaps + inStride * 3);
+        const Simd::Int channelMask = Simd::Int::Broadcast(0xFF);
+        const auto channel = [&](const Simd::Int& inTexel, const int inChannel)
+        {
+            switch (inChannel)
+            {
+            case 0: return Simd::ToFloat(inTexel & channelMask);
+            case 1: return Simd::ToFloat(inTexel.ShiftRight<8>() & channelMask);
+            default: return Simd::ToFloat(inTexel.ShiftRight<16>() & channelMask);
+            }
+        };
+        for (int c = 0; c < 3; ++c)
+        {
+            const Simd::Float c00 = channel(t00, c);
+            const Simd::Float c10 = channel(t10, c);
+            const Simd::Float c01 = channel(t01, c);
+            const Simd::Float c11 = channel(t11, c);
+            const Simd::Float top = c00 + (c10 - c00) * inFx;
+            const Simd::Float bottom = c01 + (c11 - c01) * inFx;
+            outColor[c] = top + (bottom - top) * inFy;
+        }
+    }
+}
+
+Texture::Texture(const uint32_t* inPixels, const uint32_t inWidth, const uint32_t inHeight)
+{
+    if (!inPixels || inWidth == 0 || inHeight == 0) return;
+
+    std::vector<uint32_t> image(inPixels, inPixels + static_cast<size_t>(inWidth) * inHeight);
+    uint32_t width = inWidth;
+    uint32_t height = inHeight;
+    while (true)
+    {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = (width + TileSize - 1) / TileSize;
+        level.offset = texels.size();
+        const uint32_t tilesY = (height + TileSize - 1) / TileSize;
+        texels.resize(texels.size() + static_cast<size_t>(level.tilesX) * tilesY * TileTexels, 0);
+        levels.push_back(level);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                texels[GetTexelIndex(level, x, y)] = image[static_cast<size_t>(y) * width + x];
+            }
+        }
+
+        if (width == 1 && height == 1) break;
+        const uint32_t nextWidth = std::max(1u, width / 2);
+        const uint32_t nextHeight = std::max(1u, height / 2);
+        image = Downsample(image, width, height, nextWidth, nextHeight);
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+Texture Texture::CreateChecker(const uint32_t inSize, const uint32_t inCells, const uint32_t inColorA,
+                               const uint32_t inColorB)
+{
+    const uint32_t cellSize = std::max(1u, inSize / std::max(1u, inCells));
+    std::vector<uint32_t> pixels(static_cast<size_t>(inSize) * inSize);
+    for (uint32_t y = 0; y < inSize; ++y)
+    {
+        for (uint32_t x = 0; x < inSize; ++x)
+        {
+            pixels[static_cast<size_t>(y) * inSize + x] = ((x / cellSize + y / cellSize) & 1) ? inColorB : inColorA;
+        }
+    }
+    return Texture(pixels.data(), inSize, inSize);
+}
+
+size_t Texture::GetTexelIndex(const Level& inLevel, const uint32_t inX, const uint32_t inY) const
+{
+    const size_t tile = static_cast<size_t>(inY / TileSize) * inLevel.tilesX + inX / TileSize;
+    return inLevel.offset + tile * TileTexels + GetTileMorton(inX % TileSize, inY % TileSize);
+}
+
+uint32_t Texture::GetTexel(const uint32_t inLevel, const uint32_t inX, const uint32_t inY) const
+{
+    const Level& level = levels[std::min<size_t>(inLevel, levels.size() - 1)];
+    return texels[GetTexelIndex(level, inX % level.width, inY % level.height)];
+}
+
+void Texture::FetchTaps(const Level& inLevel, const Simd::Float& inU, const Simd::Float& inV,
+                        uint32_t (&outTaps)[4][Simd::Width], Simd::Float& outFx, Simd::Float& outFy) const
+{
+    const Simd::Float one = Simd::Float::Broadcast(1.0f);
+    const Simd::Float width = Simd::Float::Broadcast(static_cast<float>(inLevel.width));
+    const Simd::Float height = Simd::Float::Broadcast(static_cast<float>(inLevel.height));
+    const Simd::Float x = inU * width - Simd::Float::Broadcast(0.5f);
+    const Simd::Float y = inV * height - Simd::Float::Broadcast(0.5f);
+    const Simd::Float x0 = Floor(x);
+    const Simd::Float y0 = Floor(y);
+    outFx = x - x0;
+    outFy = y - y0;
+
+    // x0 is in [-1, width - 1]: -1 wraps to the last column, width to the first. (u = 1 only
+    // comes from rounding a tiny negative u up; it lands on the same two columns.)
+    const Simd::Float zero = Simd::Float::Broadcast(0.0f);
+    const Simd::Float x1 = x0 + one;
+    const Simd::Float y1 = y0 + one;
+    alignas(32) uint32_t left[Simd::Width], right[Simd::Width], top[Simd::Width], bottom[Simd::Width];
+    Simd::Int::Truncate(Simd::Select(x0 < zero, width - one, x0)).Store(left);
+    Simd::Int::Truncate(Simd::Select(x1 < width, x1, zero)).Store(right);
+    Simd::Int::Truncate(Simd::Select(y0 < zero, height - one, y0)).Store(top);
+    Simd::Int::Truncate(Simd::Select(y1 < height, y1, zero)).Store(bottom);
+
+    // No gather in Simd: the loads themselves go lane by lane.
+    for (int lane = 0; lane < Simd::Width; ++lane)
+    {
+        outTaps[0][lane] = texels[GetTexelIndex(inLevel, left[lane], top[lane])];
+        outTaps[1][lane] = texels[GetTexelIndex(inLevel, right[lane], top[lane])];
+        outTaps[2][lane] = texels[GetTexelIndex(inLevel, left[lane], bottom[lane])];
+        outTaps[3][lane] = texels[GetTexelIndex(inLevel, right[lane], bottom[lane])];
+    }
+}
+
+void Texture::Sample(const Simd::Float& inU, const Simd::Float& inV, const Simd::Float& inDuDx, const Simd::Float& inDvDx,
+                     const Simd::Float& inDuDy, const Simd::Float& inDvDy, const Simd::Mask& inCoverage,
+                     Simd::Float (&outColor)[3]) const
+{
+    if (levels.empty())
+    {
+        for (Simd::Float& channel : outColor) channel = Simd::Float::Broadcast(255.0f);
+        return;
+    }
+
+    // Uncovered lanes carry texcoords extrapolated with a 1/w near 0: huge, infinite or NaN.
+    // They, and covered lanes past 2^23 (no fraction left to wrap), sample at 0 and take no
+    // part in the level choice. The ordered compares are false for NaN.
+    const Simd::Float zero = Simd::Float::Broadcast(0.0f);
+    const Simd::Float limit = Simd::Float::Broadcast(8388608.0f);
+    const Simd::Float negativeLimit = Simd::Float::Broadcast(-8388608.0f);
+    const Simd::Mask valid = inCoverage & (inU < limit) & (negativeLimit < inU) & (inV < limit) & (negativeLimit < inV);
+    Simd::Float u = Simd::Select(valid, inU, zero);
+    Simd::Float v = Simd::Select(valid, inV, zero);
+    // Wrap to [0, 1] while still in float, so the texel coordinates stay within one period.
+    u = u - Floor(u);
+    v = v - Floor(v);
+
+    // Squared footprint of a pixel in level-0 texels. Like hardware picking the level per quad,
+    // all lanes share the level of the largest one.
+    const Simd::Float width = Simd::Float::Broadcast(static_cast<float>(levels[0].width));
+    const Simd::Float height = Simd::Float::Broadcast(static_cast<float>(levels[0].height));
+    const Simd::Float dx = inDuDx * width * (inDuDx * width) + inDvDx * height * (inDvDx * height);
+    const Simd::Float dy = inDuDy * width * (inDuDy * width) + inDvDy * height * (inDvDy * height);
+    const float footprint = Simd::ReduceMax(Simd::Select(valid, Simd::Max(dx, dy), zero));
+    const float maxLod = static_cast<float>(levels.size() - 1);
+    // log2 of the footprint length is half the log2 of its square.
+    const float lod = footprint > 1.0f ? std::min(0.5f * std::log2(footprint), maxLod) : 0.0f;
+
+    alignas(32) uint32_t taps[4][Simd::Width];
+    Simd::Float fx, fy;
+    if (filter == TextureFilter::Bilinear)
+    {
+        FetchTaps(levels[static_cast<size_t>(lod + 0.5f)], u, v, taps, fx, fy);
+        Bilinear(&taps[0][0], Simd::Width, fx, fy, outColor);
+        return;
+    }
+
+    const auto first = static_cast<size_t>(lod);
+    FetchTaps(levels[first], u, v, taps, fx, fy);
+    Bilinear(&taps[0][0], Simd::Width, fx, fy, outColor);
+    const float blend = lod - static_cast<float>(first);
+    if (blend <= 0.0f) return;
+
+    Simd::Float coarse[3];
+    FetchTaps(levels[first + 1], u, v, taps, fx, fy);
+    Bilinear(&taps[0][0], Simd::Width, fx, fy, coarse);
+    const Simd::Float weight = Simd::Float::Broadcast(blend);
+    for (int c = 0; c < 3; ++c) outColor[c] = outColor[c] + (coarse[c] - outColor[c]) * weight;
+}
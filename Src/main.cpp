@@ -1,25 +1,63 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+
 #include <SDL2/SDL.h>
 
 #include "Application.h"
 #include "Logger.h"
 #include "Mesh.h"
 #include "ModelLoader.h"
+#include "PrimitiveAssembly.h"
+#include "Profiler.h"
 #include "Renderer.h"
+#include "Scene.h"
+#include "Shaders.h"
+#include "Texture.h"
 
 class PrimaryApp : public Application
 {
 public:
-    PrimaryApp(std::string_view inTitle, uint32_t inWidth, uint32_t inHeight) : Application(inTitle, inWidth, inHeight)
+    // inInstanceCount > 1 fills a grid with teapots and cubes.
+    PrimaryApp(std::string_view inTitle, uint32_t inWidth, uint32_t inHeight, uint32_t inInstanceCount = 1)
+        : Application(inTitle, inWidth, inHeight)
     {
-        if (!LoadMesh("assets/teapot.obj", mesh)) {
+        Mesh mesh;
+        if (!LoadMesh("assets/teapot.obj", mesh, true, &GetJobSystem())) {
             spdlog::warn("Failed to load model, fallback to cube.");
             mesh = CreateCube();
         }
+        const MeshHandle teapot = scene.AddMesh(std::move(mesh));
+
+        if (inInstanceCount <= 1) {
+            AddPlacement(teapot, {0.0f, 0.0f, 0.0f}, 0.1f, 0xFFCCCCCC, &checker);
+            return;
+        }
+
+        // Square grid on the XZ plane, centered in X and running away from the camera from the
+        // origin on; every third slot a cube. Large grids reach past the sides and the far plane.
+        const MeshHandle cube = scene.AddMesh(CreateCube());
+        const auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(inInstanceCount))));
+        constexpr float spacing = 6.0f;
+        for (uint32_t i = 0; i < inInstanceCount; ++i) {
+            const Math::Vector3 position{
+                (static_cast<float>(i % side) - 0.5f * static_cast<float>(side - 1)) * spacing, 0.0f,
+                static_cast<float>(i / side) * spacing
+            };
+            if (i % 3 == 2) {
+                AddPlacement(cube, position, 2.0f, 0xFF8899CC);
+            } else {
+                AddPlacement(teapot, position, 0.1f, 0xFFCCCCCC, &checker);
+            }
+        }
     }
 
     void OnUpdate(const float deltaTime) override
     {
         rotationY += deltaTime * 1.0f;
+        statsTime += deltaTime;
     }
 
     void OnRender() override
@@ -27,13 +65,20 @@ public:
         // Clear the framebuffer.
         Clear(0xFF000000);
 
+        // Every instance spins around its own origin.
         const float c = std::cos(rotationY);
         const float s = std::sin(rotationY);
-        Math::Matrix44 model = Math::Matrix44::Identity();
-
-        constexpr float scale = 0.1f;
-        model.data[0] = c * scale; model.data[2] = -s * scale; model.data[5] = scale;
-        model.data[8] = s * scale; model.data[10] = c * scale; model.data[15] = 1.0f;
+        for (uint32_t i = 0; i < placements.size(); ++i) {
+            const Placement &placement = placements[i];
+            Math::Matrix44 model = Math::Matrix44::Identity();
+            const float scale = placement.scale;
+            model.data[0] = c * scale; model.data[2] = -s * scale; model.data[5] = scale;
+            model.data[8] = s * scale; model.data[10] = c * scale; model.data[15] = 1.0f;
+            model.data[12] = placement.position.x;
+            model.data[13] = placement.position.y;
+            model.data[14] = placement.position.z;
+            scene.SetTransform(i, model);
+        }
 
         const Math::Vector3 eye{0.0f, 2.0f, -50.0f};
         const Math::Vector3 target{0.0f, 1.0f, 0.0f};
@@ -43,39 +88,507 @@ public:
         const auto screenW = static_cast<float>(GetWidth());
         const auto screenH = static_cast<float>(GetHeight());
         const float aspect = screenW / screenH;
-        const Math::Matrix44 proj = Math::Matrix44::PerspectiveFovLH(3.1415926f / 4.0f, aspect, 0.1f, 100.0f);
+        const Math::Matrix44 proj =
+                IsReverseZEnabled() ? Math::Matrix44::PerspectiveFovReverseLH(3.1415926f / 4.0f, aspect, 0.1f, 100.0f)
+                                    : Math::Matrix44::PerspectiveFovLH(3.1415926f / 4.0f, aspect, 0.1f, 100.0f);
+
+        // Detail is picked once per frame from the camera, so shadow casters match the receivers.
+        lodView = view;
+        // proj.data[5] = cot(fov / 2) maps a unit at distance 1 to half the screen height.
+        lodPixelsPerUnit = proj.data[5] * 0.5f * screenH;
+
+        if (IsShadowEnabled()) {
+            RenderShadowMap();
+            GetShadowMap().SetViewer(Math::Matrix44::Multiply(proj, view), GetWidth(), GetHeight(),
+                                     IsReverseZEnabled());
+        }
+
+        // Whole instances outside the view are dropped before any vertex work.
+        SceneStats frameSceneStats;
+        visibleInstances.clear();
+        const Frustum frustum = Frustum::FromViewProjection(Math::Matrix44::Multiply(proj, view));
+        {
+            PROFILE_SCOPE("Cull");
+            scene.Cull(frustum, visibleInstances, frameSceneStats);
+        }
+
+        PrimitiveStats frameStats;
+        MeshletStats frameMeshletStats;
+        reducedLodInstances = 0;
+        DispatchShadingModel(GetShadingModel(), [&](auto program) {
+            DrawInstances<decltype(program)>(view, proj, frustum, GetViewPosition(view), frameStats, frameMeshletStats);
+        });
+
+        LogFrameStats(frameStats, frameSceneStats, frameMeshletStats);
+    }
+
+private:
+    // Where an instance sits; the spin is applied per frame.
+    struct Placement
+    {
+        Math::Vector3 position;
+        float scale{1.0f};
+    };
+
+    // Per-instance part of an instanced draw.
+    struct InstanceDraw
+    {
+        uint32_t instance{0};
+        uint32_t lod{0};
+        ShaderUniforms uniforms;
+    };
+
+    // Meshlet of a draw that survived culling.
+    struct MeshletDraw
+    {
+        uint32_t draw{0};
+        uint32_t meshlet{0};
+        // First entry of the meshlet's vertices in transformed.
+        size_t vertexOffset{0};
+    };
+
+    void AddPlacement(const MeshHandle inMesh, const Math::Vector3 &inPosition, const float inScale,
+                      const uint32_t inBaseColor, const Texture *inTexture = nullptr)
+    {
+        scene.AddInstance(inMesh, Math::Matrix44::Identity(), inBaseColor, inTexture);
+        placements.push_back({inPosition, inScale});
+    }
+
+    // Coarsest LOD whose error, projected at the nearest point of the instance bounds, stays
+    // within the pixel budget. inPixelsPerUnit: pixels per world unit at view distance 1.
+    uint32_t SelectLod(const Instance &inInstance, const Math::Matrix44 &inView, const float inPixelsPerUnit) const
+    {
+        const Mesh &mesh = scene.GetMesh(inInstance.mesh);
+        const float budget = GetLodErrorPixels();
+        if (budget <= 0.0f || mesh.lods.empty()) return 0;
+
+        const Bounds &bounds = inInstance.worldBounds;
+        const Math::Vector3 center = (bounds.min + bounds.max) * 0.5f;
+        const float radius = (bounds.max - bounds.min).Length() * 0.5f;
+        const auto &v = inView.data;
+        const float depth = v[2] * center.x + v[6] * center.y + v[10] * center.z + v[14];
+        const float distance = depth - radius;
+        if (distance <= 0.0f) return 0;
+
+        // Object-space error scales with the largest axis of the model matrix.
+        const auto &m = inInstance.model.data;
+        const float scale = std::sqrt(std::max({
+            m[0] * m[0] + m[1] * m[1] + m[2] * m[2],
+            m[4] * m[4] + m[5] * m[5] + m[6] * m[6],
+            m[8] * m[8] + m[9] * m[9] + m[10] * m[10]
+        }));
+        return mesh.SelectLod(budget * distance / (inPixelsPerUnit * scale));
+    }
+
+    // Directional light: an orthographic frustum around the bounding sphere of the scene, so
+    // it stays put while instances spin. The depth pass reuses the instanced vertex stage.
+    void RenderShadowMap()
+    {
+        ShadowMap &shadowMap = GetShadowMap();
+        const Bounds bounds = scene.GetBounds();
+        const Math::Vector3 center = (bounds.min + bounds.max) * 0.5f;
+        const float radius = std::max((bounds.max - bounds.min).Length() * 0.5f, 1e-3f);
+        const Math::Vector3 &toLight = GetLighting().toLight;
+        const Math::Vector3 up = std::abs(toLight.y) > 0.99f ? Math::Vector3{0.0f, 0.0f, 1.0f}
+                                                             : Math::Vector3{0.0f, 1.0f, 0.0f};
+        const Math::Matrix44 lightView = Math::Matrix44::LookAtLH(center + toLight * (2.0f * radius), center, up);
+        const Math::Matrix44 lightProj =
+                Math::Matrix44::OrthographicOffCenterLH(-radius, radius, -radius, radius, radius, 3.0f * radius);
+        shadowMap.SetLightViewProjection(Math::Matrix44::Multiply(lightProj, lightView));
+        if (!shadowMap.NeedsUpdate(GetShadowUpdate(), scene.GetRevision())) return;
 
-        const Math::Matrix44 mvp = Math::Matrix44::Multiply(proj, Math::Matrix44::Multiply(view, model));
+        PROFILE_SCOPE("Shadow Pass");
+        shadowMap.BeginUpdate(scene.GetRevision());
+        const Frustum frustum = Frustum::FromViewProjection(shadowMap.GetLightViewProjection());
+        SceneStats shadowSceneStats;
+        PrimitiveStats shadowStats;
+        MeshletStats shadowMeshletStats;
+        visibleInstances.clear();
+        scene.Cull(frustum, visibleInstances, shadowSceneStats);
+        DrawInstances<DepthOnlyProgram, true>(lightView, lightProj, frustum, center, shadowStats, shadowMeshletStats);
+    }
 
-        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-            const Vertex& v0 = mesh.vertices[mesh.indices[i]];
-            const Vertex& v1 = mesh.vertices[mesh.indices[i + 1]];
-            const Vertex& v2 = mesh.vertices[mesh.indices[i + 2]];
+    // Instanced draw of the visible instances, compiled once per shader program. Instances of a
+    // mesh share its vertex, index and meshlet data per LOD, only the matrices change.
+    // Meshlets outside the frustum or facing away are dropped before their vertices are
+    // transformed. The rest are batched up to BatchVertexBudget vertices: the vertex stage of a
+    // batch runs as one parallel job list of meshlet groups, then assembly and raster.
+    // bShadowPass: draw depth into the shadow map instead.
+    template<typename Program, bool bShadowPass = false>
+    void DrawInstances(const Math::Matrix44 &view, const Math::Matrix44 &proj, const Frustum &frustum,
+                       const Math::Vector3 &eye, PrimitiveStats &frameStats, MeshletStats &frameMeshletStats)
+    {
+        const int width = static_cast<int>(bShadowPass ? GetShadowMap().GetSize() : GetWidth());
+        const int height = static_cast<int>(bShadowPass ? GetShadowMap().GetSize() : GetHeight());
+        // Cones are built for clockwise front faces; culling by them only skips triangles
+        // assembly would drop as back faces anyway.
+        // The light has no eye point to cull cones against.
+        const bool bConeCull = !bShadowPass && assemblyConfig.cullMode == CullMode::Back &&
+                               assemblyConfig.frontFace == FrontFace::Clockwise;
+        // The light's projection is never reversed.
+        PrimitiveAssemblyConfig config = assemblyConfig;
+        config.bReverseZ = !bShadowPass && IsReverseZEnabled();
 
-            VSOutput out0 = VertexShader(v0, model, mvp);
-            VSOutput out1 = VertexShader(v1, model, mvp);
-            VSOutput out2 = VertexShader(v2, model, mvp);
+        // Draw lists and post-transform vertices are frame data.
+        LinearArena &arena = GetFrameArena().Get();
+        std::pmr::vector<InstanceDraw> draws(&arena);
+        std::pmr::vector<MeshletDraw> meshletDraws(&arena);
+        draws.reserve(visibleInstances.size());
+        meshletDraws.reserve(peakMeshletDraws);
+        VSOutput *transformed = nullptr;
+        size_t transformedCapacity = 0;
+        {
+            PROFILE_SCOPE("Meshlet Cull");
+            for (const uint32_t index : visibleInstances) {
+                const Instance &instance = scene.GetInstance(index);
+                const uint32_t lod = SelectLod(instance, lodView, lodPixelsPerUnit);
+                if (!bShadowPass && lod > 0) ++reducedLodInstances;
 
-            Math::Vector3 s0 = ViewportTransform(out0.clipPos, GetWidth(), GetHeight());
-            Math::Vector3 s1 = ViewportTransform(out1.clipPos, GetWidth(), GetHeight());
-            Math::Vector3 s2 = ViewportTransform(out2.clipPos, GetWidth(), GetHeight());
+                const Math::Matrix44 mvp = Math::Matrix44::Multiply(proj, Math::Matrix44::Multiply(view, instance.model));
+                const auto draw = static_cast<uint32_t>(draws.size());
+                draws.push_back({index, lod, {instance.model, mvp, GetLighting()}});
 
-            DrawTriangle(s0, s1, s2, out0.worldNormal, out1.worldNormal, out2.worldNormal, 0xFFCCCCCC);
+                visibleMeshlets.clear();
+                CullMeshlets(scene.GetMesh(instance.mesh).GetClusters(lod), instance.model, frustum, eye, bConeCull,
+                             visibleMeshlets, frameMeshletStats);
+                for (const uint32_t meshlet : visibleMeshlets) {
+                    meshletDraws.push_back({draw, meshlet, 0});
+                }
+            }
+        }
+
+        peakMeshletDraws = std::max(peakMeshletDraws, meshletDraws.size());
+
+        const auto getClusters = [this](const InstanceDraw &draw) -> const MeshletBuffers & {
+            return scene.GetMesh(scene.GetInstance(draw.instance).mesh).GetClusters(draw.lod);
+        };
+
+        size_t next = 0;
+        while (next < meshletDraws.size()) {
+            const size_t first = next;
+            size_t vertexCount = 0;
+            for (; next < meshletDraws.size(); ++next) {
+                MeshletDraw &meshletDraw = meshletDraws[next];
+                const uint32_t meshletVertices =
+                        getClusters(draws[meshletDraw.draw]).meshlets[meshletDraw.meshlet].vertexCount;
+                if (vertexCount > 0 && vertexCount + meshletVertices > BatchVertexBudget) break;
+                meshletDraw.vertexOffset = vertexCount;
+                vertexCount += meshletVertices;
+            }
+            const size_t last = next;
+
+            // Transform each meshlet's vertices once; its triangles index into them locally.
+            if (vertexCount > transformedCapacity) {
+                transformed = arena.Allocate<VSOutput>(vertexCount);
+                transformedCapacity = vertexCount;
+            }
+            const auto jobCount = static_cast<uint32_t>((last - first + MeshletsPerJob - 1) / MeshletsPerJob);
+            GetJobSystem().ParallelFor(jobCount, [&](const uint32_t index, uint32_t) {
+                PROFILE_SCOPE("Vertex");
+                const size_t begin = first + index * MeshletsPerJob;
+                const size_t end = std::min(last, begin + MeshletsPerJob);
+                for (size_t i = begin; i < end; ++i) {
+                    const MeshletDraw &meshletDraw = meshletDraws[i];
+                    const InstanceDraw &draw = draws[meshletDraw.draw];
+                    const MeshletBuffers &clusters = getClusters(draw);
+                    const Meshlet &meshlet = clusters.meshlets[meshletDraw.meshlet];
+                    const Mesh &mesh = scene.GetMesh(scene.GetInstance(draw.instance).mesh);
+                    ProcessVertices<typename Program::VS>(mesh.GetVertices(draw.lod),
+                                                          clusters.vertices.data() + meshlet.vertexOffset,
+                                                          meshlet.vertexCount, draw.uniforms, width, height,
+                                                          transformed + meshletDraw.vertexOffset);
+                }
+            });
+
+            {
+                PROFILE_SCOPE("Primitive Assembly");
+                for (size_t i = first; i < last; ++i) {
+                    const MeshletDraw &meshletDraw = meshletDraws[i];
+                    const InstanceDraw &draw = draws[meshletDraw.draw];
+                    const Instance &instance = scene.GetInstance(draw.instance);
+                    const MeshletBuffers &clusters = getClusters(draw);
+                    const Meshlet &meshlet = clusters.meshlets[meshletDraw.meshlet];
+                    const VSOutput *vertices = transformed + meshletDraw.vertexOffset;
+                    const uint8_t *triangles = clusters.triangles.data() + meshlet.triangleOffset * 3;
+                    const auto emit = [this, &instance](const VSOutput &v0, const VSOutput &v1, const VSOutput &v2) {
+                        if constexpr (bShadowPass) {
+                            SubmitShadowTriangle(v0, v1, v2);
+                        } else {
+                            SubmitTriangle(v0, v1, v2, instance.baseColor, instance.texture);
+                        }
+                    };
+                    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+                        const uint8_t *tri = triangles + t * 3;
+                        AssembleTriangle(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], config, width,
+                                         height, frameStats, emit);
+                    }
+                }
+            }
+
+            if constexpr (bShadowPass) {
+                FlushShadowTriangles();
+            } else {
+                FlushTriangles<Program>();
+            }
         }
     }
 
+    // Per-frame averages, about once a second.
+    void LogFrameStats(const PrimitiveStats &frameStats, const SceneStats &frameSceneStats,
+                       const MeshletStats &frameMeshletStats)
+    {
+        primitiveStats += frameStats;
+        sceneStats += frameSceneStats;
+        meshletStats += frameMeshletStats;
+        reducedLodTotal += reducedLodInstances;
+        ++statsFrames;
+        if (statsTime < 1.0f) return;
+
+        spdlog::info("Instances/frame: {} visible, {} culled, {} BVH nodes tested, {} at a reduced LOD.",
+                     sceneStats.instancesVisible / statsFrames, sceneStats.instancesCulled / statsFrames,
+                     sceneStats.nodesTested / statsFrames, reducedLodTotal / statsFrames);
+        spdlog::info("Meshlets/frame: {} visible, {} frustum culled, {} back-face culled.",
+                     meshletStats.meshletsVisible / statsFrames, meshletStats.frustumCulled / statsFrames,
+                     meshletStats.backFaceCulled / statsFrames);
+        spdlog::info("Primitives/frame: {} in, {} frustum culled, {} back-face culled, {} near clipped, {} out.",
+                     primitiveStats.trianglesIn / statsFrames, primitiveStats.frustumCulled / statsFrames,
+                     primitiveStats.backFaceCulled / statsFrames, primitiveStats.nearClipped / statsFrames,
+                     primitiveStats.trianglesOut / statsFrames);
+        primitiveStats = {};
+        sceneStats = {};
+        meshletStats = {};
+        reducedLodTotal = 0;
+        statsFrames = 0;
+        statsTime = 0.0f;
+    }
+
 private:
-    Mesh mesh;
+    // Teapot texture, seen with --shading textured.
+    Texture checker = Texture::CreateChecker(256, 16, 0xFFFFFFFF, 0xFF303030);
+    Scene scene;
+    std::vector<Placement> placements;
+    std::vector<uint32_t> visibleInstances;
+
+    // Meshlets per vertex-stage job.
+    static constexpr size_t MeshletsPerJob = 16;
+    // Post-transform vertices kept alive by one instanced batch.
+    static constexpr size_t BatchVertexBudget = 1 << 16;
+
+    std::vector<uint32_t> visibleMeshlets;
+    // Most meshlet draws of one DrawInstances so far; the next list starts at this capacity.
+    size_t peakMeshletDraws = 0;
     float rotationY = 0.0f;
+
+    PrimitiveAssemblyConfig assemblyConfig;
+    PrimitiveStats primitiveStats;
+    SceneStats sceneStats;
+    MeshletStats meshletStats;
+    // Camera the level of detail is selected for.
+    Math::Matrix44 lodView = Math::Matrix44::Identity();
+    float lodPixelsPerUnit = 1.0f;
+    // Visible instances drawn below full detail: this frame, and summed for the log.
+    uint64_t reducedLodInstances = 0;
+    uint64_t reducedLodTotal = 0;
+    uint32_t statsFrames = 0;
+    float statsTime = 0.0f;
 };
 
 
+// Headless arguments:
+// --headless [--frames N] [--size WxH] [--dt seconds] [--out image] [--report json] [--trace json]
+//            [--visibility] [--shading depth|flat|gouraud|phong|textured] [--instances N] [--lod-error pixels]
+//            [--target-ms ms] [--msaa] [--tiled] [--shadows size] [--pcf radius]
+//            [--shadow-update frame|change] [--depth float32|unorm24|unorm16] [--reverse-z]
+static bool ParseHeadlessArgs(int argc, char* argv[], HeadlessOptions& outOptions,
+                              uint32_t& outWidth, uint32_t& outHeight, uint32_t& outInstanceCount)
+{
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--visibility")
+        {
+            outOptions.bVisibilityBuffer = true;
+            continue;
+        }
+        if (arg == "--msaa")
+        {
+            outOptions.bMultisample = true;
+            continue;
+        }
+        if (arg == "--tiled")
+        {
+            outOptions.bTiledTargets = true;
+            continue;
+        }
+        if (arg == "--reverse-z")
+        {
+            outOptions.bReverseZ = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            spdlog::error("Missing value for {}.", arg);
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--frames")
+        {
+            outOptions.frameCount = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if (arg == "--size")
+        {
+            if (std::sscanf(value, "%ux%u", &outWidth, &outHeight) != 2) outWidth = outHeight = 0;
+        }
+        else if (arg == "--dt")
+        {
+            outOptions.deltaTime = std::strtof(value, nullptr);
+        }
+        else if (arg == "--out")
+        {
+            outOptions.imagePath = value;
+        }
+        else if (arg == "--report")
+        {
+            outOptions.reportPath = value;
+        }
+        else if (arg == "--trace")
+        {
+            outOptions.tracePath = value;
+        }
+        else if (arg == "--lod-error")
+        {
+            outOptions.lodErrorPixels = std::strtof(value, nullptr);
+        }
+        else if (arg == "--target-ms")
+        {
+            outOptions.targetFrameMs = std::strtof(value, nullptr);
+        }
+        else if (arg == "--shadows")
+        {
+            outOptions.shadowMapSize = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if (arg == "--pcf")
+        {
+            outOptions.shadowPcfRadius = std::atoi(value);
+        }
+        else if (arg == "--shadow-update")
+        {
+            bool bFound = false;
+            for (const ShadowUpdate update : {ShadowUpdate::EveryFrame, ShadowUpdate::OnChange})
+            {
+                if (std::string_view(GetShadowUpdateName(update)) != value) continue;
+                outOptions.shadowUpdate = update;
+                bFound = true;
+            }
+            if (!bFound)
+            {
+                spdlog::error("Unknown shadow update {}.", value);
+                return false;
+            }
+        }
+        else if (arg == "--depth")
+        {
+            bool bFound = false;
+            for (const DepthFormat format : {DepthFormat::Float32, DepthFormat::Unorm24, DepthFormat::Unorm16})
+            {
+                if (std::string_view(GetDepthFormatName(format)) != value) continue;
+                outOptions.depthFormat = format;
+                bFound = true;
+            }
+            if (!bFound)
+            {
+                spdlog::error("Unknown depth format {}.", value);
+                return false;
+            }
+        }
+        else if (arg == "--instances")
+        {
+            outInstanceCount = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if (arg == "--shading")
+        {
+            bool bFound = false;
+            for (const ShadingModel model : {ShadingModel::DepthOnly, ShadingModel::Flat, ShadingModel::Gouraud,
+                                             ShadingModel::Phong, ShadingModel::Textured})
+            {
+                if (std::string_view(GetShadingModelName(model)) != value) continue;
+                outOptions.shadingModel = model;
+                bFound = true;
+            }
+            if (!bFound)
+            {
+                spdlog::error("Unknown shading model {}.", value);
+                return false;
+            }
+        }
+        else
+        {
+            spdlog::error("Unknown argument {}.", arg);
+            return false;
+        }
+    }
+
+    if (outOptions.frameCount == 0 || outWidth == 0 || outHeight == 0)
+    {
+        spdlog::error("Headless mode needs a positive frame count and resolution.");
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
-    Log::Init();
+    // Headless runs may print the JSON report to stdout; keep the log out of it.
+    Log::Init(argc > 1 && std::string_view(argv[1]) == "--headless");
+
+    // --bake <obj>...: write binary mesh caches offline and exit.
+    if (argc > 1 && std::string_view(argv[1]) == "--bake")
+    {
+        JobSystem jobs;
+        bool bSucceeded = argc > 2;
+        for (int i = 2; i < argc; ++i)
+        {
+            bSucceeded = BakeMeshCache(argv[i], &jobs) && bSucceeded;
+        }
+        return bSucceeded ? 0 : -1;
+    }
+
+    // --verify-obj <obj>...: check the built-in OBJ parser against tinyobjloader and exit.
+    if (argc > 1 && std::string_view(argv[1]) == "--verify-obj")
+    {
+        JobSystem jobs;
+        bool bSucceeded = argc > 2;
+        for (int i = 2; i < argc; ++i)
+        {
+            bSucceeded = VerifyObjParser(argv[i], jobs) && bSucceeded;
+        }
+        return bSucceeded ? 0 : -1;
+    }
+
+    // --headless ...: offscreen benchmark run, see ParseHeadlessArgs.
+    if (argc > 1 && std::string_view(argv[1]) == "--headless")
+    {
+        HeadlessOptions options;
+        uint32_t width = 800;
+        uint32_t height = 600;
+        uint32_t instanceCount = 1;
+        if (!ParseHeadlessArgs(argc, argv, options, width, height, instanceCount)) return -1;
+
+        PrimaryApp app("Soft Rasterizer v0.1", width, height, instanceCount);
+        return app.RunHeadless(options) ? 0 : -1;
+    }
+
     spdlog::info("Starting Renderer.");
 
-    PrimaryApp app("Soft Rasterizer v0.1", 800, 600);
+    // --instances N: scene with N instances instead of the single teapot.
+    uint32_t instanceCount = 1;
+    if (argc > 2 && std::string_view(argv[1]) == "--instances")
+    {
+        instanceCount = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+    }
+
+    PrimaryApp app("Soft Rasterizer v0.1", 800, 600, instanceCount);
 
     if (!app.Init())
     {